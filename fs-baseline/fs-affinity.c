@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "fs-affinity.h"
+
+#define MAX_NODES	(1024)
+
+typedef struct {
+	int	cpu;
+	int	node;
+	int	package;
+	int	core;
+	int	smt;		/* Index of this thread within its core */
+	int	core_rank;	/* Index of this core within its node */
+} cpu_info_t;
+
+static const char *policies[] = {
+	"compact",
+	"scatter",
+	"node",
+	NULL
+};
+
+/*
+ *  cpulist_parse()
+ *	parse a sysfs style cpu list such as 0-3,8,10-11,
+ *	returns the number of cpus or -1 if malformed
+ */
+static int cpulist_parse(const char *str, int *cpus, const int max)
+{
+	int n = 0;
+
+	while (*str && (*str != '\n')) {
+		char *end;
+		long lo, hi;
+
+		lo = strtol(str, &end, 10);
+		if ((end == str) || (lo < 0))
+			return -1;
+		hi = lo;
+		str = end;
+		if (*str == '-') {
+			str++;
+			hi = strtol(str, &end, 10);
+			if ((end == str) || (hi < lo))
+				return -1;
+			str = end;
+		}
+		for (; lo <= hi; lo++) {
+			if (n >= max)
+				return -1;
+			cpus[n++] = (int)lo;
+		}
+		if (*str == ',')
+			str++;
+		else if (*str && (*str != '\n'))
+			return -1;
+	}
+	return n;
+}
+
+static int sysfs_read(const char *path, char *buf, const size_t len)
+{
+	FILE *fp;
+	int rc = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return -errno;
+	if (fgets(buf, (int)len, fp) == NULL)
+		rc = -EIO;
+	(void)fclose(fp);
+
+	return rc;
+}
+
+static int sysfs_read_int(const char *path, const int def)
+{
+	char buf[32];
+
+	if (sysfs_read(path, buf, sizeof(buf)) < 0)
+		return def;
+	return atoi(buf);
+}
+
+/*
+ *  affinity_policy()
+ *	check a --affinity policy name or cpu list, 0 if valid
+ */
+int affinity_policy(const char *policy)
+{
+	static int cpus[MAX_CPUS];
+	int i;
+
+	for (i = 0; policies[i]; i++) {
+		if (!strcmp(policy, policies[i]))
+			return 0;
+	}
+	return cpulist_parse(policy, cpus, MAX_CPUS) > 0 ? 0 : -1;
+}
+
+/*
+ *  cpu_topology()
+ *	gather the online cpus with their node, package and core
+ */
+static int cpu_topology(cpu_info_t *info, const int max)
+{
+	static int cpus[MAX_CPUS], node_cpus[MAX_CPUS], nodes[MAX_NODES];
+	char buf[4096], path[PATH_MAX];
+	int i, j, n, n_nodes;
+
+	if (sysfs_read("/sys/devices/system/cpu/online", buf, sizeof(buf)) < 0)
+		return -1;
+	n = cpulist_parse(buf, cpus, max);
+	if (n <= 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		info[i].cpu = cpus[i];
+		info[i].node = 0;
+		snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpus[i]);
+		info[i].package = sysfs_read_int(path, 0);
+		snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%d/topology/core_id", cpus[i]);
+		info[i].core = sysfs_read_int(path, cpus[i]);
+	}
+
+	/* Kernels without NUMA support have no node directory */
+	if (sysfs_read("/sys/devices/system/node/online", buf, sizeof(buf)) < 0)
+		return n;
+	n_nodes = cpulist_parse(buf, nodes, MAX_NODES);
+	for (j = 0; j < n_nodes; j++) {
+		int k, nc;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[j]);
+		if (sysfs_read(path, buf, sizeof(buf)) < 0)
+			continue;
+		nc = cpulist_parse(buf, node_cpus, MAX_CPUS);
+		for (k = 0; k < nc; k++) {
+			for (i = 0; i < n; i++) {
+				if (info[i].cpu == node_cpus[k])
+					info[i].node = nodes[j];
+			}
+		}
+	}
+	return n;
+}
+
+static int cmp_compact(const void *p1, const void *p2)
+{
+	const cpu_info_t *c1 = (const cpu_info_t *)p1;
+	const cpu_info_t *c2 = (const cpu_info_t *)p2;
+
+	if (c1->node != c2->node)
+		return c1->node - c2->node;
+	if (c1->package != c2->package)
+		return c1->package - c2->package;
+	if (c1->core != c2->core)
+		return c1->core - c2->core;
+	return c1->cpu - c2->cpu;
+}
+
+static int cmp_scatter(const void *p1, const void *p2)
+{
+	const cpu_info_t *c1 = (const cpu_info_t *)p1;
+	const cpu_info_t *c2 = (const cpu_info_t *)p2;
+
+	if (c1->smt != c2->smt)
+		return c1->smt - c2->smt;
+	if (c1->core_rank != c2->core_rank)
+		return c1->core_rank - c2->core_rank;
+	if (c1->node != c2->node)
+		return c1->node - c2->node;
+	return c1->cpu - c2->cpu;
+}
+
+/*
+ *  cpu_scatter_rank()
+ *	with cpus in compact order, number the SMT threads of
+ *	each core and the cores of each node so that scatter
+ *	can alternate nodes, then cores, then SMT siblings
+ */
+static void cpu_scatter_rank(cpu_info_t *info, const int n)
+{
+	int i;
+
+	if (n > 0) {
+		info[0].smt = 0;
+		info[0].core_rank = 0;
+	}
+	for (i = 1; i < n; i++) {
+		const cpu_info_t *prev = &info[i - 1];
+
+		if (prev->node != info[i].node) {
+			info[i].smt = 0;
+			info[i].core_rank = 0;
+		} else if ((prev->package == info[i].package) &&
+			   (prev->core == info[i].core)) {
+			info[i].smt = prev->smt + 1;
+			info[i].core_rank = prev->core_rank;
+		} else {
+			info[i].smt = 0;
+			info[i].core_rank = prev->core_rank + 1;
+		}
+	}
+}
+
+/*
+ *  device_numa_node()
+ *	walk up the sysfs device path of the block device
+ *	holding pathname until a numa_node attribute is found
+ */
+static int device_numa_node(const char *pathname)
+{
+	struct stat buf;
+	char path[PATH_MAX + 16], real[PATH_MAX];
+
+	if (stat(pathname, &buf) < 0)
+		return -1;
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u",
+		major(buf.st_dev), minor(buf.st_dev));
+	if (realpath(path, real) == NULL)
+		return -1;
+
+	while (strlen(real) > strlen("/sys/devices")) {
+		char *ptr;
+		int node;
+
+		snprintf(path, sizeof(path), "%s/numa_node", real);
+		node = sysfs_read_int(path, INT_MIN);
+		if (node != INT_MIN)
+			return node;
+		if ((ptr = strrchr(real, '/')) == NULL)
+			break;
+		*ptr = '\0';
+	}
+	return -1;
+}
+
+/*
+ *  affinity_place()
+ *	choose a cpu for each of the n workers according to
+ *	the policy, workers wrap around when there are more
+ *	workers than cpus
+ */
+int affinity_place(
+	const char *policy,
+	const char *pathname,
+	const uint32_t n,
+	placement_t *place)
+{
+	static cpu_info_t info[MAX_CPUS], chosen[MAX_CPUS];
+	static int cpus[MAX_CPUS];
+	int ncpus = 0, ninfo, i, j;
+	uint32_t t;
+
+	ninfo = cpu_topology(info, MAX_CPUS);
+	if (ninfo <= 0) {
+		fprintf(stderr, "Cannot read the CPU topology from sysfs\n");
+		return -1;
+	}
+	qsort(info, (size_t)ninfo, sizeof(*info), cmp_compact);
+
+	if (!strcmp(policy, "compact")) {
+		for (i = 0; i < ninfo; i++)
+			chosen[ncpus++] = info[i];
+	} else if (!strcmp(policy, "scatter")) {
+		cpu_scatter_rank(info, ninfo);
+		qsort(info, (size_t)ninfo, sizeof(*info), cmp_scatter);
+		for (i = 0; i < ninfo; i++)
+			chosen[ncpus++] = info[i];
+	} else if (!strcmp(policy, "node")) {
+		int node = device_numa_node(pathname);
+
+		if (node < 0) {
+			fprintf(stderr, "Cannot find the NUMA node of the device holding %s, using node 0\n",
+				pathname);
+			node = 0;
+		}
+		for (i = 0; i < ninfo; i++) {
+			if (info[i].node == node)
+				chosen[ncpus++] = info[i];
+		}
+		if (!ncpus) {
+			fprintf(stderr, "NUMA node %d has no online CPUs\n", node);
+			return -1;
+		}
+	} else {
+		const int nlist = cpulist_parse(policy, cpus, MAX_CPUS);
+
+		/* Explicit list, keep the order given */
+		for (i = 0; i < nlist; i++) {
+			for (j = 0; j < ninfo; j++) {
+				if (info[j].cpu == cpus[i])
+					break;
+			}
+			if (j == ninfo) {
+				fprintf(stderr, "CPU %d is not online\n", cpus[i]);
+				return -1;
+			}
+			chosen[ncpus++] = info[j];
+		}
+	}
+
+	for (t = 0; t < n; t++) {
+		place[t].cpu = chosen[t % (uint32_t)ncpus].cpu;
+		place[t].node = chosen[t % (uint32_t)ncpus].node;
+	}
+	return 0;
+}
+
+/*
+ *  affinity_show()
+ *	print the placement so a run can be reproduced
+ */
+void affinity_show(const char *policy, const uint32_t n, const placement_t *place)
+{
+	uint32_t t;
+
+	printf("Placement %s, thread:cpu/node", policy);
+	for (t = 0; t < n; t++)
+		printf(" %" PRIu32 ":%d/%d", t, place[t].cpu, place[t].node);
+	printf("\n");
+}
+
+/*
+ *  affinity_bind_buffer()
+ *	prefer the worker's node for an I/O buffer, moving any
+ *	pages the allocator handed back from another node.  Only
+ *	whole pages inside the buffer are bound, so heap data
+ *	sharing its first or last page stays where it is
+ */
+void affinity_bind_buffer(void *buf, const size_t len, const int node)
+{
+	unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+	const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+	const uintptr_t start = ((uintptr_t)buf + page_size - 1) & ~(page_size - 1);
+	const uintptr_t end = ((uintptr_t)buf + len) & ~(page_size - 1);
+
+	if ((node < 0) || (node >= MAX_NODES) || (end <= start))
+		return;
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+	if (syscall(__NR_mbind, start, end - start, MPOL_PREFERRED,
+		    mask, MAX_NODES, MPOL_MF_MOVE) < 0)
+		fprintf(stderr, "mbind to node %d failed: %d %s\n",
+			node, errno, strerror(errno));
+}
+
+/*
+ *  affinity_alloc_buffer()
+ *	allocate an I/O buffer in whole pages and bind all of
+ *	it to the worker's node, NULL with errno set on failure
+ */
+void *affinity_alloc_buffer(const size_t len, const int node)
+{
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t size = (len + page_size - 1) & ~(page_size - 1);
+	void *buf;
+	int err;
+
+	err = posix_memalign(&buf, page_size, size ? size : page_size);
+	if (err) {
+		errno = err;
+		return NULL;
+	}
+	affinity_bind_buffer(buf, size, node);
+
+	return buf;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_AFFINITY_H__
+#define __FS_AFFINITY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_CPUS	(4096)
+
+/* Where a worker runs, -1 if not pinned */
+typedef struct {
+	int	cpu;
+	int	node;
+} placement_t;
+
+extern int affinity_policy(const char *policy);
+extern int affinity_place(const char *policy, const char *pathname,
+	const uint32_t n, placement_t *place);
+extern void affinity_show(const char *policy, const uint32_t n,
+	const placement_t *place);
+extern void affinity_bind_buffer(void *buf, const size_t len, const int node);
+extern void *affinity_alloc_buffer(const size_t len, const int node);
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "fs-cache.h"
+
+#ifndef __NR_cachestat
+#define __NR_cachestat		(451)
+#endif
+
+#define CACHE_MINCORE_WINDOW	(256ULL * 1024 * 1024)	/* Mapped per mincore() call */
+
+/* cachestat() arguments, as in linux/mman.h from 6.5 */
+typedef struct {
+	uint64_t	off;
+	uint64_t	len;		/* 0 for up to the end of the file */
+} cache_range_t;
+
+typedef struct {
+	uint64_t	nr_cache;
+	uint64_t	nr_dirty;
+	uint64_t	nr_writeback;
+	uint64_t	nr_evicted;
+	uint64_t	nr_recently_evicted;
+} cache_stat_t;
+
+static const char *cache_mode_names[] = {
+	"evict",
+	"drop",
+	"keep",
+};
+
+/* Older kernels lack cachestat(), mincore() is used from then on */
+static bool cache_no_cachestat;
+
+/*
+ *  cache_mode_parse()
+ *	parse evict, drop or keep
+ */
+int cache_mode_parse(const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(cache_mode_names) / sizeof(cache_mode_names[0]); i++) {
+		if (!strcmp(str, cache_mode_names[i]))
+			return (int)i;
+	}
+	return -1;
+}
+
+/*
+ *  cache_mode_name()
+ *	name of a cache mode
+ */
+const char *cache_mode_name(const cache_mode_t mode)
+{
+	return cache_mode_names[mode];
+}
+
+/*
+ *  cache_state()
+ *	how cached a round's files were, from the percentage
+ *	of their bytes in the page cache
+ */
+const char *cache_state(const double pct)
+{
+	if (pct <= CACHE_COLD_PCT)
+		return "cold";
+	if (pct >= CACHE_WARM_PCT)
+		return "warm";
+	return "partially cached";
+}
+
+/*
+ *  cache_evict()
+ *	write back a file's dirty pages and then drop its
+ *	pages from the page cache.  Only this file is touched
+ *	and no privileges are needed.  A missing file is not
+ *	an error
+ */
+int cache_evict(const char *filename)
+{
+	int fd, rc = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (errno == ENOENT) ? 0 : -errno;
+	/* Dirty or writeback pages would stay cached */
+	if (fdatasync(fd) < 0) {
+		rc = -errno;
+		fprintf(stderr, "Cannot sync: %s: %d %s\n",
+			filename, errno, strerror(errno));
+	} else {
+		rc = -posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		if (rc < 0)
+			fprintf(stderr, "Cannot evict from the page cache: %s: %d %s\n",
+				filename, -rc, strerror(-rc));
+	}
+	(void)close(fd);
+
+	return rc;
+}
+
+/*
+ *  cache_mincore()
+ *	count the resident pages of a file a window at a time
+ */
+static int cache_mincore(const int fd, const uint64_t size, const uint64_t page_size, uint64_t *pages)
+{
+	unsigned char *vec;
+	uint64_t offset;
+	int rc = 0;
+
+	*pages = 0;
+	vec = malloc((size_t)(CACHE_MINCORE_WINDOW / page_size));
+	if (!vec)
+		return -ENOMEM;
+	for (offset = 0; offset < size; offset += CACHE_MINCORE_WINDOW) {
+		const size_t len = (size - offset > CACHE_MINCORE_WINDOW) ?
+			CACHE_MINCORE_WINDOW : (size_t)(size - offset);
+		const size_t n = (len + page_size - 1) / page_size;
+		void *addr;
+		size_t i;
+
+		addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, (off_t)offset);
+		if (addr == MAP_FAILED) {
+			rc = -errno;
+			break;
+		}
+		if (mincore(addr, len, vec) < 0)
+			rc = -errno;
+		(void)munmap(addr, len);
+		if (rc < 0)
+			break;
+		for (i = 0; i < n; i++)
+			*pages += vec[i] & 1;
+	}
+	free(vec);
+
+	return rc;
+}
+
+/*
+ *  cache_resident()
+ *	how many bytes of a file are in the page cache, by
+ *	cachestat() where the kernel has it and otherwise by
+ *	mapping the file and asking mincore().  A missing file
+ *	counts as empty
+ */
+int cache_resident(const char *filename, uint64_t *cached, uint64_t *size)
+{
+	const uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+	struct stat statbuf;
+	uint64_t pages = 0;
+	int fd, rc = 0;
+
+	*cached = 0;
+	*size = 0;
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (errno == ENOENT) ? 0 : -errno;
+	if ((fstat(fd, &statbuf) < 0) || !S_ISREG(statbuf.st_mode)) {
+		(void)close(fd);
+		return 0;
+	}
+	*size = (uint64_t)statbuf.st_size;
+
+	if (!cache_no_cachestat) {
+		cache_range_t range = { 0, 0 };
+		cache_stat_t cs;
+
+		if (syscall(__NR_cachestat, fd, &range, &cs, 0) == 0) {
+			pages = cs.nr_cache;
+			goto out;
+		}
+		/*
+		 *  Blocked by seccomp or missing from the kernel rules it out
+		 *  for good, any other failure (EOPNOTSUPP on hugetlbfs say)
+		 *  is for this file only, mincore counts it either way
+		 */
+		if ((errno == ENOSYS) || (errno == EPERM))
+			cache_no_cachestat = true;
+	}
+	if (*size)
+		rc = cache_mincore(fd, *size, page_size, &pages);
+out:
+	(void)close(fd);
+	*cached = pages * page_size;
+	if (*cached > *size)
+		*cached = *size;
+
+	return rc;
+}
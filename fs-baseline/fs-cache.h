@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+#ifndef __FS_CACHE_H__
+#define __FS_CACHE_H__
+
+#include <stdint.h>
+
+/* How test files are taken out of the page cache before each round */
+typedef enum {
+	CACHE_EVICT = 0,	/* fdatasync and POSIX_FADV_DONTNEED the test files */
+	CACHE_DROP,		/* sync and drop all caches, needs root */
+	CACHE_KEEP,		/* Leave the page cache alone */
+} cache_mode_t;
+
+#define CACHE_COLD_PCT		(1.0)	/* At or below, a round starts cold */
+#define CACHE_WARM_PCT		(99.0)	/* At or above, a round starts warm */
+
+extern int cache_mode_parse(const char *str);
+extern const char *cache_mode_name(const cache_mode_t mode);
+extern const char *cache_state(const double pct);
+extern int cache_evict(const char *filename);
+extern int cache_resident(const char *filename, uint64_t *cached, uint64_t *size);
+
+#endif
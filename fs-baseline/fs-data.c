@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "fs-test.h"
+#include "fs-rand.h"
+#include "fs-data.h"
+
+/*
+ *  Random bytes come from eight xoroshiro128+ generators run
+ *  as four independent pairs of lanes in GCC vectors, so the
+ *  fill is SIMD on SSE2 and NEON and the four steps overlap.
+ *  xoroshiro128+ needs only adds, shifts and xors, so no lane
+ *  multiplies are needed.
+ */
+#define DATA_LANES		(2)
+#define DATA_VECS		(4)
+
+typedef uint64_t data_vec_t __attribute__((vector_size(DATA_LANES * sizeof(uint64_t))));
+typedef uint64_t data_uvec_t __attribute__((vector_size(DATA_LANES * sizeof(uint64_t)), aligned(8), __may_alias__));
+
+#define DATA_ROTL(x, k)		(((x) << (k)) | ((x) >> (64 - (k))))
+#define DATA_STEP(s0, s1)				\
+do {							\
+	s1 ^= s0;					\
+	s0 = DATA_ROTL(s0, 24) ^ s1 ^ (s1 << 16);	\
+	s1 = DATA_ROTL(s1, 37);				\
+} while (0)
+
+static const char *data_mode_names[] = {
+	"const",
+	"random",
+};
+
+/*
+ *  data_mode_parse()
+ *	parse const or random
+ */
+int data_mode_parse(const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(data_mode_names) / sizeof(data_mode_names[0]); i++) {
+		if (!strcmp(str, data_mode_names[i]))
+			return (int)i;
+	}
+	return -1;
+}
+
+/*
+ *  data_mode_name()
+ *	name of a data mode
+ */
+const char *data_mode_name(const data_mode_t mode)
+{
+	return data_mode_names[mode];
+}
+
+/*
+ *  data_compress_parse()
+ *	parse a compression ratio of at least 1
+ */
+int data_compress_parse(const char *str, double *ratio)
+{
+	char *end;
+	const double r = strtod(str, &end);
+
+	if ((end == str) || *end || !isfinite(r) || (r < 1.0))
+		return -1;
+	*ratio = r;
+	return 0;
+}
+
+/*
+ *  data_gen_init()
+ *	set up a writer's generator.  Setup layouts take their
+ *	own keys so later writes never repeat them, and the
+ *	same keys for any instance so a layout is a function
+ *	of the seed alone
+ */
+void data_gen_init(data_gen_t *gen, const test_context_t *test, const bool setup)
+{
+	uint64_t x = test->randseed ^ 0xda7ada7ada7ada7aULL;
+
+	memset(gen, 0, sizeof(*gen));
+	gen->active = (test->data_mode == DATA_RANDOM);
+	gen->pool_seed = rand_splitmix64(&x);
+	x = test->randseed + ((setup ? 1 : ((uint64_t)test->instance << 1)) * 0x9e3779b97f4a7c15ULL);
+	gen->seed = rand_splitmix64(&x);
+	gen->random_frac = (uint32_t)ceil(65536.0 / test->data_compress);
+	gen->dedupe = test->data_dedupe;
+}
+
+/*
+ *  data_random()
+ *	fill len bytes from the generators seeded by key
+ */
+static void data_random(uint8_t *p, size_t len, const uint64_t key)
+{
+	data_vec_t a0, a1, b0, b1, c0, c1, d0, d1, r[DATA_VECS];
+	uint64_t x = key;
+	int i;
+
+	for (i = 0; i < DATA_LANES; i++) {
+		a0[i] = rand_splitmix64(&x);
+		a1[i] = rand_splitmix64(&x);
+		b0[i] = rand_splitmix64(&x);
+		b1[i] = rand_splitmix64(&x);
+		c0[i] = rand_splitmix64(&x);
+		c1[i] = rand_splitmix64(&x);
+		d0[i] = rand_splitmix64(&x);
+		d1[i] = rand_splitmix64(&x);
+	}
+	for (;;) {
+		r[0] = a0 + a1;
+		r[1] = b0 + b1;
+		r[2] = c0 + c1;
+		r[3] = d0 + d1;
+		if (len < sizeof(r))
+			break;
+		((data_uvec_t *)p)[0] = r[0];
+		((data_uvec_t *)p)[1] = r[1];
+		((data_uvec_t *)p)[2] = r[2];
+		((data_uvec_t *)p)[3] = r[3];
+		p += sizeof(r);
+		len -= sizeof(r);
+		DATA_STEP(a0, a1);
+		DATA_STEP(b0, b1);
+		DATA_STEP(c0, c1);
+		DATA_STEP(d0, d1);
+	}
+	memcpy(p, r, len);
+}
+
+/*
+ *  data_fill()
+ *	fill a buffer about to be written, chunk by chunk.
+ *	Each chunk is random up to the compression target and
+ *	zero after it, which compressors squeeze out
+ */
+void data_fill(data_gen_t *gen, void *buf, const size_t size)
+{
+	uint8_t *p = (uint8_t *)buf;
+	size_t left = size;
+
+	while (left) {
+		const size_t len = left < DATA_CHUNK ? left : DATA_CHUNK;
+		size_t rlen = (((len * gen->random_frac) >> 16) + 7) & ~(size_t)7;
+		uint64_t x = gen->seed + gen->serial++;
+		uint64_t key = rand_splitmix64(&x);
+
+		if (gen->dedupe && ((key % 100) < gen->dedupe)) {
+			x = gen->pool_seed + ((key >> 32) % DATA_DEDUPE_POOL);
+			key = rand_splitmix64(&x);
+		}
+		if (rlen > len)
+			rlen = len;
+		data_random(p, rlen, key);
+		memset(p + rlen, 0, len - rlen);
+		p += len;
+		left -= len;
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+#ifndef __FS_DATA_H__
+#define __FS_DATA_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fs-test.h"
+
+#define DATA_CHUNK		(4096)	/* Compression and dedupe granularity */
+#define DATA_DEDUPE_POOL	(1024)	/* Distinct chunks the deduped ones repeat */
+
+/*
+ *  Per writer data generator.  Each chunk's bytes are a
+ *  function of a 64 bit key: unique chunks take a key from
+ *  the writer's own sequence so no two ever match, deduped
+ *  chunks take one of a pool of keys shared by all writers
+ */
+typedef struct {
+	bool		active;		/* DATA_RANDOM */
+	uint64_t	seed;		/* Key of this writer's unique chunks */
+	uint64_t	pool_seed;	/* Key of the shared dedupe pool */
+	uint64_t	serial;		/* Chunks generated so far */
+	uint32_t	random_frac;	/* Random part of a chunk, 16.16 fixed point */
+	uint32_t	dedupe;		/* Percentage of chunks from the pool */
+} data_gen_t;
+
+extern int data_mode_parse(const char *str);
+extern const char *data_mode_name(const data_mode_t mode);
+extern int data_compress_parse(const char *str, double *ratio);
+extern void data_gen_init(data_gen_t *gen, const test_context_t *test, const bool setup);
+extern void data_fill(data_gen_t *gen, void *buf, const size_t size);
+
+/*
+ *  data_gen_seek()
+ *	key the next chunk by its position, so a layout can be
+ *	generated a slice at a time in any order.  offset must
+ *	be a multiple of DATA_CHUNK
+ */
+static inline void data_gen_seek(data_gen_t *gen, const uint64_t offset)
+{
+	gen->serial = offset / DATA_CHUNK;
+}
+
+#endif
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "fs-test.h"
+#include "fs-affinity.h"
+#include "fs-rand.h"
+#include "fs-read-setup.h"
+#include "fs-db.h"
+
+/*
+ *  Database emulation.  Worker 0 is the WAL writer, worker 1
+ *  the checkpointer and the rest run transactions: O_DIRECT
+ *  page reads at random over the data file, then a page is
+ *  dirtied and a WAL record committed.  Committers queue their
+ *  records and wait, the WAL writer writes out everything
+ *  queued and fdatasyncs it in one go while the next batch
+ *  builds up, so one sync commits many transactions.  Every
+ *  checkpoint interval the checkpointer writes all dirty pages
+ *  back and fdatasyncs the data file, reads made meanwhile are
+ *  reported apart.  The state below is shared by the workers
+ *  of the single db group.
+ */
+static const char *db_hist_names[] = {
+	"commit",
+	"read",
+	"read ckpt",
+	"wal sync",
+	"page write",
+	"checkpoint",
+};
+
+typedef struct {
+	pthread_mutex_t	lock;
+	pthread_cond_t	wal_cond;	/* Records queued or committers done */
+	pthread_cond_t	durable_cond;	/* WAL durable up to durable_lsn */
+	pthread_cond_t	ckpt_cond;	/* Committers done */
+	uint8_t		*wal_buf[2];	/* Filling and being written */
+	size_t		wal_len;	/* Bytes queued in wal_buf[0] */
+	uint64_t	lsn;		/* Records queued */
+	uint64_t	durable_lsn;	/* Records on stable storage */
+	uint32_t	committers;	/* Transaction workers still running */
+	int		err;		/* WAL failure, fails all commits */
+	bool		ckpt_active;
+	uint64_t	pages;
+	uint64_t	*dirty;		/* Pages dirtied since the last checkpoint */
+	char		wal_path[PATH_MAX];
+} db_shared_t;
+
+static db_shared_t db_state;
+static bool db_state_init;
+
+const char *db_hist_name(const db_hist_t hist)
+{
+	return db_hist_names[hist];
+}
+
+/*
+ *  db_check()
+ *	each role needs a worker and pages must suit O_DIRECT
+ */
+int db_check(const test_context_t *test)
+{
+	if (test->threads < DB_MIN_THREADS) {
+		fprintf(stderr, "Database emulation needs at least %d threads\n", DB_MIN_THREADS);
+		return -1;
+	}
+	if (test->block_size % 512) {
+		fprintf(stderr, "Database page size must be a multiple of 512 bytes\n");
+		return -1;
+	}
+	if (test->db_txn_reads < 1) {
+		fprintf(stderr, "Database transactions need at least one page read\n");
+		return -1;
+	}
+	return 0;
+}
+
+static void db_record(
+	test_context_t *test,
+	const db_hist_t hist,
+	const io_dir_t dir,
+	const uint64_t bytes,
+	const uint64_t ns)
+{
+	histogram_record(&test->db_hist[hist], ns);
+	counters_update(test->counters, 1, bytes, ns);
+	test->dir_ops[dir]++;
+	test->dir_bytes[dir] += bytes;
+}
+
+static int db_error(test_context_t *test, const char *what, const char *path)
+{
+	const int err = errno;
+
+	fprintf(stderr, "Database %s of %s failed: %d %s\n",
+		what, path, err, strerror(err));
+	test->ret = -err;
+	return -err;
+}
+
+static void *db_buffer(test_context_t *test, const size_t size)
+{
+	void *buffer;
+
+	buffer = affinity_alloc_buffer(size, test->node);
+	if (!buffer) {
+		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
+			errno, strerror(errno));
+		test->ret = -ENOMEM;
+		return NULL;
+	}
+	memset(buffer, test->instance & 0xff, size);
+
+	return buffer;
+}
+
+/*
+ *  db_commit()
+ *	queue a WAL record for a page update and wait
+ *	until a group commit has made it durable
+ */
+static int db_commit(const test_context_t *test, const uint64_t page)
+{
+	db_shared_t *db = &db_state;
+	uint64_t *rec, lsn;
+	int rc;
+
+	pthread_mutex_lock(&db->lock);
+	rec = (uint64_t *)(db->wal_buf[0] + db->wal_len);
+	lsn = ++db->lsn;
+	rec[0] = lsn;
+	rec[1] = page;
+	rec[2] = test->instance;
+	db->wal_len += DB_WAL_RECORD;
+	pthread_cond_signal(&db->wal_cond);
+	while ((db->durable_lsn < lsn) && !db->err)
+		pthread_cond_wait(&db->durable_cond, &db->lock);
+	rc = db->err;
+	pthread_mutex_unlock(&db->lock);
+
+	return rc;
+}
+
+/*
+ *  db_txn()
+ *	read pages, dirty one and commit
+ */
+static void db_txn(test_context_t *test)
+{
+	db_shared_t *db = &db_state;
+	const size_t bs = (size_t)test->block_size;
+	void *buffer;
+	rand_state_t rand;
+	uint64_t i;
+	int fd;
+
+	buffer = db_buffer(test, bs);
+	if (!buffer)
+		goto done;
+	fd = open(test->filename, O_RDONLY | O_DIRECT | (test->open_flags & O_NOATIME));
+	if (fd < 0) {
+		(void)db_error(test, "open", test->filename);
+		free(buffer);
+		goto done;
+	}
+	rand_seed(&rand, test->randseed, test->instance);
+
+	for (i = 0; (test->time_based || (i < test->per_thread_blocks)) && test_continue(); i++) {
+		uint64_t page, t0;
+		uint32_t j;
+		int rc;
+
+		for (j = 0; j < test->db_txn_reads; j++) {
+			bool ckpt;
+			ssize_t ret;
+			uint64_t ns;
+
+			page = rand_bounded(&rand, db->pages);
+			ckpt = __atomic_load_n(&db->ckpt_active, __ATOMIC_RELAXED);
+			t0 = time_now_ns();
+			ret = pread(fd, buffer, bs, (off_t)(page * bs));
+			if (ret != (ssize_t)bs) {
+				if (ret >= 0)
+					errno = EIO;
+				(void)db_error(test, "page read", test->filename);
+				goto out;
+			}
+			ns = time_now_ns() - t0;
+			histogram_record(&test->lat_hist[IO_DIR_READ], ns);
+			db_record(test, ckpt ? DB_READ_CKPT : DB_READ, IO_DIR_READ, bs, ns);
+		}
+
+		/* The update itself stays in the buffer pool until a checkpoint */
+		page = rand_bounded(&rand, db->pages);
+		__atomic_fetch_or(&db->dirty[page / 64], 1ULL << (page % 64), __ATOMIC_RELAXED);
+
+		t0 = time_now_ns();
+		rc = db_commit(test, page);
+		if (rc < 0) {
+			test->ret = rc;
+			goto out;
+		}
+		t0 = time_now_ns() - t0;
+		histogram_record(&test->lat_hist[IO_DIR_WRITE], t0);
+		db_record(test, DB_COMMIT, IO_DIR_WRITE, DB_WAL_RECORD, t0);
+	}
+out:
+	(void)close(fd);
+	free(buffer);
+done:
+	pthread_mutex_lock(&db->lock);
+	db->committers--;
+	pthread_cond_broadcast(&db->wal_cond);
+	pthread_cond_broadcast(&db->ckpt_cond);
+	pthread_mutex_unlock(&db->lock);
+}
+
+/*
+ *  db_wal()
+ *	group commit, write and sync whatever has been queued
+ *	until the committers are done and the queue is empty
+ */
+static void db_wal(test_context_t *test)
+{
+	db_shared_t *db = &db_state;
+	off_t offset = 0;
+	int fd;
+
+	fd = open(db->wal_path, O_WRONLY | (test->open_flags & O_NOATIME));
+	pthread_mutex_lock(&db->lock);
+	if (fd < 0)
+		db->err = db_error(test, "open", db->wal_path);
+
+	while (!db->err) {
+		uint8_t *buf;
+		uint64_t lsn, t0, ns;
+		size_t len;
+		ssize_t ret;
+
+		while (!db->wal_len && db->committers)
+			pthread_cond_wait(&db->wal_cond, &db->lock);
+		if (!db->wal_len)
+			break;
+		buf = db->wal_buf[0];
+		db->wal_buf[0] = db->wal_buf[1];
+		db->wal_buf[1] = buf;
+		len = db->wal_len;
+		lsn = db->lsn;
+		db->wal_len = 0;
+		pthread_mutex_unlock(&db->lock);
+
+		/* Recycle the written out log rather than grow it */
+		if ((uint64_t)offset + len > DB_WAL_SIZE)
+			offset = 0;
+		t0 = time_now_ns();
+		ret = pwrite(fd, buf, len, offset);
+		if ((ret == (ssize_t)len) && (fdatasync(fd) == 0)) {
+			ns = time_now_ns() - t0;
+			db_record(test, DB_WAL_SYNC, IO_DIR_WRITE, len, ns);
+			ret = 0;
+		} else {
+			if (ret >= 0)
+				errno = EIO;
+			ret = db_error(test, "WAL write", db->wal_path);
+		}
+		offset += len;
+
+		pthread_mutex_lock(&db->lock);
+		if (ret < 0)
+			db->err = (int)ret;
+		else
+			db->durable_lsn = lsn;
+		pthread_cond_broadcast(&db->durable_cond);
+	}
+	/* Committers waiting on a WAL that failed to open must see the error */
+	pthread_cond_broadcast(&db->durable_cond);
+	pthread_mutex_unlock(&db->lock);
+	if (fd >= 0)
+		(void)close(fd);
+}
+
+/*
+ *  db_checkpoint_run()
+ *	write back every page dirtied since the last
+ *	checkpoint, then make them durable
+ */
+static int db_checkpoint_run(test_context_t *test, const int fd, void *buffer)
+{
+	db_shared_t *db = &db_state;
+	const size_t bs = (size_t)test->block_size;
+	const uint64_t words = (db->pages + 63) / 64;
+	const uint64_t t_ckpt = time_now_ns();
+	uint64_t w;
+	int rc = 0;
+
+	__atomic_store_n(&db->ckpt_active, true, __ATOMIC_RELAXED);
+	for (w = 0; (rc == 0) && (w < words); w++) {
+		uint64_t bits = __atomic_exchange_n(&db->dirty[w], 0, __ATOMIC_RELAXED);
+
+		while (bits) {
+			const uint64_t page = (w * 64) + (uint64_t)__builtin_ctzll(bits);
+			const uint64_t t0 = time_now_ns();
+
+			bits &= bits - 1;
+			if (pwrite(fd, buffer, bs, (off_t)(page * bs)) != (ssize_t)bs) {
+				rc = db_error(test, "page write", test->filename);
+				break;
+			}
+			db_record(test, DB_PAGE_WRITE, IO_DIR_WRITE, bs, time_now_ns() - t0);
+		}
+	}
+	if ((rc == 0) && (fdatasync(fd) < 0))
+		rc = db_error(test, "checkpoint sync", test->filename);
+	if (rc == 0)
+		histogram_record(&test->db_hist[DB_CKPT], time_now_ns() - t_ckpt);
+	__atomic_store_n(&db->ckpt_active, false, __ATOMIC_RELAXED);
+
+	return rc;
+}
+
+/*
+ *  db_checkpoint()
+ *	a checkpoint every db_ckpt_ns until the
+ *	committers are done
+ */
+static void db_checkpoint(test_context_t *test)
+{
+	db_shared_t *db = &db_state;
+	const size_t bs = (size_t)test->block_size;
+	void *buffer;
+	int fd;
+
+	buffer = db_buffer(test, bs);
+	if (!buffer)
+		return;
+	fd = open(test->filename, O_WRONLY | O_DIRECT | (test->open_flags & O_NOATIME));
+	if (fd < 0) {
+		(void)db_error(test, "open", test->filename);
+		free(buffer);
+		return;
+	}
+
+	pthread_mutex_lock(&db->lock);
+	while (db->committers) {
+		struct timespec deadline;
+		uint64_t ns;
+		int rc;
+
+		(void)clock_gettime(CLOCK_MONOTONIC, &deadline);
+		ns = (uint64_t)deadline.tv_nsec + test->db_ckpt_ns;
+		deadline.tv_sec += (time_t)(ns / NS_PER_SEC);
+		deadline.tv_nsec = (long)(ns % NS_PER_SEC);
+		while (db->committers &&
+		       (pthread_cond_timedwait(&db->ckpt_cond, &db->lock, &deadline) != ETIMEDOUT))
+			;
+		if (!db->committers)
+			break;
+		pthread_mutex_unlock(&db->lock);
+		rc = db_checkpoint_run(test, fd, buffer);
+		pthread_mutex_lock(&db->lock);
+		if (rc < 0)
+			break;
+	}
+	pthread_mutex_unlock(&db->lock);
+	(void)close(fd);
+	free(buffer);
+}
+
+void *db(void *ctxt)
+{
+	test_context_t *test = (test_context_t *)ctxt;
+	uint64_t time_start, time_end, bytes;
+
+	test->ret = 0;
+	time_start = time_now_ns();
+	switch (test->instance) {
+	case 0:
+		db_wal(test);
+		break;
+	case 1:
+		db_checkpoint(test);
+		break;
+	default:
+		db_txn(test);
+		break;
+	}
+	time_end = time_now_ns();
+
+	bytes = test->dir_bytes[IO_DIR_READ] + test->dir_bytes[IO_DIR_WRITE];
+	test->ops = test->dir_ops[IO_DIR_READ] + test->dir_ops[IO_DIR_WRITE];
+	test->duration_ns = (time_end > time_start) ? time_end - time_start : 1;
+	test->response_time_ns = test->ops ? test->duration_ns / test->ops : 0;
+	test->rate = (double)bytes * NS_PER_SEC / (double)test->duration_ns;
+	test->op_rate = (double)test->ops * NS_PER_SEC / (double)test->duration_ns;
+
+	return NULL;
+}
+
+static void db_state_free(void)
+{
+	db_shared_t *db = &db_state;
+
+	if (!db_state_init)
+		return;
+	pthread_cond_destroy(&db->ckpt_cond);
+	pthread_cond_destroy(&db->durable_cond);
+	pthread_cond_destroy(&db->wal_cond);
+	pthread_mutex_destroy(&db->lock);
+	free(db->dirty);
+	free(db->wal_buf[1]);
+	free(db->wal_buf[0]);
+	db_state_init = false;
+}
+
+/*
+ *  db_wal_create()
+ *	write out the whole WAL with zeros so that, as with
+ *	recycled WAL segments, log writes land on written
+ *	extents and fdatasync() has no metadata to sync
+ */
+static int db_wal_create(const char *path)
+{
+	const size_t chunk = 1 << 20;
+	uint64_t offset;
+	void *zeros;
+	int fd, rc = 0;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot create WAL %s: %d %s\n",
+			path, errno, strerror(errno));
+		return -errno;
+	}
+	zeros = calloc(1, chunk);
+	if (!zeros) {
+		fprintf(stderr, "Out of memory allocating WAL buffer\n");
+		(void)close(fd);
+		return -ENOMEM;
+	}
+	for (offset = 0; offset < DB_WAL_SIZE; offset += chunk) {
+		if (pwrite(fd, zeros, chunk, (off_t)offset) != (ssize_t)chunk) {
+			rc = errno ? -errno : -EIO;
+			fprintf(stderr, "Cannot write WAL %s: %d %s\n",
+				path, -rc, strerror(-rc));
+			break;
+		}
+	}
+	if ((rc == 0) && (fsync(fd) < 0)) {
+		rc = -errno;
+		fprintf(stderr, "Cannot sync WAL %s: %d %s\n",
+			path, errno, strerror(errno));
+	}
+	free(zeros);
+	(void)close(fd);
+
+	return rc;
+}
+
+/*
+ *  db_init()
+ *	lay out the data file, write out the WAL and
+ *	reset the shared state for the round
+ */
+int db_init(test_context_t *test)
+{
+	db_shared_t *db = &db_state;
+	const size_t wal_size = (size_t)test->threads * DB_WAL_RECORD;
+	pthread_condattr_t attr;
+	int rc;
+
+	rc = read_init(test);
+	if (rc < 0)
+		return rc;
+
+	db_state_free();
+	memset(db, 0, sizeof(*db));
+	db->pages = test->file_size / test->block_size;
+	db->committers = test->threads - 2;
+	db->dirty = calloc((size_t)((db->pages + 63) / 64), sizeof(*db->dirty));
+	if ((posix_memalign((void **)&db->wal_buf[0], 4096, wal_size) != 0) ||
+	    (posix_memalign((void **)&db->wal_buf[1], 4096, wal_size) != 0) ||
+	    !db->dirty) {
+		fprintf(stderr, "Out of memory allocating database state\n");
+		free(db->dirty);
+		free(db->wal_buf[1]);
+		free(db->wal_buf[0]);
+		return -ENOMEM;
+	}
+	memset(db->wal_buf[0], 0xff, wal_size);
+	memset(db->wal_buf[1], 0xff, wal_size);
+
+	(void)pthread_condattr_init(&attr);
+	(void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	(void)pthread_mutex_init(&db->lock, NULL);
+	(void)pthread_cond_init(&db->wal_cond, NULL);
+	(void)pthread_cond_init(&db->durable_cond, NULL);
+	(void)pthread_cond_init(&db->ckpt_cond, &attr);
+	(void)pthread_condattr_destroy(&attr);
+	db_state_init = true;
+
+	snprintf(db->wal_path, sizeof(db->wal_path), "%s-wal", test->filename);
+
+	return db_wal_create(db->wal_path);
+}
+
+int db_deinit(test_context_t *test)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s-wal", test->filename);
+	(void)unlink(path);
+	db_state_free();
+
+	return read_deinit(test);
+}
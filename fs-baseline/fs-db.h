@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_DB_H__
+#define __FS_DB_H__
+
+#include "fs-test.h"
+
+#define DB_MIN_THREADS		(3)		/* WAL writer, checkpointer and a committer */
+#define DB_WAL_RECORD		(512)		/* Bytes logged per transaction */
+#define DB_WAL_SIZE		(64ULL << 20)	/* Zero filled log, recycled when full */
+
+/* Database emulation latencies, one histogram each per thread */
+typedef enum {
+	DB_COMMIT = 0,		/* Transaction commit until its WAL record is durable */
+	DB_READ,		/* Page read, no checkpoint running */
+	DB_READ_CKPT,		/* Page read while a checkpoint runs */
+	DB_WAL_SYNC,		/* WAL group write and fdatasync */
+	DB_PAGE_WRITE,		/* Checkpoint page write */
+	DB_CKPT,		/* Whole checkpoint including its fdatasync */
+	DB_HISTS
+} db_hist_t;
+
+extern void *db(void *ctxt);
+extern int db_init(test_context_t *test);
+extern int db_deinit(test_context_t *test);
+extern int db_check(const test_context_t *test);
+extern const char *db_hist_name(const db_hist_t hist);
+
+#endif
@@ -33,6 +33,46 @@ static const char *stat_result_table[] = {
 	"StdDev"
 };
 
+/*
+ *  Latency percentiles are also reported from the histogram
+ *  merged over all rounds, the other stats have no such value
+ */
+static const char *all_rounds_label = "AllRounds";
+
+/*
+ *  Each job group's results over all rounds, in the
+ *  units of the matching stat_table entries
+ */
+typedef enum {
+	GROUP_DURATION,
+	GROUP_READ_RATE,
+	GROUP_WRITE_RATE,
+	GROUP_READ_OP_RATE,
+	GROUP_WRITE_OP_RATE,
+	GROUP_LAT_P50,
+	GROUP_LAT_P99,
+	GROUP_LAT_P999,
+	GROUP_LAT_MAX,
+	GROUP_MAX_VAL,
+} group_val_t;
+
+static const char *group_labels[] = {
+	"Duration (secs)",
+	"Read Rate (MB/sec)",
+	"Write Rate (MB/sec)",
+	"Read Op-Rate (Ops/sec)",
+	"Write Op-Rate (Ops/sec)",
+	"Latency p50 (us)",
+	"Latency p99 (us)",
+	"Latency p99.9 (us)",
+	"Latency max (us)",
+};
+
+static bool all_rounds(const stat_val_t s)
+{
+	return (s >= STAT_LAT_P50) && (s <= STAT_WRITE_LAT_MAX);
+}
+
 static void label_to_str(char *dst, const char *src, const size_t len)
 {
 	const char *ptr1 = src;
@@ -63,9 +103,41 @@ static void label_to_str(char *dst, const char *src, const size_t len)
 	*ptr2 = '\0';
 }
 
-int dump_results_csv(FILE *fp, stat_t *results)
+/*
+ *  group_vals()
+ *	a job group's rates over its time in all rounds and
+ *	the latency of its reads and writes together
+ */
+static void group_vals(const job_group_t *job, double *vals)
+{
+	const double secs = (double)job->total_ns / NS_PER_SEC;
+	histogram_t hist;
+	uint32_t d;
+
+	histogram_reset(&hist);
+	for (d = 0; d < IO_DIRS; d++)
+		histogram_merge(&hist, &job->lat_total[d]);
+
+	vals[GROUP_DURATION] = secs;
+	vals[GROUP_READ_RATE] = secs > 0.0 ?
+		(double)job->total_bytes[IO_DIR_READ] / secs / 1048576.0 : 0.0;
+	vals[GROUP_WRITE_RATE] = secs > 0.0 ?
+		(double)job->total_bytes[IO_DIR_WRITE] / secs / 1048576.0 : 0.0;
+	vals[GROUP_READ_OP_RATE] = secs > 0.0 ?
+		(double)job->total_ops[IO_DIR_READ] / secs : 0.0;
+	vals[GROUP_WRITE_OP_RATE] = secs > 0.0 ?
+		(double)job->total_ops[IO_DIR_WRITE] / secs : 0.0;
+	vals[GROUP_LAT_P50] = (double)histogram_percentile(&hist, 50.0) / 1000.0;
+	vals[GROUP_LAT_P99] = (double)histogram_percentile(&hist, 99.0) / 1000.0;
+	vals[GROUP_LAT_P999] = (double)histogram_percentile(&hist, 99.9) / 1000.0;
+	vals[GROUP_LAT_MAX] = (double)hist.max_ns / 1000.0;
+}
+
+int dump_results_csv(FILE *fp, stat_t *results, const stat_t *lat_all,
+	const job_group_t *jobs, const uint32_t njobs)
 {
 	char buf[64];
+	uint32_t g;
 	int i, j;
 
 	/* Headings First */
@@ -95,11 +167,45 @@ int dump_results_csv(FILE *fp, stat_t *results)
 		}
 		fprintf(fp, "\n");
 	}
+
+	fprintf(fp, "%s", all_rounds_label);
+	for (j = 0; stat_table[j].stat != STAT_MAX_VAL; j++) {
+		stat_val_t s = stat_table[j].stat;
+
+		if (s == STAT_NULL || stat_table[j].ignore)
+			continue;
+		if (all_rounds(s))
+			fprintf(fp, ", %.3f", lat_all->val[s] / stat_table[j].scale);
+		else
+			fprintf(fp, ",");
+	}
+	fprintf(fp, "\n");
+
+	if (!njobs)
+		return 0;
+
+	/* Job groups follow as a second table */
+	fprintf(fp, "\nGroup");
+	for (j = 0; j < GROUP_MAX_VAL; j++)
+		fprintf(fp, ", %s", group_labels[j]);
+	fprintf(fp, "\n");
+	for (g = 0; g < njobs; g++) {
+		double vals[GROUP_MAX_VAL];
+
+		group_vals(&jobs[g], vals);
+		fprintf(fp, "%s", jobs[g].name);
+		for (j = 0; j < GROUP_MAX_VAL; j++)
+			fprintf(fp, ", %.3f", vals[j]);
+		fprintf(fp, "\n");
+	}
+
 	return 0;
 }
 
-int dump_results_yaml(FILE *fp, stat_t *results)
+int dump_results_yaml(FILE *fp, stat_t *results, const stat_t *lat_all,
+	const job_group_t *jobs, const uint32_t njobs)
 {
+	uint32_t g;
 	int i, j;
 
 	fprintf(fp, "---\n");
@@ -124,14 +230,36 @@ int dump_results_yaml(FILE *fp, stat_t *results)
 				stat_result_table[i],
 				results[i].val[s]);
 		}
+		if (all_rounds(s))
+			fprintf(fp, "    %s: %.3f\n", all_rounds_label,
+				lat_all->val[s] / stat_table[j].scale);
+	}
+
+	if (!njobs)
+		return 0;
+
+	fprintf(fp, "fs-test-groups:\n");
+	for (g = 0; g < njobs; g++) {
+		double vals[GROUP_MAX_VAL];
+
+		group_vals(&jobs[g], vals);
+		fprintf(fp, "  - group: %s\n", jobs[g].name);
+		for (j = 0; j < GROUP_MAX_VAL; j++) {
+			char buf[256];
+
+			label_to_str(buf, group_labels[j], sizeof(buf));
+			fprintf(fp, "    %s: %.3f\n", buf, vals[j]);
+		}
 	}
 
 	return 0;
 }
 
 
-int dump_results_json(FILE *fp, stat_t *results)
+int dump_results_json(FILE *fp, stat_t *results, const stat_t *lat_all,
+	const job_group_t *jobs, const uint32_t njobs)
 {
+	uint32_t g;
 	int i, j;
 	bool first = true;
 
@@ -155,25 +283,51 @@ int dump_results_json(FILE *fp, stat_t *results)
 		if (!first)
 			fprintf(fp, ",\n");
 		fprintf(fp, "    {\n");
-		fprintf(fp, "      \"metric\":\"%s\"\n", buf2);
+		fprintf(fp, "      \"metric\":\"%s\"", buf2);
 		for (i = 0; i < STAT_RESULT_MAX; i++) {
-			fprintf(fp, "      \"%s\":%.3f\n",
+			fprintf(fp, ",\n      \"%s\":%.3f",
 				stat_result_table[i],
 				results[i].val[s]);
 		}
-		fprintf(fp, "    }");
+		if (all_rounds(s))
+			fprintf(fp, ",\n      \"%s\":%.3f", all_rounds_label,
+				lat_all->val[s] / stat_table[j].scale);
+		fprintf(fp, "\n    }");
 
 		first = false;
 	}
 
 	fprintf(fp, "\n");
-	fprintf(fp, "  ]\n");
+	fprintf(fp, "  ]");
+
+	if (njobs) {
+		fprintf(fp, ",\n");
+		fprintf(fp, "  \"fs-test-groups\":\n");
+		fprintf(fp, "  [\n");
+		for (g = 0; g < njobs; g++) {
+			double vals[GROUP_MAX_VAL];
+
+			group_vals(&jobs[g], vals);
+			fprintf(fp, "    {\n");
+			fprintf(fp, "      \"group\":\"%s\"", jobs[g].name);
+			for (j = 0; j < GROUP_MAX_VAL; j++) {
+				char buf[256];
+
+				label_to_str(buf, group_labels[j], sizeof(buf));
+				fprintf(fp, ",\n      \"%s\":%.3f", buf, vals[j]);
+			}
+			fprintf(fp, "\n    }%s\n", g + 1 < njobs ? "," : "");
+		}
+		fprintf(fp, "  ]");
+	}
+	fprintf(fp, "\n");
 	fprintf(fp, "}\n");
 
 	return 0;
 }
 
-int dump_results(const char *filename, stat_t *results)
+int dump_results(const char *filename, stat_t *results, const stat_t *lat_all,
+	const job_group_t *jobs, const uint32_t njobs)
 {
 	FILE *fp;
 	int rc;
@@ -188,13 +342,13 @@ int dump_results(const char *filename, stat_t *results)
 	}
 
 	if (!strcmp(dot, ".csv"))
-		rc = dump_results_csv(fp, results);
+		rc = dump_results_csv(fp, results, lat_all, jobs, njobs);
 	else if (!strcmp(dot, ".yaml"))
-		rc = dump_results_yaml(fp, results);
+		rc = dump_results_yaml(fp, results, lat_all, jobs, njobs);
 	else if (!strcmp(dot, ".json"))
-		rc = dump_results_json(fp, results);
+		rc = dump_results_json(fp, results, lat_all, jobs, njobs);
 	else
-		rc = dump_results_csv(fp, results);
+		rc = dump_results_csv(fp, results, lat_all, jobs, njobs);
 
 	fclose(fp);
 
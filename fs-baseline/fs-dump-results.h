@@ -21,6 +21,9 @@
 #ifndef __FS_DUMP_RESULTS_H__
 #define __FS_DUMP_RESULTS_H__
 
-extern int dump_results(const char *filename, stat_t *results);
+#include "fs-job.h"
+
+extern int dump_results(const char *filename, stat_t *results, const stat_t *lat_all,
+	const job_group_t *jobs, const uint32_t njobs);
 
 #endif
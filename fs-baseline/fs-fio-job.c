@@ -0,0 +1,599 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "fs-test.h"
+#include "fs-job.h"
+#include "fs-fio-job.h"
+
+/*
+ *  The subset of the fio job file format used by the
+ *  fio-tests jobs.  [global] settings apply to every later
+ *  section and each other section becomes a job group.
+ *  A section with stonewall waits for all earlier groups,
+ *  it and the groups after it form the next phase.
+ */
+#define FIO_MAX_SETTINGS	(128)
+#define FIO_LINE_LEN		(4096)
+
+typedef struct {
+	char		*key;
+	char		*val;		/* NULL for flags given without a value */
+	uint32_t	line;
+} fio_setting_t;
+
+typedef struct {
+	fio_setting_t	s[FIO_MAX_SETTINGS];
+	uint32_t	n;
+} fio_section_t;
+
+/* Settings that can only be mapped once the whole section is known */
+typedef struct {
+	const char	*rw;
+	const char	*engine;
+	int		direct;		/* -1 if not given */
+	uint64_t	size;		/* Per fio job, i.e. per thread */
+	uint64_t	filesize;
+	uint64_t	nrfiles;
+	uint64_t	runtime_ns;
+	bool		stonewall;
+	const char	*filename;
+	const char	*directory;
+} fio_state_t;
+
+static const struct {
+	const char *rw;
+	const char *tag;
+} fio_rw[] = {
+	{ "read",	"rd_seq" },
+	{ "write",	"wr_seq" },
+	{ "randread",	"rd_rnd" },
+	{ "randwrite",	"wr_rnd" },
+	{ "rw",		"rdwr_seq" },
+	{ "readwrite",	"rdwr_seq" },
+	{ "randrw",	"rdwr_rnd" },
+	{ NULL,		NULL }
+};
+
+static const struct {
+	const char *ioengine;
+	const char *engine;
+} fio_engines[] = {
+	{ "sync",	"sync" },
+	{ "psync",	"psync" },
+	{ "pvsync2",	"pvsync2" },
+	{ "io_uring",	"io_uring" },
+	{ "libaio",	"aio" },
+	{ "mmap",	"mmap" },
+	{ NULL,		NULL }
+};
+
+/*
+ *  fio's own logging and reporting, these do not change the I/O
+ */
+static const char *fio_ignored[] = {
+	"name",
+	"description",
+	"group_reporting",
+	"clat_percentiles",
+	"disk_util",
+	"write_bw_log",
+	"write_lat_log",
+	"write_iops_log",
+	"log_avg_msec",
+	NULL
+};
+
+/*
+ *  options that change what fio does but have no fs-test
+ *  equivalent, these are dropped with a warning
+ */
+static const char *fio_unsupported[] = {
+	"exec_prerun",
+	"invalidate",
+	"unlink",
+	"fadvise_hint",
+	"fallocate",
+	"mem_align",
+	"thinktime_spin",
+	"openfiles",
+	"file_service_type",
+	"create_on_open",
+	NULL
+};
+
+static char *fio_trim(char *str)
+{
+	char *end;
+
+	while (isspace((unsigned char)*str))
+		str++;
+	end = str + strlen(str);
+	while ((end > str) && isspace((unsigned char)end[-1]))
+		end--;
+	*end = '\0';
+
+	return str;
+}
+
+/*
+ *  fio_expand()
+ *	substitute ${VAR} from the environment, a variable
+ *	that is not set is an error rather than left empty
+ */
+static int fio_expand(
+	const char *path,
+	const uint32_t line,
+	const char *in,
+	char *out,
+	const size_t len)
+{
+	size_t o = 0;
+
+	while (*in) {
+		const char *val = in;
+		size_t n = 1;
+
+		if ((in[0] == '$') && (in[1] == '{')) {
+			const char *end = strchr(in + 2, '}');
+			char name[256];
+
+			if (!end || (end == in + 2) || ((size_t)(end - in - 2) >= sizeof(name))) {
+				fprintf(stderr, "%s:%" PRIu32 ": bad variable reference\n", path, line);
+				return -1;
+			}
+			memcpy(name, in + 2, (size_t)(end - in - 2));
+			name[end - in - 2] = '\0';
+			val = getenv(name);
+			if (!val) {
+				fprintf(stderr, "%s:%" PRIu32 ": ${%s} is not set in the environment\n",
+					path, line, name);
+				return -1;
+			}
+			n = strlen(val);
+			in = end + 1;
+		} else {
+			in++;
+		}
+		if (o + n >= len) {
+			fprintf(stderr, "%s:%" PRIu32 ": line too long\n", path, line);
+			return -1;
+		}
+		memcpy(out + o, val, n);
+		o += n;
+	}
+	out[o] = '\0';
+
+	return 0;
+}
+
+static void fio_section_free(fio_section_t *sec)
+{
+	uint32_t i;
+
+	for (i = 0; i < sec->n; i++)
+		free(sec->s[i].key);
+	sec->n = 0;
+}
+
+/*
+ *  fio_section_add()
+ *	keep a setting, the key and value share one allocation
+ */
+static int fio_section_add(
+	fio_section_t *sec,
+	const char *path,
+	const uint32_t line,
+	const char *key,
+	const char *val)
+{
+	const size_t klen = strlen(key) + 1;
+	fio_setting_t *s;
+
+	if (sec->n == FIO_MAX_SETTINGS) {
+		fprintf(stderr, "%s:%" PRIu32 ": more than %d settings in a section\n",
+			path, line, FIO_MAX_SETTINGS);
+		return -1;
+	}
+	s = &sec->s[sec->n];
+	s->key = malloc(klen + (val ? strlen(val) + 1 : 0));
+	if (!s->key) {
+		fprintf(stderr, "Out of memory parsing %s\n", path);
+		return -1;
+	}
+	memcpy(s->key, key, klen);
+	s->val = val ? strcpy(s->key + klen, val) : NULL;
+	s->line = line;
+	sec->n++;
+
+	return 0;
+}
+
+/*
+ *  fio_set()
+ *	apply one fio option to a group, options that need the
+ *	whole section are noted in the state and mapped later
+ */
+static int fio_set(
+	job_group_t *job,
+	fio_state_t *st,
+	const char *path,
+	const fio_setting_t *s)
+{
+	const char *key = s->key, *val = s->val;
+	size_t i;
+
+	for (i = 0; fio_ignored[i]; i++) {
+		if (!strcmp(key, fio_ignored[i]))
+			return 0;
+	}
+	for (i = 0; fio_unsupported[i]; i++) {
+		if (!strcmp(key, fio_unsupported[i])) {
+			fprintf(stderr, "%s:%" PRIu32 ": warning: fio option %s is not "
+				"supported, ignoring it\n", path, s->line, key);
+			return 0;
+		}
+	}
+
+	/* Flags may be given without a value */
+	if (!strcmp(key, "time_based"))
+		return job_set(job, "time-based", val);
+	if (!strcmp(key, "refill_buffers"))
+		return job_set(job, "data", (!val || strcmp(val, "0")) ? "random" : "const");
+	if (!strcmp(key, "stonewall") || !strcmp(key, "wait_for_previous")) {
+		st->stonewall = !val || strcmp(val, "0");
+		return 0;
+	}
+	if (!strcmp(key, "direct")) {
+		st->direct = !val || strcmp(val, "0");
+		return 0;
+	}
+	if (!strcmp(key, "buffered")) {
+		st->direct = val && !strcmp(val, "0");
+		return 0;
+	}
+
+	if (!val || !*val) {
+		fprintf(stderr, "%s:%" PRIu32 ": %s needs a value\n", path, s->line, key);
+		return -1;
+	}
+	if (!strcmp(key, "rw") || !strcmp(key, "readwrite"))
+		st->rw = val;
+	else if (!strcmp(key, "ioengine"))
+		st->engine = val;
+	else if (!strcmp(key, "size"))
+		st->size = get_u64_byte(val);
+	else if (!strcmp(key, "filesize"))
+		st->filesize = get_u64_byte(val);
+	else if (!strcmp(key, "nrfiles"))
+		st->nrfiles = get_u64(val);
+	else if (!strcmp(key, "runtime"))
+		st->runtime_ns = get_u64(val) * NS_PER_SEC;
+	else if (!strcmp(key, "filename"))
+		st->filename = val;
+	else if (!strcmp(key, "directory"))
+		st->directory = val;
+	else if (!strcmp(key, "bs") || !strcmp(key, "blocksize"))
+		return job_set(job, "bs", val);
+	else if (!strcmp(key, "bssplit"))
+		return job_set(job, "bssplit", val);
+	else if (!strcmp(key, "numjobs"))
+		return job_set(job, "threads", val);
+	else if (!strcmp(key, "iodepth"))
+		return job_set(job, "iodepth", val);
+	else if (!strcmp(key, "rwmixread"))
+		return job_set(job, "rwmixread", val);
+	else if (!strcmp(key, "rwmixwrite")) {
+		char buf[16];
+		uint32_t v = get_u32(val);
+
+		if (v > 100) {
+			fprintf(stderr, "%s:%" PRIu32 ": rwmixwrite must be 0..100\n",
+				path, s->line);
+			return -1;
+		}
+		snprintf(buf, sizeof(buf), "%" PRIu32, 100 - v);
+		return job_set(job, "rwmixread", buf);
+	} else if (!strcmp(key, "thinktime"))
+		return job_set(job, "thinktime", val);
+	else if (!strcmp(key, "thinktime_blocks"))
+		return job_set(job, "thinktime-blocks", val);
+	else if (!strcmp(key, "rate_iops"))
+		return job_set(job, "rate-iops", val);
+	else if (!strcmp(key, "rate"))
+		return job_set(job, "rate", val);
+	else if (!strcmp(key, "random_distribution"))
+		return job_set(job, "random-distribution", val);
+	else if (!strcmp(key, "buffer_compress_percentage")) {
+		/* fio gives the percentage of each buffer that compresses away */
+		const uint32_t pct = get_u32(val);
+		char buf[32];
+
+		if (pct >= 100) {
+			fprintf(stderr, "%s:%" PRIu32 ": buffer_compress_percentage must be 0..99\n",
+				path, s->line);
+			return -1;
+		}
+		snprintf(buf, sizeof(buf), "%g", 100.0 / (100 - pct));
+		return job_set(job, "compress-ratio", buf);
+	} else if (!strcmp(key, "dedupe_percentage"))
+		return job_set(job, "dedupe", val);
+	else {
+		fprintf(stderr, "%s:%" PRIu32 ": fio option %s is not supported\n",
+			path, s->line, key);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  fio_group()
+ *	turn a section, on top of [global], into a group.  A fio
+ *	job's size is per clone, a group's size is over all of
+ *	its threads
+ */
+static int fio_group(
+	job_group_t *job,
+	const char *name,
+	const fio_section_t *global,
+	const fio_section_t *sec,
+	const job_group_t *defaults,
+	const char *path,
+	fio_job_t *fio,
+	char **filename)
+{
+	fio_state_t st;
+	const char *tag = NULL, *engine = NULL;
+	uint64_t size;
+	uint32_t i;
+	char buf[32];
+
+	memset(&st, 0, sizeof(st));
+	st.rw = "read";
+	st.direct = -1;
+	st.nrfiles = 1;
+
+	*job = *defaults;
+	if (strlen(name) >= sizeof(job->name)) {
+		fprintf(stderr, "%s: section name %s is longer than %d characters\n",
+			path, name, JOB_NAME_LEN - 1);
+		return -1;
+	}
+	strcpy(job->name, name);
+	/* fio's default block size unless -b gave one */
+	if (!(job->size_flags & OPT_BLOCK_SIZE))
+		(void)job_set(job, "bs", "4k");
+
+	for (i = 0; i < global->n; i++) {
+		if (fio_set(job, &st, path, &global->s[i]) < 0)
+			return -1;
+	}
+	for (i = 0; i < sec->n; i++) {
+		if (fio_set(job, &st, path, &sec->s[i]) < 0)
+			return -1;
+	}
+
+	for (i = 0; fio_rw[i].rw; i++) {
+		if (!strcmp(st.rw, fio_rw[i].rw))
+			tag = fio_rw[i].tag;
+	}
+	if (!tag) {
+		fprintf(stderr, "%s: [%s] rw=%s is not supported\n", path, name, st.rw);
+		return -1;
+	}
+	if (st.nrfiles > 1) {
+		/* Many files, each created, written once and unlinked in one directory */
+		if (strcmp(tag, "wr_seq")) {
+			fprintf(stderr, "%s: [%s] nrfiles > 1 is only supported with rw=write\n",
+				path, name);
+			return -1;
+		}
+		tag = "meta";
+	}
+	if (job_set(job, "test", tag) < 0)
+		return -1;
+
+	if (st.engine) {
+		for (i = 0; fio_engines[i].ioengine; i++) {
+			if (!strcmp(st.engine, fio_engines[i].ioengine))
+				engine = fio_engines[i].engine;
+		}
+		if (!engine) {
+			fprintf(stderr, "%s: [%s] ioengine=%s is not supported\n",
+				path, name, st.engine);
+			return -1;
+		}
+		/* Buffered libaio blocks in io_submit(), i.e. it is synchronous */
+		if (!strcmp(engine, "aio") && (st.direct != 1) &&
+		    !(job->test.open_flags & O_DIRECT)) {
+			printf("Job %s: buffered libaio runs on the psync I/O engine\n", name);
+			engine = "psync";
+		}
+		if (job_set(job, "engine", engine) < 0)
+			return -1;
+	}
+	if ((st.direct >= 0) && (job_set(job, "direct", st.direct ? "1" : "0") < 0))
+		return -1;
+
+	size = st.size ? st.size : st.filesize;
+	if (!strcmp(tag, "meta")) {
+		/* A block per file, a file size of size / nrfiles */
+		snprintf(buf, sizeof(buf), "%" PRIu64, (size / st.nrfiles) ? size / st.nrfiles : 1);
+		if (size && (job_set(job, "bs", buf) < 0))
+			return -1;
+		snprintf(buf, sizeof(buf), "%" PRIu64, st.nrfiles * job->threads);
+		if ((job_set(job, "blocks", buf) < 0) ||
+		    (job_set(job, "depth", "0") < 0) ||
+		    (job_set(job, "meta-ops", "none") < 0))
+			return -1;
+	} else if (size) {
+		snprintf(buf, sizeof(buf), "%" PRIu64, size * job->threads);
+		if (job_set(job, "size", buf) < 0)
+			return -1;
+	}
+
+	if (st.filename) {
+		if (*filename && strcmp(*filename, st.filename)) {
+			fprintf(stderr, "%s: [%s] only one shared filename is supported\n",
+				path, name);
+			return -1;
+		}
+		if (!*filename)
+			*filename = strdup(st.filename);
+		if (!*filename) {
+			fprintf(stderr, "Out of memory parsing %s\n", path);
+			return -1;
+		}
+		job->shared = true;
+	}
+	if (st.directory && !fio->directory) {
+		fio->directory = strdup(st.directory);
+		if (!fio->directory) {
+			fprintf(stderr, "Out of memory parsing %s\n", path);
+			return -1;
+		}
+	}
+
+	if (st.stonewall && fio->groups)
+		fio->phases++;
+	job->phase = fio->phases - 1;
+	if (st.runtime_ns > fio->runtime_ns)
+		fio->runtime_ns = st.runtime_ns;
+
+	return 0;
+}
+
+/*
+ *  fio_job_load()
+ *	read a fio job file into at most max groups, each
+ *	starting from a copy of the command line defaults
+ */
+int fio_job_load(
+	const char *path,
+	const job_group_t *defaults,
+	job_group_t *jobs,
+	const uint32_t max,
+	fio_job_t *fio)
+{
+	static fio_section_t global, sec;
+	char raw[FIO_LINE_LEN], line[FIO_LINE_LEN], name[FIO_LINE_LEN];
+	char *filename = NULL;	/* The shared file's name */
+	bool in_global = false, in_job = false;
+	uint32_t lineno = 0;
+	int rc = -1;
+	FILE *fp;
+
+	memset(fio, 0, sizeof(*fio));
+	fio->phases = 1;
+	*name = '\0';
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Cannot open job file %s: %d %s\n",
+			path, errno, strerror(errno));
+		return -errno;
+	}
+
+	for (;;) {
+		bool eof = !fgets(raw, sizeof(raw), fp);
+		char *str, *eq;
+
+		lineno++;
+		if (!eof) {
+			/* Comments are skipped before any ${VAR} in them is expanded */
+			for (str = raw; isspace((unsigned char)*str); str++)
+				;
+			if (!*str || (*str == '#') || (*str == ';'))
+				continue;
+			if (fio_expand(path, lineno, raw, line, sizeof(line)) < 0)
+				goto out;
+			str = fio_trim(line);
+			if (!*str)
+				continue;
+		}
+		/* A new section or the end of the file completes the last job */
+		if (eof || (*str == '[')) {
+			if (in_job) {
+				if (fio->groups == max) {
+					fprintf(stderr, "%s: maximum of %" PRIu32 " jobs allowed\n",
+						path, max);
+					goto out;
+				}
+				if (fio_group(&jobs[fio->groups], name, &global, &sec,
+				    defaults, path, fio, &filename) < 0)
+					goto out;
+				fio->groups++;
+			}
+			fio_section_free(&sec);
+			in_job = in_global = false;
+			if (eof)
+				break;
+
+			eq = strchr(str, ']');
+			if (!eq || eq[1]) {
+				fprintf(stderr, "%s:%" PRIu32 ": bad section header\n", path, lineno);
+				goto out;
+			}
+			*eq = '\0';
+			str = fio_trim(str + 1);
+			if (!strcmp(str, "global")) {
+				in_global = true;
+			} else {
+				strcpy(name, str);
+				in_job = true;
+			}
+			continue;
+		}
+		if (!in_global && !in_job) {
+			fprintf(stderr, "%s:%" PRIu32 ": setting outside of a section\n", path, lineno);
+			goto out;
+		}
+		eq = strchr(str, '=');
+		if (eq) {
+			*eq++ = '\0';
+			eq = fio_trim(eq);
+			str = fio_trim(str);
+		}
+		if (fio_section_add(in_global ? &global : &sec, path, lineno, str, eq) < 0)
+			goto out;
+	}
+	if (!fio->groups) {
+		fprintf(stderr, "%s: no jobs found\n", path);
+		goto out;
+	}
+	rc = 0;
+out:
+	fio_section_free(&global);
+	fio_section_free(&sec);
+	free(filename);
+	(void)fclose(fp);
+
+	return rc;
+}
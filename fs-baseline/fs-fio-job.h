@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_FIO_JOB_H__
+#define __FS_FIO_JOB_H__
+
+#include <stdint.h>
+
+#include "fs-job.h"
+
+/*
+ *  What a fio job file sets beyond its groups
+ */
+typedef struct {
+	uint32_t	groups;
+	uint32_t	phases;		/* Split by stonewall */
+	uint64_t	runtime_ns;	/* Longest runtime of any section */
+	char		*directory;	/* First directory given, or NULL */
+} fio_job_t;
+
+extern int fio_job_load(const char *path, const job_group_t *defaults,
+	job_group_t *jobs, const uint32_t max, fio_job_t *fio);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "fs-test.h"
+#include "fs-affinity.h"
+#include "fs-io-uring.h"
+#include "fs-fsync.h"
+
+/*
+ *  Durability workload, small appends each made durable
+ *  before the next one starts, once per commit method, commit
+ *  size and open mode.  Each combination appends per_thread_blocks
+ *  commits to a freshly truncated file of the worker's own,
+ *  either on one fd or opening and closing the file around
+ *  every commit.  A method the filesystem or kernel rejects
+ *  on its first commit is reported as not supported.
+ */
+static const char *fsync_method_names[] = {
+	"write+fsync",
+	"write+fdatasync",
+	"O_DSYNC",
+	"O_SYNC",
+	"RWF_DSYNC",
+	"sync_file_range",
+	"io_uring+fsync",
+};
+
+typedef struct {
+	test_context_t	*test;
+	char		path[PATH_MAX];
+	void		*buffer;
+	uring_t		*ring;
+} fsync_run_t;
+
+const char *fsync_method_name(const fsync_method_t method)
+{
+	return fsync_method_names[method];
+}
+
+uint32_t fsync_index(const uint32_t mode, const uint32_t size, const fsync_method_t method)
+{
+	return ((mode * FSYNC_MAX_SIZES) + size) * FSYNC_METHODS + (uint32_t)method;
+}
+
+/*
+ *  fsync_methods_parse()
+ *	comma separated list of method names, or all.
+ *	Returns -1 for unknown names
+ */
+int fsync_methods_parse(const char *list)
+{
+	char *str, *token, *saveptr = NULL;
+	int mask = 0;
+
+	if (!strcmp(list, "all"))
+		return FSYNC_ALL_MASK;
+	str = strdup(list);
+	if (!str)
+		return -1;
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		uint32_t m;
+
+		for (m = 0; m < FSYNC_METHODS; m++) {
+			if (!strcmp(token, fsync_method_names[m]))
+				break;
+		}
+		if (m == FSYNC_METHODS) {
+			mask = -1;
+			break;
+		}
+		mask |= 1 << m;
+	}
+	free(str);
+
+	return mask ? mask : -1;
+}
+
+/*
+ *  fsync_sizes_parse()
+ *	comma separated list of up to FSYNC_MAX_SIZES commit sizes
+ */
+int fsync_sizes_parse(const char *list, test_context_t *test)
+{
+	char *str, *token, *saveptr = NULL;
+	uint32_t n = 0;
+	int rc = 0;
+
+	str = strdup(list);
+	if (!str)
+		return -1;
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		if (n == FSYNC_MAX_SIZES) {
+			rc = -1;
+			break;
+		}
+		test->fsync_sizes[n] = get_u64_byte(token);
+		if (test->fsync_sizes[n] < 1) {
+			rc = -1;
+			break;
+		}
+		n++;
+	}
+	free(str);
+	if ((rc == 0) && (n == 0))
+		rc = -1;
+	if (rc == 0)
+		test->fsync_nsizes = n;
+
+	return rc;
+}
+
+/*
+ *  fsync_commit()
+ *	write size bytes at offset and make them durable
+ *	with the given method, returns 0 or -errno
+ */
+static int fsync_commit(
+	fsync_run_t *f,
+	const int fd,
+	const fsync_method_t method,
+	const size_t size,
+	const off_t offset)
+{
+	struct iovec iov;
+	ssize_t ret;
+
+	switch (method) {
+	case FSYNC_RWF_DSYNC:
+		iov.iov_base = f->buffer;
+		iov.iov_len = size;
+		ret = pwritev2(fd, &iov, 1, offset, RWF_DSYNC);
+		break;
+	case FSYNC_URING_LINKED:
+		return io_uring_commit(f->ring, fd, f->buffer, size, offset);
+	default:
+		ret = pwrite(fd, f->buffer, size, offset);
+		break;
+	}
+	if (ret < 0)
+		return -errno;
+	if ((size_t)ret != size)
+		return -EIO;
+
+	switch (method) {
+	case FSYNC_WRITE_FSYNC:
+		ret = fsync(fd);
+		break;
+	case FSYNC_WRITE_FDATASYNC:
+		ret = fdatasync(fd);
+		break;
+	case FSYNC_SYNC_FILE_RANGE:
+		/* Data only, no metadata and no device cache flush */
+		ret = sync_file_range(fd, offset, (off_t)size,
+			SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+			SYNC_FILE_RANGE_WAIT_AFTER);
+		break;
+	default:
+		ret = 0;
+		break;
+	}
+	if (ret < 0) {
+		/* The file does not support this kind of synchronization */
+		return (errno == EINVAL) ? -EOPNOTSUPP : -errno;
+	}
+
+	return 0;
+}
+
+/*
+ *  fsync_unsupported()
+ *	the method itself is not available, any other error,
+ *	EINVAL from the write included, is a real failure
+ */
+static inline bool fsync_unsupported(const int rc)
+{
+	return (rc == -EOPNOTSUPP) || (rc == -ENOSYS);
+}
+
+/*
+ *  fsync_run()
+ *	commits of one method, size and open mode
+ */
+static int fsync_run(
+	fsync_run_t *f,
+	const fsync_method_t method,
+	const uint64_t size,
+	const uint32_t mode,
+	fsync_result_t *res)
+{
+	test_context_t *test = f->test;
+	uint64_t i, t_start;
+	int flags = O_WRONLY | (test->open_flags & ~O_SYNC);
+	int fd, rc = 0;
+
+	if (method == FSYNC_O_DSYNC)
+		flags |= O_DSYNC;
+	else if (method == FSYNC_O_SYNC)
+		flags |= O_SYNC;
+
+	res->size = size;
+	fd = open(f->path, flags | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot create file %s: %d %s\n",
+			f->path, errno, strerror(errno));
+		return -errno;
+	}
+	if (mode == FSYNC_MODE_REOPEN)
+		(void)close(fd);
+
+	t_start = time_now_ns();
+	for (i = 0; (i < test->per_thread_blocks) && test_continue(); i++) {
+		const uint64_t t0 = time_now_ns();
+		uint64_t ns;
+
+		if (mode == FSYNC_MODE_REOPEN) {
+			fd = open(f->path, flags);
+			if (fd < 0) {
+				rc = -errno;
+				break;
+			}
+		}
+		rc = fsync_commit(f, fd, method, (size_t)size, (off_t)(i * size));
+		if (mode == FSYNC_MODE_REOPEN)
+			(void)close(fd);
+		if (rc < 0)
+			break;
+		ns = time_now_ns() - t0;
+
+		histogram_record(&res->lat, ns);
+		histogram_record(&test->lat_hist[IO_DIR_WRITE], ns);
+		counters_update(test->counters, 1, size, ns);
+		test->dir_ops[IO_DIR_WRITE]++;
+		test->dir_bytes[IO_DIR_WRITE] += size;
+		res->commits++;
+	}
+	res->ns += time_now_ns() - t_start;
+	if (mode == FSYNC_MODE_PERSISTENT)
+		(void)close(fd);
+
+	if ((rc < 0) && (i == 0) && fsync_unsupported(rc)) {
+		res->err = -rc;
+		rc = 0;
+	} else if (rc < 0) {
+		fprintf(stderr, "Commit with %s of %s failed: %d %s\n",
+			fsync_method_names[method], f->path, -rc, strerror(-rc));
+	}
+
+	return rc;
+}
+
+void *fsync_test(void *ctxt)
+{
+	test_context_t *test = (test_context_t *)ctxt;
+	const uint32_t nsizes = test->fsync_nsizes ? test->fsync_nsizes : 1;
+	uint64_t time_start, time_end, max_size = 0, bytes;
+	fsync_run_t f;
+	uint32_t s, mode, m;
+	int rc = 0;
+
+	test->ret = 0;
+	memset(&f, 0, sizeof(f));
+	f.test = test;
+	snprintf(f.path, sizeof(f.path), "%s-%" PRIu32, test->filename, test->instance);
+	for (s = 0; s < nsizes; s++) {
+		const uint64_t size = test->fsync_nsizes ? test->fsync_sizes[s] : test->block_size;
+
+		if (size > max_size)
+			max_size = size;
+	}
+	f.buffer = affinity_alloc_buffer((size_t)max_size, test->node);
+	if (!f.buffer) {
+		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
+			errno, strerror(errno));
+		test->ret = -ENOMEM;
+		return NULL;
+	}
+	memset(f.buffer, test->instance & 0xff, max_size);
+	if (test->fsync_mask & (1U << FSYNC_URING_LINKED))
+		f.ring = io_uring_commit_open();
+
+	time_start = time_now_ns();
+	/* Time based runs repeat the whole sweep */
+	while ((rc == 0) && test_continue()) {
+		for (mode = 0; (rc == 0) && (mode < FSYNC_MODES); mode++) {
+			for (s = 0; (rc == 0) && (s < nsizes); s++) {
+				const uint64_t size = test->fsync_nsizes ?
+					test->fsync_sizes[s] : test->block_size;
+
+				for (m = 0; (rc == 0) && (m < FSYNC_METHODS) && test_continue(); m++) {
+					fsync_result_t *res = &test->fsync_res[fsync_index(mode, s, m)];
+
+					if (!(test->fsync_mask & (1U << m)))
+						continue;
+					if ((m == FSYNC_URING_LINKED) && !f.ring) {
+						res->size = size;
+						res->err = ENOSYS;
+						continue;
+					}
+					rc = fsync_run(&f, (fsync_method_t)m, size, mode, res);
+				}
+			}
+		}
+		if (!test->time_based)
+			break;
+	}
+	time_end = time_now_ns();
+	(void)unlink(f.path);
+	io_uring_commit_close(f.ring);
+	free(f.buffer);
+	test->ret = rc;
+
+	bytes = test->dir_bytes[IO_DIR_WRITE];
+	test->ops = test->dir_ops[IO_DIR_WRITE];
+	test->duration_ns = (time_end > time_start) ? time_end - time_start : 1;
+	test->response_time_ns = test->ops ? test->duration_ns / test->ops : 0;
+	test->rate = (double)bytes * NS_PER_SEC / (double)test->duration_ns;
+	test->op_rate = (double)test->ops * NS_PER_SEC / (double)test->duration_ns;
+
+	return NULL;
+}
+
+void fsync_results_reset(fsync_result_t *res)
+{
+	uint32_t i;
+
+	for (i = 0; i < FSYNC_RESULTS; i++) {
+		res[i].size = 0;
+		res[i].commits = 0;
+		res[i].ns = 0;
+		res[i].rate = 0.0;
+		res[i].err = 0;
+		histogram_reset(&res[i].lat);
+	}
+}
+
+/*
+ *  fsync_results_add()
+ *	add a worker's round, its rate on each combination
+ *	is over its own time on that combination
+ */
+void fsync_results_add(fsync_result_t *res, const test_context_t *test)
+{
+	uint32_t i;
+
+	for (i = 0; i < FSYNC_RESULTS; i++) {
+		const fsync_result_t *r = &test->fsync_res[i];
+
+		if (r->size)
+			res[i].size = r->size;
+		if (r->err)
+			res[i].err = r->err;
+		res[i].commits += r->commits;
+		if (r->ns)
+			res[i].rate += (double)r->commits * NS_PER_SEC / (double)r->ns;
+		histogram_merge(&res[i].lat, &r->lat);
+	}
+}
+
+static const fsync_result_t *rank_res;
+
+static int fsync_rank_cmp(const void *p1, const void *p2)
+{
+	const double r1 = rank_res[*(const uint32_t *)p1].rate;
+	const double r2 = rank_res[*(const uint32_t *)p2].rate;
+
+	return (r1 < r2) - (r1 > r2);
+}
+
+/*
+ *  fsync_rank()
+ *	indexes of the combinations that made commits,
+ *	fastest first, returns how many there are
+ */
+uint32_t fsync_rank(const fsync_result_t *res, uint32_t *order)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < FSYNC_RESULTS; i++) {
+		if (res[i].commits)
+			order[n++] = i;
+	}
+	rank_res = res;
+	qsort(order, n, sizeof(*order), fsync_rank_cmp);
+
+	return n;
+}
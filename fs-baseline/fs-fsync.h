@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_FSYNC_H__
+#define __FS_FSYNC_H__
+
+#include <stdint.h>
+
+#include "fs-test.h"
+#include "fs-histogram.h"
+
+/* Each commit size is run with a persistent fd and with an open per commit */
+#define FSYNC_MODE_PERSISTENT	(0)
+#define FSYNC_MODE_REOPEN	(1)
+#define FSYNC_MODES		(2)
+#define FSYNC_RESULTS		(FSYNC_MODES * FSYNC_MAX_SIZES * FSYNC_METHODS)
+#define FSYNC_ALL_MASK		((1U << FSYNC_METHODS) - 1)
+
+/*
+ *  Results of one method, size and open mode, of a worker
+ *  or summed over all workers and rounds.  The rate is only
+ *  set in sums, each worker's rate over its own time on the
+ *  combination added up per round
+ */
+typedef struct fsync_result_t {
+	uint64_t	size;		/* Commit size, 0 if not run */
+	uint64_t	commits;
+	uint64_t	ns;		/* Time spent on the combination */
+	double		rate;
+	int		err;		/* errno if the method is not supported */
+	histogram_t	lat;
+} fsync_result_t;
+
+extern void *fsync_test(void *ctxt);
+extern int fsync_methods_parse(const char *list);
+extern int fsync_sizes_parse(const char *list, test_context_t *test);
+extern const char *fsync_method_name(const fsync_method_t method);
+extern uint32_t fsync_index(const uint32_t mode, const uint32_t size, const fsync_method_t method);
+extern void fsync_results_reset(fsync_result_t *res);
+extern void fsync_results_add(fsync_result_t *res, const test_context_t *test);
+extern uint32_t fsync_rank(const fsync_result_t *res, uint32_t *order);
+
+#endif
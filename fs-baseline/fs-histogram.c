@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fs-histogram.h"
+
+void histogram_reset(histogram_t *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+}
+
+/*
+ *  histogram_merge()
+ *	add the counts of src into dst
+ */
+void histogram_merge(histogram_t *dst, const histogram_t *src)
+{
+	uint32_t i;
+
+	if (!src->count)
+		return;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum_ns += src->sum_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/*
+ *  histogram_bucket_max()
+ *	highest value that lands in bucket i
+ */
+static uint64_t histogram_bucket_max(const uint32_t i)
+{
+	const uint32_t shift = i < (2 * HIST_SUB_BUCKETS) ?
+		0 : (i >> HIST_SUB_BITS) - 1;
+	const uint64_t low = (uint64_t)(i - (shift << HIST_SUB_BITS)) << shift;
+
+	return low + (1ULL << shift) - 1;
+}
+
+/*
+ *  histogram_percentile()
+ *	value at the given percentile (0..100), reported as the
+ *	top of the bucket it falls in but never above the max
+ */
+uint64_t histogram_percentile(const histogram_t *hist, const double percentile)
+{
+	uint64_t target, sum = 0;
+	uint32_t i;
+
+	if (!hist->count)
+		return 0;
+
+	target = (uint64_t)((percentile / 100.0) * (double)hist->count + 0.5);
+	if (target < 1)
+		target = 1;
+	if (target > hist->count)
+		target = hist->count;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		sum += hist->buckets[i];
+		if (sum >= target) {
+			const uint64_t val = histogram_bucket_max(i);
+
+			return val < hist->max_ns ? val : hist->max_ns;
+		}
+	}
+	return hist->max_ns;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_HISTOGRAM_H__
+#define __FS_HISTOGRAM_H__
+
+#include <stdint.h>
+
+/*
+ *  Log-linear (HDR style) latency histogram in nanoseconds,
+ *  each power of two range is split into HIST_SUB_BUCKETS
+ *  linear buckets so the error is below 1/HIST_SUB_BUCKETS.
+ *  Values are clamped to 2^HIST_MAX_BITS ns (~68 seconds).
+ */
+#define HIST_SUB_BITS		(6)
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS		(36)
+#define HIST_MAX_NS		((1ULL << HIST_MAX_BITS) - 1)
+#define HIST_BUCKETS		((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+	uint64_t	count;
+	uint64_t	sum_ns;
+	uint64_t	max_ns;
+	uint64_t	buckets[HIST_BUCKETS];
+} __attribute__((aligned(64))) histogram_t;	/* Per thread, keep off shared lines */
+
+/*
+ *  histogram_record()
+ *	add a value, no allocation and no locking, each
+ *	thread records into its own histogram
+ */
+static inline void histogram_record(histogram_t *hist, uint64_t ns)
+{
+	uint32_t msb, shift;
+
+	if (ns > HIST_MAX_NS)
+		ns = HIST_MAX_NS;
+	msb = 63 - (uint32_t)__builtin_clzll(ns | HIST_SUB_BUCKETS);
+	shift = msb - HIST_SUB_BITS;
+
+	hist->buckets[(shift << HIST_SUB_BITS) + (uint32_t)(ns >> shift)]++;
+	hist->count++;
+	hist->sum_ns += ns;
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+}
+
+extern void histogram_reset(histogram_t *hist);
+extern void histogram_merge(histogram_t *dst, const histogram_t *src);
+extern uint64_t histogram_percentile(const histogram_t *hist, const double percentile);
+
+#endif
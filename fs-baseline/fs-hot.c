@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "fs-test.h"
+#include "fs-hot.h"
+
+#define HOT_WARM_BUF_SIZE	(1024 * 1024)
+
+/*
+ *  memcpy() baseline state, the source is one buffer split
+ *  evenly over the threads of a step and each thread copies
+ *  into a block sized buffer of its own, like a read into
+ *  a user buffer from the page cache
+ */
+static uint8_t *hot_src;
+static uint64_t hot_src_size;
+static uint8_t *hot_dst;
+static uint64_t hot_block_size;
+
+static void *hot_copy(void *arg);
+
+test_info_t hot_copy_info = {
+	"Copy", hot_copy, NULL, NULL, "memcpy", "Memory Copy Baseline"
+};
+
+/*
+ *  hot_steps_parse()
+ *	parse a comma list of ascending thread counts
+ */
+int hot_steps_parse(const char *str, uint32_t *steps, uint32_t *n)
+{
+	const char *p = str;
+	uint32_t count = 0;
+
+	while (*p) {
+		char *end;
+		const unsigned long val = strtoul(p, &end, 10);
+
+		if ((end == p) || (val < 1) || (val > UINT32_MAX) ||
+		    (count == HOT_MAX_STEPS) ||
+		    (count && (val <= steps[count - 1])))
+			return -1;
+		steps[count++] = (uint32_t)val;
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -1;
+		p = end;
+	}
+	if (!count)
+		return -1;
+	*n = count;
+
+	return 0;
+}
+
+/*
+ *  hot_warm()
+ *	read a file end to end through the page cache
+ */
+int hot_warm(const char *filename)
+{
+	void *buffer;
+	ssize_t n = 0;
+	int fd, rc = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open for reading: %s: %d %s\n",
+			filename, errno, strerror(errno));
+		return -errno;
+	}
+	buffer = malloc(HOT_WARM_BUF_SIZE);
+	if (!buffer) {
+		fprintf(stderr, "Out of memory allocating read buffer\n");
+		(void)close(fd);
+		return -ENOMEM;
+	}
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	while ((opt_flags & OPT_CONT) && ((n = read(fd, buffer, HOT_WARM_BUF_SIZE)) > 0))
+		;
+	if (n < 0) {
+		fprintf(stderr, "Read failed: %s: %d %s\n",
+			filename, errno, strerror(errno));
+		rc = -errno;
+	}
+	free(buffer);
+	(void)close(fd);
+
+	return rc;
+}
+
+/*
+ *  hot_copy_init()
+ *	allocate and touch the memcpy() buffers, the source
+ *	is as large as the file up to HOT_COPY_MAX so it comes
+ *	from memory rather than the CPU caches
+ */
+int hot_copy_init(const uint64_t size, const uint32_t threads, const uint64_t block_size)
+{
+	hot_src_size = size < HOT_COPY_MAX ? size : HOT_COPY_MAX;
+	hot_block_size = block_size;
+	if (posix_memalign((void **)&hot_src, 4096, (size_t)hot_src_size) != 0) {
+		hot_src = NULL;
+		fprintf(stderr, "Out of memory allocating the memcpy source\n");
+		return -ENOMEM;
+	}
+	if (posix_memalign((void **)&hot_dst, 4096, (size_t)(block_size * threads)) != 0) {
+		hot_dst = NULL;
+		fprintf(stderr, "Out of memory allocating the memcpy buffers\n");
+		hot_copy_free();
+		return -ENOMEM;
+	}
+	memset(hot_src, 0xff, (size_t)hot_src_size);
+	memset(hot_dst, 0, (size_t)(block_size * threads));
+
+	return 0;
+}
+
+uint64_t hot_copy_size(void)
+{
+	return hot_src_size;
+}
+
+void hot_copy_free(void)
+{
+	free(hot_dst);
+	free(hot_src);
+	hot_dst = NULL;
+	hot_src = NULL;
+}
+
+/*
+ *  hot_copy()
+ *	copy as many bytes as a reader of this step reads, a
+ *	block at a time, cycling through this thread's share
+ *	of the source
+ */
+static void *hot_copy(void *arg)
+{
+	test_context_t *test = (test_context_t *)arg;
+	const uint64_t bs = hot_block_size;
+	const uint64_t share = ((hot_src_size / test->threads) / bs) * bs;
+	const uint8_t *src = hot_src + (test->instance * share);
+	uint8_t *dst = hot_dst + (test->instance * bs);
+	uint64_t done = 0, offset = 0;
+
+	test->ret = 0;
+	if (share < bs) {
+		test->ret = -EINVAL;
+		return NULL;
+	}
+	while ((done < test->per_thread_file_size) && test_continue()) {
+		memcpy(dst, src + offset, (size_t)bs);
+		done += bs;
+		offset += bs;
+		if (offset == share)
+			offset = 0;
+	}
+	test->dir_ops[IO_DIR_READ] = done / bs;
+	test->dir_bytes[IO_DIR_READ] = done;
+
+	return NULL;
+}
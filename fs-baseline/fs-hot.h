@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+#ifndef __FS_HOT_H__
+#define __FS_HOT_H__
+
+#include <stdint.h>
+
+#include "fs-test.h"
+
+#define HOT_MAX_STEPS		(16)
+#define HOT_COPY_MAX		(1024ULL * 1024 * 1024)	/* memcpy() source, split over the threads */
+#define HOT_FLAT_GAIN		(0.5)	/* Below this share of the ideal gain scaling has flattened */
+
+extern test_info_t hot_copy_info;
+
+extern int hot_steps_parse(const char *str, uint32_t *steps, uint32_t *n);
+extern int hot_warm(const char *filename);
+extern int hot_copy_init(const uint64_t size, const uint32_t threads, const uint64_t block_size);
+extern uint64_t hot_copy_size(void);
+extern void hot_copy_free(void);
+
+#endif
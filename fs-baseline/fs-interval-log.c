@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fs-test.h"
+#include "fs-interval-log.h"
+
+/*
+ *  Interval logging, a sampler thread wakes every interval_ms,
+ *  reads the live per thread counters and appends one line per
+ *  interval, in the spirit of fio's log_avg_msec logs
+ */
+typedef struct {
+	uint64_t	ops;
+	uint64_t	bytes;
+	uint64_t	lat_sum_ns;
+} interval_snap_t;
+
+static FILE *log_fp;
+static uint32_t log_interval_ms;
+static uint32_t log_round;
+static io_counters_t *log_counters;
+static uint32_t log_ncounters;
+static interval_snap_t log_prev;
+static uint64_t log_start_ns, log_prev_ns;
+static pthread_t log_thread;
+static volatile bool log_stop;
+static bool log_running;
+
+/*
+ *  meminfo_dirty()
+ *	fetch Dirty and Writeback from /proc/meminfo in kB
+ */
+static void meminfo_dirty(uint64_t *dirty_kb, uint64_t *writeback_kb)
+{
+	FILE *fp;
+	char buffer[128];
+
+	*dirty_kb = 0;
+	*writeback_kb = 0;
+
+	if ((fp = fopen("/proc/meminfo", "r")) == NULL)
+		return;
+
+	while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+		unsigned long long val;
+
+		if (sscanf(buffer, "Dirty: %llu", &val) == 1)
+			*dirty_kb = val;
+		else if (sscanf(buffer, "Writeback: %llu", &val) == 1)
+			*writeback_kb = val;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  interval_sample()
+ *	sum the counters, log the delta since the last sample
+ */
+static void interval_sample(void)
+{
+	interval_snap_t now = { 0, 0, 0 };
+	uint64_t lat_max_ns = 0, dirty_kb, writeback_kb, dt_ns, ops;
+	const uint64_t t_now = time_now_ns();
+	uint32_t i;
+
+	for (i = 0; i < log_ncounters; i++) {
+		io_counters_t *c = &log_counters[i];
+		const uint64_t max = __atomic_exchange_n(&c->lat_max_ns, 0, __ATOMIC_RELAXED);
+
+		now.ops += __atomic_load_n(&c->ops, __ATOMIC_RELAXED);
+		now.bytes += __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+		now.lat_sum_ns += __atomic_load_n(&c->lat_sum_ns, __ATOMIC_RELAXED);
+		if (max > lat_max_ns)
+			lat_max_ns = max;
+	}
+	meminfo_dirty(&dirty_kb, &writeback_kb);
+
+	dt_ns = t_now - log_prev_ns;
+	if (dt_ns == 0)
+		dt_ns = 1;
+	ops = now.ops - log_prev.ops;
+
+	fprintf(log_fp, "%" PRIu32 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64
+		", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n",
+		log_round,
+		(t_now - log_start_ns) / 1000000,
+		(uint64_t)((double)(now.bytes - log_prev.bytes) * 1000000000.0 / 1024.0 / (double)dt_ns),
+		(uint64_t)((double)ops * 1000000000.0 / (double)dt_ns),
+		ops ? (now.lat_sum_ns - log_prev.lat_sum_ns) / ops / 1000 : 0,
+		lat_max_ns / 1000,
+		dirty_kb, writeback_kb);
+
+	log_prev = now;
+	log_prev_ns = t_now;
+}
+
+static void *interval_log_thread(void *arg)
+{
+	struct timespec next;
+
+	(void)arg;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!log_stop) {
+		next.tv_nsec += (long)log_interval_ms * 1000000L;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		/* Absolute deadlines so the sampling does not drift */
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+		if (log_stop)
+			break;
+		interval_sample();
+	}
+	return NULL;
+}
+
+/*
+ *  interval_log_open()
+ *	create the log file and write the column header
+ */
+int interval_log_open(const char *filename, const uint32_t interval_ms)
+{
+	if ((log_fp = fopen(filename, "w")) == NULL) {
+		fprintf(stderr, "Cannot create interval log %s: %d %s\n",
+			filename, errno, strerror(errno));
+		return -errno;
+	}
+	log_interval_ms = interval_ms;
+	fprintf(log_fp, "# round, msec, KB/s, IOPS, lat_avg_us, lat_max_us, dirty_kB, writeback_kB\n");
+
+	return 0;
+}
+
+/*
+ *  interval_log_start()
+ *	start sampling n counters for a round, the counters
+ *	must be zeroed before the workers start
+ */
+int interval_log_start(const uint32_t round, io_counters_t *counters, const uint32_t n)
+{
+	int ret;
+
+	if (!log_fp)
+		return 0;
+
+	log_round = round;
+	log_counters = counters;
+	log_ncounters = n;
+	memset(&log_prev, 0, sizeof(log_prev));
+	log_start_ns = log_prev_ns = time_now_ns();
+	log_stop = false;
+
+	ret = pthread_create(&log_thread, NULL, interval_log_thread, NULL);
+	if (ret) {
+		fprintf(stderr, "Cannot create interval log thread: %d %s\n",
+			ret, strerror(ret));
+		return -ret;
+	}
+	log_running = true;
+
+	return 0;
+}
+
+/*
+ *  interval_log_stop()
+ *	stop the sampler and log the tail of the round
+ */
+void interval_log_stop(void)
+{
+	if (!log_running)
+		return;
+
+	log_stop = true;
+	pthread_join(log_thread, NULL);
+	log_running = false;
+	interval_sample();
+	fflush(log_fp);
+}
+
+void interval_log_close(void)
+{
+	interval_log_stop();
+	if (log_fp) {
+		(void)fclose(log_fp);
+		log_fp = NULL;
+	}
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-io-aio.h"
+
+/*
+ *  Native kernel AIO via the raw system calls, this is what
+ *  fio's libaio engine uses underneath but without the
+ *  library dependency
+ */
+static inline int sys_io_setup(unsigned nr_events, aio_context_t *ctx)
+{
+	return (int)syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static inline int sys_io_destroy(aio_context_t ctx)
+{
+	return (int)syscall(__NR_io_destroy, ctx);
+}
+
+static inline int sys_io_submit(aio_context_t ctx, long nr, struct iocb **iocbs)
+{
+	return (int)syscall(__NR_io_submit, ctx, nr, iocbs);
+}
+
+static inline int sys_io_getevents(aio_context_t ctx, long min_nr, long nr,
+	struct io_event *events, struct timespec *timeout)
+{
+	return (int)syscall(__NR_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+/*
+ *  io_aio_run()
+ *	keep up to iodepth ops in flight, submitting at most
+ *	iodepth_batch iocbs per io_submit() and reaping at least
+ *	iodepth_batch_complete events when the queue is full.
+ *	A paced op that is not yet due is held back while
+ *	completions are reaped with a timeout
+ */
+int io_aio_run(io_state_t *io)
+{
+	test_context_t *test = io->test;
+	aio_context_t ctx = 0;
+	struct iocb *iocbs, **pending;
+	struct io_event *events;
+	io_op_t *ops;
+	uint32_t *free_slots, nfree, npending = 0, inflight = 0, batch, batch_complete;
+	uint32_t held_slot = 0;
+	bool done = false, held = false;
+	int rc = 0;
+
+	batch = test->iodepth_batch ? test->iodepth_batch : io->depth;
+	if (batch > io->depth)
+		batch = io->depth;
+	batch_complete = test->iodepth_batch_complete ? test->iodepth_batch_complete : 1;
+	if (batch_complete > io->depth)
+		batch_complete = io->depth;
+
+	if (sys_io_setup(io->depth, &ctx) < 0) {
+		fprintf(stderr, "Cannot setup AIO context: %d %s\n",
+			errno, strerror(errno));
+		return -errno;
+	}
+
+	iocbs = calloc(io->depth, sizeof(*iocbs));
+	pending = calloc(io->depth, sizeof(*pending));
+	events = calloc(io->depth, sizeof(*events));
+	ops = calloc(io->depth, sizeof(*ops));
+	free_slots = calloc(io->depth, sizeof(*free_slots));
+	if (!iocbs || !pending || !events || !ops || !free_slots) {
+		fprintf(stderr, "Out of memory allocating AIO slots\n");
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (nfree = 0; nfree < io->depth; nfree++)
+		free_slots[nfree] = io->depth - nfree - 1;
+
+	for (;;) {
+		struct timespec ts, *timeout;
+		long min_nr;
+		int n, i;
+		uint64_t t_now = time_now_ns();
+
+		while (!done && (held || nfree) && npending < batch) {
+			struct iocb *iocb;
+			io_op_t *op;
+			uint32_t slot;
+
+			if (held) {
+				slot = held_slot;
+				held = false;
+				if (!test_continue()) {
+					free_slots[nfree++] = slot;
+					done = true;
+					break;
+				}
+			} else {
+				slot = free_slots[nfree - 1];
+				if (!io_next(io, &ops[slot])) {
+					done = true;
+					break;
+				}
+				nfree--;
+			}
+			op = &ops[slot];
+			/* A paced op keeps its slot until it is due */
+			if (io_issue_delay(op, t_now)) {
+				held = true;
+				held_slot = slot;
+				break;
+			}
+			if (!op->start_ns)
+				op->start_ns = t_now;
+
+			if (op->write)
+				io_write_prep(io, io_buffer(io, slot), op);
+			iocb = &iocbs[slot];
+			memset(iocb, 0, sizeof(*iocb));
+			iocb->aio_data = slot;
+			iocb->aio_lio_opcode = op->write ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+			iocb->aio_fildes = (uint32_t)io->fd;
+			iocb->aio_buf = (uint64_t)(uintptr_t)io_buffer(io, slot);
+			iocb->aio_nbytes = op->size;
+			iocb->aio_offset = (int64_t)op->offset;
+			pending[npending++] = iocb;
+		}
+
+		if (npending) {
+			n = sys_io_submit(ctx, npending, pending);
+			if (n < 0) {
+				if ((errno != EAGAIN) && (errno != EINTR)) {
+					fprintf(stderr, "io_submit failed: %d %s\n",
+						errno, strerror(errno));
+					rc = -errno;
+					done = true;
+					/* Give the unsubmitted slots back */
+					for (i = 0; i < (int)npending; i++)
+						free_slots[nfree++] = (uint32_t)pending[i]->aio_data;
+					npending = 0;
+				}
+			} else {
+				/* Partial submits leave the rest pending for the next call */
+				inflight += (uint32_t)n;
+				npending -= (uint32_t)n;
+				memmove(pending, pending + n, npending * sizeof(*pending));
+			}
+		}
+		if (!inflight && !npending) {
+			if (!held || done)
+				break;
+			/* Idle until the held op is due */
+			if (!io_wait(&ops[held_slot]))
+				break;
+			continue;
+		}
+		if (!inflight)
+			continue;
+
+		timeout = NULL;
+		if (held && !done) {
+			/* Reap until the held op is due */
+			uint64_t delay = io_issue_delay(&ops[held_slot], time_now_ns());
+
+			if (delay > IO_WAIT_SLICE_NS)
+				delay = IO_WAIT_SLICE_NS;
+			ts.tv_sec = (time_t)(delay / NS_PER_SEC);
+			ts.tv_nsec = (long)(delay % NS_PER_SEC);
+			timeout = &ts;
+			min_nr = 1;
+		} else if (done || !nfree) {
+			/* Only block when nothing more can be queued */
+			min_nr = inflight < batch_complete ? inflight : batch_complete;
+		} else {
+			min_nr = 0;
+		}
+
+		n = sys_io_getevents(ctx, min_nr, inflight, events, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "io_getevents failed: %d %s\n",
+				errno, strerror(errno));
+			if (rc == 0)
+				rc = -errno;
+			break;
+		}
+		t_now = time_now_ns();
+		for (i = 0; i < n; i++) {
+			const uint32_t slot = (uint32_t)events[i].data;
+			const int64_t res = events[i].res;
+
+			if (ops[slot].write)
+				io_verify_written(io, &ops[slot]);
+			if (res < 0) {
+				if (rc == 0)
+					rc = io_error(io, &ops[slot], (int)-res);
+				done = true;
+			} else if ((size_t)res < ops[slot].size) {
+				/* Queued ops are not resubmitted, a short one fails the run */
+				if (rc == 0)
+					rc = io_error(io, &ops[slot], EIO);
+				done = true;
+			} else {
+				io_account(io, ops[slot].write, 1, (uint64_t)res, t_now - ops[slot].start_ns);
+				if (!ops[slot].write)
+					io_verify_read(io, io_buffer(io, slot), ops[slot].offset,
+						(size_t)res);
+			}
+			free_slots[nfree++] = slot;
+			inflight--;
+		}
+	}
+
+out:
+	free(free_slots);
+	free(ops);
+	free(events);
+	free(pending);
+	free(iocbs);
+	/* io_destroy() waits for any ops still in flight */
+	(void)sys_io_destroy(ctx);
+
+	return rc;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-io-mmap.h"
+
+typedef struct {
+	const char *name;
+	int value;
+} io_name_t;
+
+static const io_name_t advices[] = {
+	{ "normal",	MADV_NORMAL },
+	{ "seq",	MADV_SEQUENTIAL },
+	{ "random",	MADV_RANDOM },
+	{ "willneed",	MADV_WILLNEED },
+#if defined(MADV_HUGEPAGE)
+	{ "hugepage",	MADV_HUGEPAGE },
+#endif
+	{ NULL,		0 }
+};
+
+static const io_name_t msyncs[] = {
+	{ "none",	IO_MSYNC_NONE },
+	{ "end",	IO_MSYNC_END },
+	{ "async",	IO_MSYNC_ASYNC },
+	{ "sync",	IO_MSYNC_SYNC },
+	{ NULL,		0 }
+};
+
+/* Serialises growing the file when threads map their regions */
+static pthread_mutex_t io_mmap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int io_name_lookup(const io_name_t *names, const char *name)
+{
+	for (; names->name; names++) {
+		if (!strcmp(names->name, name))
+			return names->value;
+	}
+	return -1;
+}
+
+/*
+ *  io_mmap_advice()
+ *	map a --madvise name to a MADV_* value, -1 if invalid
+ */
+int io_mmap_advice(const char *name)
+{
+	return io_name_lookup(advices, name);
+}
+
+/*
+ *  io_mmap_msync()
+ *	map a --msync name to an io_msync_t, -1 if invalid
+ */
+int io_mmap_msync(const char *name)
+{
+	return io_name_lookup(msyncs, name);
+}
+
+/*
+ *  io_mmap_extend()
+ *	writes to a mapping beyond EOF raise SIGBUS, so make
+ *	sure the file covers the region, never shrink it
+ */
+static int io_mmap_extend(io_state_t *io, const off_t end)
+{
+	struct stat buf;
+	int rc = 0;
+
+	pthread_mutex_lock(&io_mmap_lock);
+	if (fstat(io->fd, &buf) < 0) {
+		rc = -errno;
+	} else if (buf.st_size < end) {
+		if (ftruncate(io->fd, end) < 0)
+			rc = -errno;
+	}
+	pthread_mutex_unlock(&io_mmap_lock);
+
+	if (rc < 0)
+		fprintf(stderr, "Cannot extend %s for mmap: %d %s\n",
+			io->test->filename, -rc, strerror(-rc));
+	return rc;
+}
+
+/*
+ *  io_mmap_run()
+ *	map the thread's region of the file and memcpy
+ *	block_size chunks between it and the I/O buffer
+ */
+int io_mmap_run(io_state_t *io)
+{
+	test_context_t *test = io->test;
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const off_t map_offset = io->base & ~((off_t)page_size - 1);
+	const size_t delta = (size_t)(io->base - map_offset);
+	const size_t len = test->per_thread_file_size + delta;
+	const bool writes = io->pattern->mix != IO_MIX_READ;
+	void *buffer = io_buffer(io, 0);
+	uint8_t *map, *region;
+	int prot = PROT_READ, flags = MAP_SHARED, rc = 0;
+	uint64_t t_prev;
+	io_op_t op;
+
+	if (writes) {
+		prot |= PROT_WRITE;
+		rc = io_mmap_extend(io, io->base + (off_t)test->per_thread_file_size);
+		if (rc < 0)
+			return rc;
+	}
+	if (test->io_flags & IO_FLAG_MMAP_POPULATE)
+		flags |= MAP_POPULATE;
+
+	map = mmap(NULL, len, prot, flags, io->fd, map_offset);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Cannot mmap %s: %d %s\n",
+			test->filename, errno, strerror(errno));
+		return -errno;
+	}
+	if (test->mmap_advice >= 0) {
+		if (madvise(map, len, test->mmap_advice) < 0)
+			fprintf(stderr, "madvise failed: %d %s\n",
+				errno, strerror(errno));
+	}
+	region = map + delta;
+
+	t_prev = time_now_ns();
+	while (io_next(io, &op)) {
+		uint8_t *ptr = region + (op.offset - io->base);
+		uint64_t t_now;
+
+		if (op.start_ns)
+			t_prev = op.start_ns;
+		if (op.write) {
+			io_write_prep(io, buffer, &op);
+			memcpy(ptr, buffer, op.size);
+			if (test->mmap_msync >= IO_MSYNC_ASYNC) {
+				/* msync needs a page aligned address */
+				uint8_t *page = (uint8_t *)((uintptr_t)ptr & ~(page_size - 1));
+
+				if (msync(page, op.size + (size_t)(ptr - page),
+				    test->mmap_msync == IO_MSYNC_SYNC ? MS_SYNC : MS_ASYNC) < 0) {
+					rc = io_error(io, &op, errno);
+					break;
+				}
+			}
+		} else {
+			memcpy(buffer, ptr, op.size);
+			io_verify_read(io, buffer, op.offset, op.size);
+		}
+		t_now = time_now_ns();
+		io_account(io, op.write, 1, op.size, t_now - t_prev);
+		t_prev = t_now;
+	}
+
+	if ((rc == 0) && writes && (test->mmap_msync == IO_MSYNC_END)) {
+		if (msync(map, len, MS_SYNC) < 0) {
+			fprintf(stderr, "msync failed: %d %s\n",
+				errno, strerror(errno));
+			rc = -errno;
+		}
+	}
+	(void)munmap(map, len);
+
+	return rc;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-io-pvsync2.h"
+
+/* Upstream merged this as RWF_DONTCACHE, older headers lack it */
+#if !defined(RWF_UNCACHED)
+#if defined(RWF_DONTCACHE)
+#define RWF_UNCACHED	RWF_DONTCACHE
+#else
+#define RWF_UNCACHED	(0x00000080)
+#endif
+#endif
+
+static const struct {
+	const char *name;
+	int flag;
+} rwf_names[] = {
+	{ "hipri",	RWF_HIPRI },
+	{ "nowait",	RWF_NOWAIT },
+	{ "dsync",	RWF_DSYNC },
+	{ "uncached",	RWF_UNCACHED },
+	{ NULL,		0 }
+};
+
+/*
+ *  io_rwf_flags()
+ *	parse a comma separated list of RWF_* flag names,
+ *	returns -1 if a name is not recognised
+ */
+int io_rwf_flags(const char *list)
+{
+	char *str, *token, *saveptr = NULL;
+	int flags = 0;
+
+	str = strdup(list);
+	if (!str)
+		return -1;
+
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		int i;
+
+		for (i = 0; rwf_names[i].name; i++) {
+			if (!strcmp(token, rwf_names[i].name))
+				break;
+		}
+		if (!rwf_names[i].name) {
+			free(str);
+			return -1;
+		}
+		flags |= rwf_names[i].flag;
+	}
+	free(str);
+
+	return flags;
+}
+
+/*
+ *  io_pvsync2_xfer()
+ *	issue one vectored transfer of total bytes, a RWF_NOWAIT
+ *	op that would block is retried without RWF_NOWAIT and
+ *	counted.  File systems that cannot do RWF_NOWAIT for a
+ *	direction (e.g. buffered writes) get it dropped for the
+ *	rest of the run.  A short transfer fails the run
+ */
+static int io_pvsync2_xfer(
+	io_state_t *io,
+	const io_op_t *op,
+	const struct iovec *iov,
+	const int iovcnt,
+	const size_t total,
+	int *dir_flags)
+{
+	int flags = *dir_flags;
+	const uint64_t t_start = op->start_ns ? op->start_ns : time_now_ns();
+	ssize_t n;
+
+	for (;;) {
+		if (op->write)
+			n = pwritev2(io->fd, iov, iovcnt, op->offset, flags);
+		else
+			n = preadv2(io->fd, iov, iovcnt, op->offset, flags);
+		if ((n < 0) && (flags & RWF_NOWAIT)) {
+			if (errno == EAGAIN) {
+				io->nowait_retries++;
+				flags &= ~RWF_NOWAIT;
+				continue;
+			}
+			if (errno == EOPNOTSUPP) {
+				fprintf(stderr, "RWF_NOWAIT not supported for %s, ignoring it\n",
+					op->write ? "writes" : "reads");
+				flags &= ~RWF_NOWAIT;
+				*dir_flags = flags;
+				continue;
+			}
+		}
+		break;
+	}
+	if (n < 0)
+		return io_error(io, op, errno);
+	/* The next ops are already generated, so the rest cannot be handed back */
+	if ((size_t)n < total)
+		return io_error(io, op, EIO);
+
+	io_account(io, op->write, (uint64_t)iovcnt, (uint64_t)n, time_now_ns() - t_start);
+	if (!op->write && io->verify_unit) {
+		off_t offset = op->offset;
+		int i;
+
+		for (i = 0; (i < iovcnt) && (n > 0); i++) {
+			const size_t len = (size_t)n < iov[i].iov_len ? (size_t)n : iov[i].iov_len;
+
+			io_verify_read(io, iov[i].iov_base, offset, len);
+			offset += (off_t)len;
+			n -= (ssize_t)len;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ *  io_pvsync2_run()
+ *	coalesce up to vec_blocks contiguous ops of the same
+ *	direction into a single preadv2()/pwritev2() call, the
+ *	latency recorded is that of the whole call.  Paced ops
+ *	are only coalesced once they are due
+ */
+int io_pvsync2_run(io_state_t *io)
+{
+	struct iovec *iov;
+	io_op_t op, first;
+	bool more;
+	int rc = 0, flags[2];
+
+	flags[0] = flags[1] = io->test->rwf_flags;
+
+	iov = calloc(io->depth, sizeof(*iov));
+	if (!iov) {
+		fprintf(stderr, "Out of memory allocating iovecs\n");
+		return -ENOMEM;
+	}
+
+	more = io_next(io, &op);
+	while (more) {
+		uint32_t n = 0;
+		size_t total = 0;
+
+		first = op;
+		for (;;) {
+			iov[n].iov_base = io_buffer(io, n);
+			iov[n].iov_len = op.size;
+			if (op.write)
+				io_write_prep(io, iov[n].iov_base, &op);
+			total += op.size;
+			n++;
+
+			more = io_next(io, &op);
+			if (!more || (n == io->depth) ||
+			    (op.write != first.write) ||
+			    (op.offset != first.offset + (off_t)total) ||
+			    (op.issue_ns && io_issue_delay(&op, time_now_ns())))
+				break;
+		}
+		if (first.issue_ns && !io_wait(&first))
+			break;
+		rc = io_pvsync2_xfer(io, &first, iov, (int)n, total, &flags[first.write]);
+		if (rc < 0)
+			break;
+	}
+	free(iov);
+
+	return rc;
+}
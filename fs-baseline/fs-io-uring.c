@@ -0,0 +1,561 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-io-uring.h"
+
+/*
+ *  Mapped submission and completion rings, we use the
+ *  raw system calls so there is no liburing dependency
+ */
+typedef struct uring_t {
+	int		fd;
+	unsigned	*sq_head;
+	unsigned	*sq_tail;
+	unsigned	*sq_mask;
+	unsigned	*sq_flags;
+	unsigned	*sq_array;
+	unsigned	*cq_head;
+	unsigned	*cq_tail;
+	unsigned	*cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void		*sq_ring;
+	void		*cq_ring;
+	size_t		sq_ring_size;
+	size_t		cq_ring_size;
+	size_t		sqes_size;
+	uint32_t	features;	/* IORING_FEAT_* */
+} uring_t;
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit,
+	unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit,
+		min_complete, flags, NULL, 0);
+}
+
+/*
+ *  sys_io_uring_wait()
+ *	submit and wait for at least one completion or until
+ *	timeout_ns is up, needs IORING_FEAT_EXT_ARG
+ */
+static inline int sys_io_uring_wait(int fd, unsigned to_submit,
+	unsigned flags, const uint64_t timeout_ns)
+{
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+
+	ts.tv_sec = (int64_t)(timeout_ns / NS_PER_SEC);
+	ts.tv_nsec = (long long)(timeout_ns % NS_PER_SEC);
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = (uint64_t)(uintptr_t)&ts;
+
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, 1,
+		flags | IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+		&arg, sizeof(arg));
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode,
+	void *arg, unsigned nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_close(uring_t *ring)
+{
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		(void)munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && ring->cq_ring != MAP_FAILED &&
+	    ring->cq_ring != ring->sq_ring)
+		(void)munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring && ring->sq_ring != MAP_FAILED)
+		(void)munmap(ring->sq_ring, ring->sq_ring_size);
+	(void)close(ring->fd);
+}
+
+/*
+ *  uring_open()
+ *	create a ring with the given number of entries
+ *	and map in the shared submission/completion rings
+ */
+static int uring_open(uring_t *ring, const uint32_t entries, const uint32_t flags)
+{
+	struct io_uring_params p;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	if (flags & IO_FLAG_SQPOLL) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = 1000;	/* ms */
+	}
+
+	ring->fd = sys_io_uring_setup(entries, &p);
+	if (ring->fd < 0) {
+		fprintf(stderr, "Cannot setup io_uring: %d %s\n",
+			errno, strerror(errno));
+		return -errno;
+	}
+	ring->features = p.features;
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto err;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			goto err;
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err;
+
+	ring->sq_head = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_flags = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.flags);
+	ring->sq_array = (unsigned *)((uint8_t *)ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((uint8_t *)ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((uint8_t *)ring->cq_ring + p.cq_off.cqes);
+
+	return 0;
+err:
+	fprintf(stderr, "Cannot mmap io_uring rings: %d %s\n",
+		errno, strerror(errno));
+	uring_close(ring);
+	return -ENOMEM;
+}
+
+/*
+ *  uring_register()
+ *	register the I/O buffers and/or the test file
+ *	with the ring if requested
+ */
+static int uring_register(uring_t *ring, io_state_t *io, const uint32_t flags)
+{
+	if (flags & IO_FLAG_FIXED_BUFS) {
+		struct iovec *iov;
+		uint32_t i;
+		int ret;
+
+		iov = calloc(io->depth, sizeof(*iov));
+		if (!iov) {
+			fprintf(stderr, "Out of memory allocating iovecs\n");
+			return -ENOMEM;
+		}
+		for (i = 0; i < io->depth; i++) {
+			iov[i].iov_base = io_buffer(io, i);
+			iov[i].iov_len = io->buf_size;
+		}
+		ret = sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS,
+			iov, io->depth);
+		free(iov);
+		if (ret < 0) {
+			fprintf(stderr, "Cannot register io_uring buffers: %d %s\n",
+				errno, strerror(errno));
+			return -errno;
+		}
+	}
+	if (flags & IO_FLAG_FIXED_FILES) {
+		if (sys_io_uring_register(ring->fd, IORING_REGISTER_FILES,
+		    &io->fd, 1) < 0) {
+			fprintf(stderr, "Cannot register io_uring file: %d %s\n",
+				errno, strerror(errno));
+			return -errno;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  uring_drain()
+ *	after a failed io_uring_enter(), wait for the ops the
+ *	kernel has taken so their buffers are not freed under
+ *	them.  SQEs it has not consumed never complete
+ */
+static void uring_drain(uring_t *ring, uint32_t inflight)
+{
+	const unsigned unsubmitted = *ring->sq_tail -
+		__atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned head = *ring->cq_head;
+
+	inflight = inflight > unsubmitted ? inflight - unsubmitted : 0;
+	while (inflight) {
+		if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			head++;
+			inflight--;
+			continue;
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+		if ((sys_io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) &&
+		    (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+			break;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ *  io_uring_run()
+ *	keep up to iodepth ops in flight, queueing at most
+ *	iodepth_batch new ops per io_uring_enter() call.  A paced
+ *	op that is not yet due is held back while completions
+ *	are reaped with a timeout
+ */
+int io_uring_run(io_state_t *io)
+{
+	test_context_t *test = io->test;
+	const uint32_t flags = test->io_flags;
+	const bool fixed_bufs = !!(flags & IO_FLAG_FIXED_BUFS);
+	const bool sqpoll = !!(flags & IO_FLAG_SQPOLL);
+	uring_t ring;
+	io_op_t *ops;
+	uint32_t *free_slots, nfree, inflight = 0, pending = 0, batch, batch_complete;
+	uint32_t held_slot = 0;
+	uint8_t sqe_flags = 0;
+	int fd = io->fd, rc;
+	bool done = false, held = false;
+
+	batch = test->iodepth_batch ? test->iodepth_batch : io->depth;
+	if (batch > io->depth)
+		batch = io->depth;
+	batch_complete = test->iodepth_batch_complete ? test->iodepth_batch_complete : 1;
+
+	rc = uring_open(&ring, io->depth, flags);
+	if (rc < 0)
+		return rc;
+	rc = uring_register(&ring, io, flags);
+	if (rc < 0)
+		goto out;
+	if (flags & IO_FLAG_FIXED_FILES) {
+		fd = 0;
+		sqe_flags |= IOSQE_FIXED_FILE;
+	}
+
+	ops = calloc(io->depth, sizeof(*ops));
+	free_slots = calloc(io->depth, sizeof(*free_slots));
+	if (!ops || !free_slots) {
+		fprintf(stderr, "Out of memory allocating io_uring slots\n");
+		rc = -ENOMEM;
+		goto out_free;
+	}
+	for (nfree = 0; nfree < io->depth; nfree++)
+		free_slots[nfree] = io->depth - nfree - 1;
+
+	for (;;) {
+		unsigned tail = *ring.sq_tail, head, enter_flags = 0;
+		uint32_t queued = 0, min_complete;
+		uint64_t t_now = time_now_ns(), wait_ns;
+
+		while (!done && (held || nfree) && queued < batch) {
+			struct io_uring_sqe *sqe;
+			const unsigned idx = tail & *ring.sq_mask;
+			io_op_t *op;
+			uint32_t slot;
+
+			if (held) {
+				slot = held_slot;
+				held = false;
+				if (!test_continue()) {
+					free_slots[nfree++] = slot;
+					done = true;
+					break;
+				}
+			} else {
+				slot = free_slots[nfree - 1];
+				if (!io_next(io, &ops[slot])) {
+					done = true;
+					break;
+				}
+				nfree--;
+			}
+			op = &ops[slot];
+			/* A paced op keeps its slot until it is due */
+			if (io_issue_delay(op, t_now)) {
+				held = true;
+				held_slot = slot;
+				break;
+			}
+			if (!op->start_ns)
+				op->start_ns = t_now;
+
+			if (op->write)
+				io_write_prep(io, io_buffer(io, slot), op);
+			sqe = &ring.sqes[idx];
+			memset(sqe, 0, sizeof(*sqe));
+			if (fixed_bufs) {
+				sqe->opcode = op->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+				sqe->buf_index = slot;
+			} else {
+				sqe->opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+			}
+			sqe->flags = sqe_flags;
+			sqe->fd = fd;
+			sqe->off = (uint64_t)op->offset;
+			sqe->addr = (uint64_t)(uintptr_t)io_buffer(io, slot);
+			sqe->len = (uint32_t)op->size;
+			sqe->user_data = slot;
+			ring.sq_array[idx] = idx;
+			tail++;
+			queued++;
+		}
+		if (queued) {
+			__atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+			inflight += queued;
+			pending += queued;
+		}
+		if (!inflight) {
+			if (!held || done)
+				break;
+			/* Idle until the held op is due */
+			if (!io_wait(&ops[held_slot]))
+				break;
+			continue;
+		}
+
+		wait_ns = 0;
+		if (held && !done) {
+			/*
+			 *  Reap until the held op is due, without timed
+			 *  waits (pre 5.11 kernels) poll for completions
+			 *  rather than sleep through them
+			 */
+			min_complete = 0;
+			if (ring.features & IORING_FEAT_EXT_ARG) {
+				wait_ns = io_issue_delay(&ops[held_slot], time_now_ns());
+				if (wait_ns > IO_WAIT_SLICE_NS)
+					wait_ns = IO_WAIT_SLICE_NS;
+			}
+		} else if (done || !nfree) {
+			/* Block for completions only when no more ops can be queued */
+			min_complete = inflight < batch_complete ? inflight : batch_complete;
+		} else {
+			min_complete = 0;
+		}
+		if (min_complete)
+			enter_flags |= IORING_ENTER_GETEVENTS;
+		if (sqpoll) {
+			pending = 0;
+			if (__atomic_load_n(ring.sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+				enter_flags |= IORING_ENTER_SQ_WAKEUP;
+		}
+		if (pending || enter_flags || wait_ns) {
+			int ret = wait_ns ?
+				sys_io_uring_wait(ring.fd, pending, enter_flags, wait_ns) :
+				sys_io_uring_enter(ring.fd, pending, min_complete, enter_flags);
+
+			if (ret < 0) {
+				/* ETIME is a timed wait that saw no completions */
+				if ((errno != EINTR) && (errno != EAGAIN) &&
+				    (errno != EBUSY) && (errno != ETIME)) {
+					fprintf(stderr, "io_uring_enter failed: %d %s\n",
+						errno, strerror(errno));
+					rc = -errno;
+					uring_drain(&ring, inflight);
+					goto out_free;
+				}
+			} else if (!sqpoll) {
+				pending -= (uint32_t)ret;
+			}
+		}
+
+		head = *ring.cq_head;
+		t_now = time_now_ns();
+		while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+			const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+			const uint32_t slot = (uint32_t)cqe->user_data;
+
+			if (ops[slot].write)
+				io_verify_written(io, &ops[slot]);
+			if (cqe->res < 0) {
+				if (rc == 0)
+					rc = io_error(io, &ops[slot], -cqe->res);
+				done = true;
+			} else if ((size_t)cqe->res < ops[slot].size) {
+				/* Queued ops are not resubmitted, a short one fails the run */
+				if (rc == 0)
+					rc = io_error(io, &ops[slot], EIO);
+				done = true;
+			} else {
+				io_account(io, ops[slot].write, 1, (uint64_t)cqe->res, t_now - ops[slot].start_ns);
+				if (!ops[slot].write)
+					io_verify_read(io, io_buffer(io, slot), ops[slot].offset,
+						(size_t)cqe->res);
+			}
+			free_slots[nfree++] = slot;
+			inflight--;
+			head++;
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+out_free:
+	free(free_slots);
+	free(ops);
+out:
+	uring_close(&ring);
+
+	return rc;
+}
+
+/*
+ *  io_uring_commit_open()
+ *	a small ring for io_uring_commit()
+ */
+uring_t *io_uring_commit_open(void)
+{
+	uring_t *ring = malloc(sizeof(*ring));
+
+	if (!ring) {
+		fprintf(stderr, "Out of memory allocating io_uring\n");
+		return NULL;
+	}
+	if (uring_open(ring, 2, 0) < 0) {
+		free(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+void io_uring_commit_close(uring_t *ring)
+{
+	if (!ring)
+		return;
+	uring_close(ring);
+	free(ring);
+}
+
+/*
+ *  io_uring_commit()
+ *	write len bytes at offset with an fdatasync linked to
+ *	it, submitted together and waited for in one call.
+ *	Every submitted op is reaped, even on failure, so the
+ *	next commit starts on an empty ring.  Returns 0 or the
+ *	first failure as -errno
+ */
+int io_uring_commit(uring_t *ring, const int fd, const void *buf, const size_t len, const off_t offset)
+{
+	const unsigned sq_start = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned tail = *ring->sq_tail, head, submitted;
+	uint32_t i, done = 0;
+	int rc = 0, ret;
+
+	for (i = 0; i < 2; i++) {
+		const unsigned idx = tail & *ring->sq_mask;
+		struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->fd = fd;
+		sqe->user_data = i;
+		if (i == 0) {
+			/* The fsync only starts once the write has completed */
+			sqe->opcode = IORING_OP_WRITE;
+			sqe->flags = IOSQE_IO_LINK;
+			sqe->addr = (uint64_t)(uintptr_t)buf;
+			sqe->len = (uint32_t)len;
+			sqe->off = (uint64_t)offset;
+		} else {
+			sqe->opcode = IORING_OP_FSYNC;
+			sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+		}
+		ring->sq_array[idx] = idx;
+		tail++;
+	}
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	/* The kernel moves sq_head past what it has consumed, even on errors */
+	ret = sys_io_uring_enter(ring->fd, 2, 2, IORING_ENTER_GETEVENTS);
+	for (;;) {
+		submitted = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) - sq_start;
+		if (submitted == 2)
+			break;
+		if ((ret < 0) && (errno != EINTR)) {
+			rc = -errno;
+			/* Take back the unconsumed SQEs so the next enter does not submit them */
+			__atomic_store_n(ring->sq_tail, sq_start + submitted, __ATOMIC_RELEASE);
+			break;
+		}
+		ret = sys_io_uring_enter(ring->fd, 2 - submitted, 2 - submitted,
+			IORING_ENTER_GETEVENTS);
+	}
+
+	head = *ring->cq_head;
+	while (done < submitted) {
+		const struct io_uring_cqe *cqe;
+
+		if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			if ((sys_io_uring_enter(ring->fd, 0, submitted - done, IORING_ENTER_GETEVENTS) < 0) &&
+			    (errno != EINTR)) {
+				if (rc == 0)
+					rc = -errno;
+				break;
+			}
+			continue;
+		}
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		/* A short write fails the link, the fsync is then cancelled */
+		if ((cqe->res < 0) && (rc == 0)) {
+			/* An fsync that is not an opcode of this kernel */
+			rc = ((cqe->user_data == 1) && (cqe->res == -EINVAL)) ?
+				-EOPNOTSUPP : cqe->res;
+		}
+		head++;
+		done++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	return rc;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_IO_URING_H__
+#define __FS_IO_URING_H__
+
+#include <sys/types.h>
+
+#include "fs-io.h"
+
+typedef struct uring_t uring_t;
+
+extern int io_uring_run(io_state_t *io);
+extern uring_t *io_uring_commit_open(void);
+extern void io_uring_commit_close(uring_t *ring);
+extern int io_uring_commit(uring_t *ring, const int fd, const void *buf,
+	const size_t len, const off_t offset);
+
+#endif
@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-io-uring.h"
+#include "fs-io-aio.h"
+#include "fs-io-mmap.h"
+#include "fs-io-pvsync2.h"
+#include "fs-affinity.h"
+#include "fs-verify.h"
+
+static int io_sync_run(io_state_t *io);
+static int io_psync_run(io_state_t *io);
+
+const io_engine_t io_engines[] = {
+	{ "sync",	io_sync_run,	0,
+	  "lseek() + read()/write(), one blocking op at a time" },
+	{ "psync",	io_psync_run,	0,
+	  "pread()/pwrite(), one blocking op at a time" },
+	{ "pvsync2",	io_pvsync2_run,	IO_ENGINE_VECTORED | IO_ENGINE_RWF,
+	  "preadv2()/pwritev2() of up to vec-blocks blocks with RWF_* flags" },
+	{ "io_uring",	io_uring_run,	IO_ENGINE_QUEUED,
+	  "io_uring, up to iodepth ops in flight" },
+	{ "aio",	io_aio_run,	IO_ENGINE_QUEUED | IO_ENGINE_DIRECT,
+	  "native Linux AIO (as fio libaio), needs -d" },
+	{ "mmap",	io_mmap_run,	IO_ENGINE_RDWR,
+	  "memcpy() to/from a shared mapping of the thread's region" },
+	{ NULL,		NULL,		0,	NULL }
+};
+
+/*
+ *  io_block_size()
+ *	size of the next op, picked from the --bssplit
+ *	distribution if one was given
+ */
+static inline uint64_t io_block_size(io_state_t *io)
+{
+	const io_bssplit_t *split = io->test->bssplit;
+	uint32_t i, r;
+
+	if (!split)
+		return io->test->block_size;
+
+	r = (uint32_t)rand_bounded(&io->rand, 100);
+	for (i = 0; i < split->n - 1; i++) {
+		if (r < split->cum_pct[i])
+			break;
+	}
+	return split->size[i];
+}
+
+/*
+ *  io_wait()
+ *	sleep until a paced op may be issued, in slices so a
+ *	stopped round is noticed.  Ops without a scheduled start
+ *	time have their latency start once the wait is over.
+ *	Returns false if the round stopped while waiting
+ */
+bool io_wait(io_op_t *op)
+{
+	uint64_t t_now = time_now_ns(), delay;
+
+	while ((delay = io_issue_delay(op, t_now)) != 0) {
+		struct timespec ts;
+
+		if (!test_continue())
+			return false;
+		if (delay > IO_WAIT_SLICE_NS)
+			delay = IO_WAIT_SLICE_NS;
+		ts.tv_sec = (time_t)(delay / NS_PER_SEC);
+		ts.tv_nsec = (long)(delay % NS_PER_SEC);
+		(void)nanosleep(&ts, NULL);
+		t_now = time_now_ns();
+	}
+	if (!op->start_ns)
+		op->start_ns = t_now;
+	return true;
+}
+
+/*
+ *  io_pace()
+ *	set when an op may be issued.  Open loop ops follow a
+ *	fixed schedule and their latency runs from the scheduled
+ *	time, so a stall is charged to every op it held back
+ *	rather than hidden by issuing fewer of them (coordinated
+ *	omission).  Thinktime idles after every thinktime_blocks
+ *	ops, pushing the open loop schedule back with it
+ */
+static void io_pace(io_state_t *io, io_op_t *op)
+{
+	const test_context_t *test = io->test;
+	const bool think = test->thinktime_ns && io->generated &&
+		((io->generated % test->thinktime_blocks) == 0);
+
+	if (test->rate_iops || test->rate_bytes) {
+		if (think)
+			io->sched_ns += test->thinktime_ns;
+		op->issue_ns = io->sched_ns;
+		op->start_ns = io->sched_ns;
+		if (test->rate_iops)
+			io->sched_ns += NS_PER_SEC / test->rate_iops;
+		else
+			io->sched_ns += ((uint64_t)op->size * NS_PER_SEC) / test->rate_bytes;
+	} else if (think) {
+		op->issue_ns = time_now_ns() + test->thinktime_ns;
+	}
+	io->generated++;
+}
+
+/*
+ *  io_next()
+ *	generate the next I/O operation for the workload
+ *	pattern, returns false when there is no more work
+ */
+bool io_next(io_state_t *io, io_op_t *op)
+{
+	test_context_t *test = io->test;
+	const io_pattern_t *pattern = io->pattern;
+	const io_bssplit_t *split = test->bssplit;
+
+	if (!test_continue())
+		return false;
+
+	while (io->remaining == 0) {
+		if ((++io->pass >= pattern->passes) && !test->time_based)
+			return false;
+		io->remaining = test->per_thread_file_size;
+		if (test->dist->type == RAND_DIST_PERMUTE) {
+			/* A new order each pass, drop what is left of the batch */
+			rand_perm_init(&io->perm, test->dist->n, &io->rand);
+			io->slot_pos = IO_RAND_BATCH;
+		}
+	}
+
+	op->size = io_block_size(io);
+	if (op->size > io->remaining)
+		op->size = io->remaining;
+	if (pattern->order == IO_ORDER_RND) {
+		const uint64_t align = split ? split->min_size : test->block_size;
+
+		if (io->slot_pos == IO_RAND_BATCH) {
+			/* The normal distribution centre sweeps the region each pass */
+			const uint64_t centre =
+				(test->per_thread_file_size - io->remaining) / align;
+
+			if (test->dist->type == RAND_DIST_PERMUTE)
+				rand_perm_fill(&io->perm, io->slots, IO_RAND_BATCH);
+			else
+				rand_dist_fill(test->dist, &io->rand, centre, io->slots, IO_RAND_BATCH);
+			io->slot_pos = 0;
+		}
+		op->offset = io->base + (off_t)(io->slots[io->slot_pos++] * align);
+
+		/* Large ops from the last slots are pulled back inside the region */
+		if (op->offset + (off_t)op->size > io->base + (off_t)test->per_thread_file_size)
+			op->offset = io->base +
+				(off_t)(((test->per_thread_file_size - op->size) / align) * align);
+	} else {
+		op->offset = io->base +
+			(off_t)(test->per_thread_file_size - io->remaining);
+	}
+
+	switch (pattern->mix) {
+	case IO_MIX_READ:
+		op->write = false;
+		break;
+	case IO_MIX_WRITE:
+		op->write = true;
+		break;
+	default:
+		op->write = rand_bounded(&io->rand, 100) >= test->rwmixread;
+		break;
+	}
+	/* A short transfer hands back what it did not move, see io_short() */
+	io->remaining -= op->size;
+
+	op->start_ns = 0;
+	op->issue_ns = 0;
+	if (io->paced) {
+		io_pace(io, op);
+		/* Queued and vectored engines hold early ops back themselves */
+		if (op->issue_ns && !io->self_paced)
+			return io_wait(op);
+	}
+	return true;
+}
+
+/*
+ *  io_error()
+ *	report a failed read or write, returns -err
+ */
+int io_error(io_state_t *io, const io_op_t *op, const int err)
+{
+	(void)io;
+
+	fprintf(stderr, "%s failed: %d %s\n",
+		op->write ? "Write" : "Read", err, strerror(err));
+	return -err;
+}
+
+/*
+ *  io_short()
+ *	a blocking transfer of size bytes moved only done, io_next()
+ *	took all of it off the pass so hand the rest back, the pass
+ *	then resumes where the transfer stopped.  Returns -EIO when
+ *	nothing moved (end of file or no space), as retrying it
+ *	would never finish
+ */
+int io_short(io_state_t *io, const io_op_t *op, const uint64_t size, const uint64_t done)
+{
+	if (done == 0)
+		return io_error(io, op, EIO);
+	io->remaining += size - done;
+	return 0;
+}
+
+/*
+ *  io_sync_run()
+ *	classic blocking I/O, seek only when the offset
+ *	is not where the previous op left the file position.
+ *	One clock read per op, the end of one op is the start
+ *	of the next.
+ */
+static int io_sync_run(io_state_t *io)
+{
+	io_op_t op;
+	off_t pos = -1;
+	void *buffer = io_buffer(io, 0);
+	uint64_t t_prev = time_now_ns();
+
+	while (io_next(io, &op)) {
+		uint64_t t_now;
+		ssize_t n;
+
+		/* Paced ops carry their own latency start */
+		if (op.start_ns)
+			t_prev = op.start_ns;
+		if (op.offset != pos) {
+			if (lseek(io->fd, op.offset, SEEK_SET) < 0) {
+				fprintf(stderr, "Cannot seek: %s: %d %s\n",
+					io->test->filename, errno, strerror(errno));
+				return -errno;
+			}
+		}
+		if (op.write) {
+			io_write_prep(io, buffer, &op);
+			n = write(io->fd, buffer, op.size);
+		} else {
+			n = read(io->fd, buffer, op.size);
+		}
+		if (n < 0)
+			return io_error(io, &op, errno);
+		if (((size_t)n < op.size) && (io_short(io, &op, op.size, (uint64_t)n) < 0))
+			return -EIO;
+		if (!op.write)
+			io_verify_read(io, buffer, op.offset, (size_t)n);
+
+		t_now = time_now_ns();
+		io_account(io, op.write, 1, (uint64_t)n, t_now - t_prev);
+		t_prev = t_now;
+		pos = op.offset + n;
+	}
+	return 0;
+}
+
+/*
+ *  io_psync_run()
+ *	positional blocking I/O, no seeks
+ */
+static int io_psync_run(io_state_t *io)
+{
+	io_op_t op;
+	void *buffer = io_buffer(io, 0);
+	uint64_t t_prev = time_now_ns();
+
+	while (io_next(io, &op)) {
+		uint64_t t_now;
+		ssize_t n;
+
+		if (op.start_ns)
+			t_prev = op.start_ns;
+		if (op.write) {
+			io_write_prep(io, buffer, &op);
+			n = pwrite(io->fd, buffer, op.size, op.offset);
+		} else {
+			n = pread(io->fd, buffer, op.size, op.offset);
+		}
+		if (n < 0)
+			return io_error(io, &op, errno);
+		if (((size_t)n < op.size) && (io_short(io, &op, op.size, (uint64_t)n) < 0))
+			return -EIO;
+		if (!op.write)
+			io_verify_read(io, buffer, op.offset, (size_t)n);
+
+		t_now = time_now_ns();
+		io_account(io, op.write, 1, (uint64_t)n, t_now - t_prev);
+		t_prev = t_now;
+	}
+	return 0;
+}
+
+/*
+ *  io_verify_stamp()
+ *	stamp the blocks of a write with this thread's next
+ *	sequence number and remember it for each block.  With
+ *	queued writes, a block written again while an earlier
+ *	write of it is in flight may end up with either one
+ */
+void io_verify_stamp(io_state_t *io, void *buf, const off_t offset, const size_t size)
+{
+	const test_context_t *test = io->test;
+	const uint32_t unit = io->verify_unit;
+	uint64_t b = (uint64_t)(offset - io->base) / unit;
+	size_t i;
+
+	/* 0 marks a block this thread has not written */
+	if (++io->verify_next == 0)
+		io->verify_next = 1;
+	for (i = 0; i < size; i += unit, b++) {
+		io->verify_seq[b] = io->verify_next;
+		if (!io->verify_flight)
+			continue;
+		if (io->verify_flight[b] & VERIFY_FLIGHT_COUNT)
+			io->verify_flight[b] = (io->verify_flight[b] + 1) | VERIFY_FLIGHT_RACED;
+		else
+			io->verify_flight[b] = 1;
+	}
+	verify_fill(buf, size, offset, unit, test->instance, io->verify_next, test->randseed);
+}
+
+/*
+ *  io_verify_done()
+ *	a queued write of these blocks has completed
+ */
+void io_verify_done(io_state_t *io, const off_t offset, const size_t size)
+{
+	const uint32_t unit = io->verify_unit;
+	uint64_t b = (uint64_t)(offset - io->base) / unit;
+	size_t i;
+
+	for (i = 0; i < size; i += unit, b++)
+		io->verify_flight[b]--;
+}
+
+/*
+ *  io_verify_check()
+ *	check the blocks of a read, when stale is set a block
+ *	this thread wrote must also hold its last write of that
+ *	block.  The first few bad blocks are reported, all are
+ *	counted
+ */
+void io_verify_check(
+	io_state_t *io,
+	const void *buf,
+	const off_t offset,
+	const size_t size,
+	const bool stale)
+{
+	const test_context_t *test = io->test;
+	const uint32_t unit = io->verify_unit;
+	size_t i;
+
+	for (i = 0; i + unit <= size; i += unit) {
+		const uint8_t *p = (const uint8_t *)buf + i;
+		const verify_hdr_t *hdr = (const verify_hdr_t *)p;
+		const off_t off = offset + (off_t)i;
+		verify_err_t err = verify_block(p, off, unit);
+
+		io->verify_blocks++;
+		if ((err == VERIFY_OK) && stale && io->verify_seq) {
+			const uint64_t b = (uint64_t)(off - io->base) / unit;
+			const uint32_t seq = io->verify_seq[b];
+
+			/* Racing writes of a block may land in either order */
+			if (io->verify_flight && (io->verify_flight[b] & VERIFY_FLIGHT_RACED))
+				continue;
+			if (seq && ((hdr->seq != seq) || (hdr->thread != test->instance) ||
+			    (hdr->seed != test->randseed)))
+				err = VERIFY_STALE;
+		}
+		if (err == VERIFY_OK)
+			continue;
+		if (++io->verify_errors <= VERIFY_MAX_REPORTS)
+			fprintf(stderr, "Verify failed: %s: block at %jd: %s, "
+				"header offset %" PRIu64 " thread %" PRIu32 " seq %" PRIu32 "\n",
+				test->filename, (intmax_t)off, verify_err_name(err),
+				hdr->offset, hdr->thread, hdr->seq);
+	}
+}
+
+/*
+ *  io_verify_pass()
+ *	after a workload that writes, read back the region
+ *	and check every block written, or all of them if the
+ *	file was laid out first.  Random writes may leave the
+ *	end of the file unwritten, blocks past the end of file
+ *	are only bad if they were written.  Not part of the
+ *	timed run
+ */
+static int io_verify_pass(io_state_t *io)
+{
+	test_context_t *test = io->test;
+	const uint32_t unit = io->verify_unit;
+	const size_t chunk = (io->buf_size * io->depth / unit) * unit;
+	const bool laid_out = io->pattern->mix != IO_MIX_WRITE;
+	uint64_t done = 0;
+	int fd, rc = 0;
+
+	fd = open(test->filename, O_RDONLY | (test->open_flags & (O_DIRECT | O_NOATIME)));
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open for verifying: %s: %d %s\n",
+			test->filename, errno, strerror(errno));
+		return -errno;
+	}
+	while ((done < test->per_thread_file_size) && (opt_flags & OPT_CONT)) {
+		const uint64_t left = test->per_thread_file_size - done;
+		const size_t len = left < chunk ? (size_t)left : chunk;
+		const off_t offset = io->base + (off_t)done;
+		uint8_t *buf = (uint8_t *)io->buffers;
+		ssize_t n;
+		size_t i;
+
+		n = pread(fd, buf, len, offset);
+		if (n < 0) {
+			fprintf(stderr, "Verify read of %s at %jd failed: %d %s\n",
+				test->filename, (intmax_t)offset, errno, strerror(errno));
+			rc = -errno;
+			break;
+		}
+		for (i = 0; i < len; i += unit) {
+			if (!laid_out && !io->verify_seq[(done + i) / unit])
+				continue;
+			if (i + unit <= (size_t)n) {
+				io_verify_check(io, buf + i, offset + (off_t)i, unit, true);
+				continue;
+			}
+			io->verify_blocks++;
+			if (++io->verify_errors <= VERIFY_MAX_REPORTS)
+				fprintf(stderr, "Verify failed: %s: block at %jd: past end of file\n",
+					test->filename, (intmax_t)(offset + (off_t)i));
+		}
+		done += len;
+	}
+	(void)close(fd);
+
+	return rc;
+}
+
+static const char *io_open_mode(const int flags)
+{
+	switch (flags & O_ACCMODE) {
+	case O_RDONLY:
+		return "reading";
+	case O_WRONLY:
+		return "writing";
+	default:
+		return "reading and writing";
+	}
+}
+
+/*
+ *  io_worker()
+ *	common worker thread body, opens the test file, sets up
+ *	the I/O buffers and then lets the selected engine drive
+ *	the workload's I/O pattern
+ */
+void *io_worker(test_context_t *test, const io_pattern_t *pattern)
+{
+	io_state_t io;
+	uint64_t time_start, time_end;
+	size_t buf_size;
+	int flags = pattern->open_flags;
+
+	test->ret = 0;
+
+	memset(&io, 0, sizeof(io));
+	io.test = test;
+	io.pattern = pattern;
+	io.hist = test->lat_hist;
+	io.counters = test->counters;
+	io.base = (off_t)(test->instance * test->per_thread_file_size);
+	io.remaining = test->per_thread_file_size;
+	rand_seed(&io.rand, test->randseed, test->instance);
+	io.slot_pos = IO_RAND_BATCH;
+	rand_perm_init(&io.perm, test->dist->n, &io.rand);
+	io.paced = test->rate_iops || test->rate_bytes || test->thinktime_ns;
+	io.self_paced = !!(test->engine->flags & (IO_ENGINE_QUEUED | IO_ENGINE_VECTORED));
+	if (test->engine->flags & IO_ENGINE_QUEUED)
+		io.depth = test->iodepth;
+	else if (test->engine->flags & IO_ENGINE_VECTORED)
+		io.depth = test->vec_blocks;
+	else
+		io.depth = 1;
+
+	if ((test->engine->flags & IO_ENGINE_RDWR) &&
+	    ((flags & O_ACCMODE) == O_WRONLY))
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+
+	io.fd = open(test->filename, flags | test->open_flags, S_IRUSR | S_IWUSR);
+	if (io.fd < 0) {
+		fprintf(stderr, "Cannot open for %s: %s: %d %s\n",
+			io_open_mode(flags),
+			test->filename, errno, strerror(errno));
+		test->ret = -errno;
+		return NULL;
+	}
+
+	io.buf_size = (size_t)test->block_size;
+	if (test->bssplit && (test->bssplit->max_size > io.buf_size))
+		io.buf_size = (size_t)test->bssplit->max_size;
+	buf_size = io.buf_size * io.depth;
+	io.buffers = affinity_alloc_buffer(buf_size, test->node);
+	if (!io.buffers) {
+		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
+			errno, strerror(errno));
+		test->ret = -ENOMEM;
+		close(io.fd);
+		return NULL;
+	}
+	memset(io.buffers, test->instance & 0xff, buf_size);
+	data_gen_init(&io.data, test, false);
+	if (test->verify) {
+		io.verify_unit = verify_unit(test);
+		io.verify_racy = !!(test->engine->flags & IO_ENGINE_QUEUED) && (io.depth > 1);
+		if (pattern->mix != IO_MIX_READ) {
+			const size_t blocks = (size_t)(test->per_thread_file_size / io.verify_unit);
+
+			io.verify_seq = calloc(blocks, sizeof(*io.verify_seq));
+			if (io.verify_racy)
+				io.verify_flight = calloc(blocks, sizeof(*io.verify_flight));
+			if (!io.verify_seq || (io.verify_racy && !io.verify_flight)) {
+				fprintf(stderr, "Out of memory allocating verify state\n");
+				test->ret = -ENOMEM;
+				free(io.verify_flight);
+				free(io.verify_seq);
+				free(io.buffers);
+				close(io.fd);
+				return NULL;
+			}
+		}
+	}
+
+	time_start = time_now_ns();
+	io.sched_ns = time_start;
+	test->ret = test->engine->run(&io);
+	time_end = time_now_ns();
+	if ((test->ret == 0) && io.verify_seq)
+		test->ret = io_verify_pass(&io);
+	test->verify_blocks = io.verify_blocks;
+	test->verify_errors = io.verify_errors;
+
+	if (test->ret == 0) {
+		const uint64_t duration_ns = (time_end > time_start) ? time_end - time_start : 1;
+
+		test->duration_ns = duration_ns;
+		test->response_time_ns = io.ops ? duration_ns / io.ops : 0;
+		test->rate = (double)io.bytes * NS_PER_SEC / (double)duration_ns;
+		test->ops = io.ops;
+		test->dir_ops[IO_DIR_READ] = io.dir_ops[IO_DIR_READ];
+		test->dir_ops[IO_DIR_WRITE] = io.dir_ops[IO_DIR_WRITE];
+		test->dir_bytes[IO_DIR_READ] = io.dir_bytes[IO_DIR_READ];
+		test->dir_bytes[IO_DIR_WRITE] = io.dir_bytes[IO_DIR_WRITE];
+		test->op_rate = (double)io.ops * NS_PER_SEC / (double)duration_ns;
+		test->nowait_retries = io.nowait_retries;
+	}
+
+	free(io.verify_flight);
+	free(io.verify_seq);
+	free(io.buffers);
+	close(io.fd);
+
+	return NULL;
+}
+
+/*
+ *  io_engine_find()
+ *	find an I/O engine by name
+ */
+const io_engine_t *io_engine_find(const char *name)
+{
+	const io_engine_t *engine;
+
+	for (engine = io_engines; engine->name; engine++) {
+		if (!strcmp(name, engine->name))
+			return engine;
+	}
+	return NULL;
+}
+
+void io_engines_show(void)
+{
+	const io_engine_t *engine;
+
+	printf("\nI/O engines available are:\n");
+	for (engine = io_engines; engine->name; engine++)
+		printf("  %-9s - %s\n", engine->name, engine->desc);
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_IO_H__
+#define __FS_IO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "fs-test.h"
+#include "fs-rand.h"
+#include "fs-data.h"
+
+#define IO_FLAG_FIXED_BUFS	(0x00000001)	/* io_uring registered buffers */
+#define IO_FLAG_FIXED_FILES	(0x00000002)	/* io_uring registered files */
+#define IO_FLAG_SQPOLL		(0x00000004)	/* io_uring kernel SQ polling */
+#define IO_FLAG_MMAP_POPULATE	(0x00000008)	/* mmap with MAP_POPULATE */
+
+/* I/O engine capabilities */
+#define IO_ENGINE_QUEUED	(0x00000001)	/* Uses iodepth buffers */
+#define IO_ENGINE_DIRECT	(0x00000002)	/* Requires O_DIRECT */
+#define IO_ENGINE_RDWR		(0x00000004)	/* Writes need the file opened O_RDWR */
+#define IO_ENGINE_VECTORED	(0x00000008)	/* Uses vec_blocks buffers */
+#define IO_ENGINE_RWF		(0x00000010)	/* Applies --rwf flags per call */
+
+/* mmap engine msync policy on writes */
+typedef enum {
+	IO_MSYNC_NONE = 0,	/* Leave dirty pages to writeback */
+	IO_MSYNC_END,		/* msync(MS_SYNC) the region at the end */
+	IO_MSYNC_ASYNC,		/* msync(MS_ASYNC) each written block */
+	IO_MSYNC_SYNC,		/* msync(MS_SYNC) each written block */
+} io_msync_t;
+
+typedef enum {
+	IO_ORDER_SEQ = 0,	/* Sequential offsets */
+	IO_ORDER_RND,		/* Random offsets */
+} io_order_t;
+
+typedef enum {
+	IO_MIX_READ = 0,	/* Reads only */
+	IO_MIX_WRITE,		/* Writes only */
+	IO_MIX_READ_WRITE,	/* Random mix of reads and writes */
+} io_mix_t;
+
+/*
+ *  Describes the access pattern of a workload, the
+ *  engines drive I/O according to this description
+ */
+typedef struct {
+	int		open_flags;	/* O_RDONLY, O_WRONLY or O_RDWR */
+	io_order_t	order;
+	io_mix_t	mix;
+	uint32_t	passes;		/* Passes over the per thread region */
+} io_pattern_t;
+
+#define MAX_BSSPLIT	(64)
+#define IO_RAND_BATCH	(64)	/* Random offsets generated per refill */
+#define IO_WAIT_SLICE_NS	(100000000ULL)	/* Longest pacing sleep between stop checks */
+
+/*
+ *  Weighted block size distribution (--bssplit), random
+ *  offsets are aligned to the smallest size
+ */
+struct io_bssplit_t {
+	uint32_t	n;
+	uint64_t	size[MAX_BSSPLIT];
+	uint32_t	cum_pct[MAX_BSSPLIT];	/* Cumulative percentages */
+	uint64_t	min_size;
+	uint64_t	max_size;
+};
+
+/*
+ *  A single I/O operation
+ */
+typedef struct {
+	off_t		offset;
+	size_t		size;
+	bool		write;
+	uint64_t	start_ns;	/* Latency start, 0 until issued */
+	uint64_t	issue_ns;	/* Not before this time, 0 for now */
+} io_op_t;
+
+/*
+ *  Per thread I/O state shared between the workload
+ *  and the engine driving it
+ */
+typedef struct {
+	test_context_t	*test;
+	const io_pattern_t *pattern;
+	histogram_t	*hist;		/* Op latencies, one per io_dir_t */
+	io_counters_t	*counters;	/* Live counters for the interval log */
+	int		fd;
+	void		*buffers;	/* depth buffers of buf_size bytes */
+	size_t		buf_size;	/* Largest op size */
+	uint32_t	depth;		/* Number of buffers */
+	off_t		base;		/* Start of this thread's region */
+	uint64_t	remaining;	/* Bytes left in current pass */
+	uint32_t	pass;
+	rand_state_t	rand;		/* This worker's random stream */
+	uint64_t	slots[IO_RAND_BATCH];	/* Pregenerated random slots */
+	uint32_t	slot_pos;
+	rand_perm_t	perm;		/* Exactly once order, rekeyed each pass */
+	uint64_t	ops;		/* Completed ops */
+	uint64_t	bytes;		/* Completed bytes */
+	uint64_t	dir_ops[IO_DIRS];
+	uint64_t	dir_bytes[IO_DIRS];
+	uint64_t	nowait_retries;	/* RWF_NOWAIT ops that would block */
+	bool		paced;		/* Open loop or thinktime ops */
+	bool		self_paced;	/* Engine waits for issue_ns itself */
+	uint64_t	sched_ns;	/* Next open loop issue time */
+	uint64_t	generated;	/* Ops handed out by io_next() */
+	data_gen_t	data;		/* Write data, when not DATA_CONST */
+	uint32_t	verify_unit;	/* Verified block size, 0 when not verifying */
+	uint32_t	verify_next;	/* Sequence of the next write */
+	uint32_t	*verify_seq;	/* Last write to each block of the region */
+	uint32_t	*verify_flight;	/* Queued writes of each block in flight */
+	bool		verify_racy;	/* Queued reads may overlap writes in flight */
+	uint64_t	verify_blocks;
+	uint64_t	verify_errors;
+} io_state_t;
+
+struct io_engine_t {
+	const char *name;
+	int (*run)(io_state_t *io);	/* Drive I/O until io_next() is done */
+	uint32_t flags;			/* IO_ENGINE_* capabilities */
+	const char *desc;
+};
+
+/*
+ *  io_buffer()
+ *	get the n'th I/O buffer
+ */
+static inline void *io_buffer(const io_state_t *io, const uint32_t n)
+{
+	return (uint8_t *)io->buffers + ((size_t)n * io->buf_size);
+}
+
+/*
+ *  io_issue_delay()
+ *	how long until a paced op may be issued, 0 if now
+ */
+static inline uint64_t io_issue_delay(const io_op_t *op, const uint64_t t_now)
+{
+	return (op->issue_ns > t_now) ? op->issue_ns - t_now : 0;
+}
+
+/*
+ *  io_account()
+ *	account completed ops, their bytes and latency
+ */
+static inline void io_account(
+	io_state_t *io,
+	const bool write,
+	const uint64_t ops,
+	const uint64_t bytes,
+	const uint64_t lat_ns)
+{
+	histogram_record(&io->hist[write], lat_ns);
+	counters_update(io->counters, ops, bytes, lat_ns);
+	io->ops += ops;
+	io->bytes += bytes;
+	io->dir_ops[write] += ops;
+	io->dir_bytes[write] += bytes;
+}
+
+extern void io_verify_stamp(io_state_t *io, void *buf, const off_t offset, const size_t size);
+extern void io_verify_done(io_state_t *io, const off_t offset, const size_t size);
+extern void io_verify_check(io_state_t *io, const void *buf, const off_t offset,
+	const size_t size, const bool stale);
+
+/*
+ *  io_write_prep()
+ *	fill a buffer just before the engine writes it with
+ *	generated data and, with --verify, stamp its blocks
+ */
+static inline void io_write_prep(io_state_t *io, void *buf, const io_op_t *op)
+{
+	if (io->data.active)
+		data_fill(&io->data, buf, op->size);
+	if (io->verify_unit)
+		io_verify_stamp(io, buf, op->offset, op->size);
+}
+
+/*
+ *  io_verify_read()
+ *	with --verify, check the blocks of a completed read,
+ *	a read racing a queued write may see either version
+ *	so staleness is then left to the pass after the run
+ */
+static inline void io_verify_read(io_state_t *io, const void *buf, const off_t offset, const size_t size)
+{
+	if (io->verify_unit)
+		io_verify_check(io, buf, offset, size, !io->verify_racy);
+}
+
+/*
+ *  io_verify_written()
+ *	with --verify, a queued write of op has completed
+ */
+static inline void io_verify_written(io_state_t *io, const io_op_t *op)
+{
+	if (io->verify_flight)
+		io_verify_done(io, op->offset, op->size);
+}
+
+extern bool io_next(io_state_t *io, io_op_t *op);
+extern bool io_wait(io_op_t *op);
+extern int io_error(io_state_t *io, const io_op_t *op, const int err);
+extern int io_short(io_state_t *io, const io_op_t *op, const uint64_t size, const uint64_t done);
+extern void *io_worker(test_context_t *test, const io_pattern_t *pattern);
+extern const io_engine_t *io_engine_find(const char *name);
+extern void io_engines_show(void);
+
+extern const io_engine_t io_engines[];
+
+#endif
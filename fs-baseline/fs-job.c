@@ -0,0 +1,598 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-read-setup.h"
+#include "fs-read-seq.h"
+#include "fs-read-rnd.h"
+#include "fs-meta.h"
+#include "fs-db.h"
+#include "fs-verify.h"
+#include "fs-data.h"
+#include "fs-cache.h"
+#include "fs-job.h"
+
+#define JOB_SIZE_FLAGS	(OPT_BLOCK_SIZE | OPT_FILE_SIZE | OPT_BLOCKS)
+
+/*
+ *  job_error()
+ *	report a problem with a group, named groups
+ *	are prefixed with their name
+ */
+static void job_error(const job_group_t *job, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (*job->name)
+		fprintf(stderr, "Job %s: ", job->name);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ *  job_size_flag()
+ *	a group's bs, size or blocks overrides the inherited
+ *	ones, the size derived from the other two is dropped
+ */
+static void job_size_flag(job_group_t *job, const uint32_t flag, const uint32_t drop)
+{
+	job->size_flags |= flag;
+	if ((job->size_flags & JOB_SIZE_FLAGS) == JOB_SIZE_FLAGS)
+		job->size_flags &= ~drop;
+}
+
+static bool job_flag(const char *val)
+{
+	return !val || strcmp(val, "0");
+}
+
+/*
+ *  job_set()
+ *	apply one key=value setting to a group, flags such
+ *	as direct may be given without a value.  Returns -1
+ *	for unknown keys or bad values
+ */
+int job_set(job_group_t *job, const char *key, const char *val)
+{
+	test_context_t *test = &job->test;
+
+	if (!strcmp(key, "direct")) {
+		test->open_flags = job_flag(val) ?
+			test->open_flags | O_DIRECT : test->open_flags & ~O_DIRECT;
+		return 0;
+	}
+	if (!strcmp(key, "sync")) {
+		test->open_flags = job_flag(val) ?
+			test->open_flags | O_SYNC : test->open_flags & ~O_SYNC;
+		return 0;
+	}
+	if (!strcmp(key, "noatime")) {
+		test->open_flags = job_flag(val) ?
+			test->open_flags | O_NOATIME : test->open_flags & ~O_NOATIME;
+		return 0;
+	}
+	if (!strcmp(key, "time-based")) {
+		test->time_based = job_flag(val);
+		return 0;
+	}
+	if (!strcmp(key, "verify")) {
+		test->verify = job_flag(val);
+		return 0;
+	}
+
+	if (!val || !*val) {
+		job_error(job, "%s needs a value\n", key);
+		return -1;
+	}
+	if (!strcmp(key, "test")) {
+		job->ti = test_find(val);
+		if (!job->ti) {
+			job_error(job, "%s is not a valid test name\n", val);
+			return -1;
+		}
+	} else if (!strcmp(key, "threads")) {
+		job->threads = get_u32(val);
+		if (job->threads < 1) {
+			job_error(job, "needs at least 1 thread\n");
+			return -1;
+		}
+	} else if (!strcmp(key, "bs")) {
+		test->block_size = get_u64_byte(val);
+		job_size_flag(job, OPT_BLOCK_SIZE, OPT_BLOCKS);
+	} else if (!strcmp(key, "size")) {
+		test->file_size = get_u64_byte(val);
+		job_size_flag(job, OPT_FILE_SIZE, OPT_BLOCKS);
+	} else if (!strcmp(key, "blocks")) {
+		test->blocks = get_u64(val);
+		job_size_flag(job, OPT_BLOCKS, OPT_FILE_SIZE);
+	} else if (!strcmp(key, "bssplit")) {
+		parse_bssplit(val, &job->bssplit);
+		test->bssplit = &job->bssplit;
+	} else if (!strcmp(key, "engine")) {
+		test->engine = io_engine_find(val);
+		if (!test->engine) {
+			job_error(job, "%s is not a valid I/O engine\n", val);
+			return -1;
+		}
+	} else if (!strcmp(key, "iodepth")) {
+		test->iodepth = get_u32(val);
+		if (test->iodepth < 1) {
+			job_error(job, "iodepth must be at least 1\n");
+			return -1;
+		}
+	} else if (!strcmp(key, "rwmixread")) {
+		test->rwmixread = get_u32(val);
+		if (test->rwmixread > 100) {
+			job_error(job, "rwmixread must be 0..100\n");
+			return -1;
+		}
+	} else if (!strcmp(key, "rate-iops")) {
+		test->rate_iops = get_u64(val);
+		test->rate_bytes = 0;
+	} else if (!strcmp(key, "rate")) {
+		test->rate_bytes = get_u64_byte(val);
+		test->rate_iops = 0;
+	} else if (!strcmp(key, "thinktime")) {
+		test->thinktime_ns = get_u64(val) * 1000;
+	} else if (!strcmp(key, "thinktime-blocks")) {
+		test->thinktime_blocks = get_u32(val);
+		if (test->thinktime_blocks < 1) {
+			job_error(job, "thinktime blocks must be at least 1\n");
+			return -1;
+		}
+	} else if (!strcmp(key, "random-distribution")) {
+		if (rand_dist_parse(val, &job->dist) < 0) {
+			job_error(job, "%s is not a valid random distribution\n", val);
+			return -1;
+		}
+	} else if (!strcmp(key, "fanout")) {
+		test->meta_fanout = get_u32(val);
+	} else if (!strcmp(key, "depth")) {
+		test->meta_depth = get_u32(val);
+	} else if (!strcmp(key, "dirs")) {
+		if (!strcmp(val, "shared") || !strcmp(val, "own")) {
+			test->meta_shared = !strcmp(val, "shared");
+		} else {
+			job_error(job, "dirs must be shared or own\n");
+			return -1;
+		}
+	} else if (!strcmp(key, "meta-ops")) {
+		const int mask = meta_ops_parse(val);
+
+		if (mask < 0) {
+			job_error(job, "%s is not a valid list of metadata ops\n", val);
+			return -1;
+		}
+		test->meta_mask = (uint32_t)mask;
+	} else if (!strcmp(key, "checkpoint")) {
+		test->db_ckpt_ns = get_u64(val) * 1000000ULL;
+	} else if (!strcmp(key, "txn-reads")) {
+		test->db_txn_reads = get_u32(val);
+	} else if (!strcmp(key, "data")) {
+		const int mode = data_mode_parse(val);
+
+		if (mode < 0) {
+			job_error(job, "data must be const or random\n");
+			return -1;
+		}
+		test->data_mode = (data_mode_t)mode;
+	} else if (!strcmp(key, "compress-ratio")) {
+		if (data_compress_parse(val, &test->data_compress) < 0) {
+			job_error(job, "compress-ratio must be a number of at least 1\n");
+			return -1;
+		}
+		test->data_mode = DATA_RANDOM;
+	} else if (!strcmp(key, "dedupe")) {
+		test->data_dedupe = get_u32(val);
+		if (test->data_dedupe > 100) {
+			job_error(job, "dedupe must be 0..100\n");
+			return -1;
+		}
+		test->data_mode = DATA_RANDOM;
+	} else if (!strcmp(key, "file")) {
+		if (!strcmp(val, "shared")) {
+			job->shared = true;
+		} else if (!strcmp(val, "own")) {
+			job->shared = false;
+		} else {
+			job_error(job, "file must be shared or own\n");
+			return -1;
+		}
+	} else {
+		job_error(job, "%s is not a valid job setting\n", key);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  job_parse()
+ *	parse name:key=value,key=value,... on top of a copy
+ *	of the defaults from the command line options
+ */
+int job_parse(job_group_t *job, const char *spec, const job_group_t *defaults)
+{
+	const char *colon = strchr(spec, ':');
+	const size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+	char *buf, *token, *saveptr = NULL;
+	int rc = 0;
+
+	*job = *defaults;
+	if ((len == 0) || (len >= sizeof(job->name)) || memchr(spec, ',', len) || memchr(spec, '=', len)) {
+		fprintf(stderr, "Job %s needs a name of up to %d characters before the settings\n",
+			spec, JOB_NAME_LEN - 1);
+		return -1;
+	}
+	memcpy(job->name, spec, len);
+	job->name[len] = '\0';
+	if (!colon)
+		return 0;
+
+	buf = strdup(colon + 1);
+	if (!buf) {
+		fprintf(stderr, "Out of memory parsing job %s\n", job->name);
+		return -1;
+	}
+	for (token = strtok_r(buf, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		char *eq = strchr(token, '=');
+
+		if (eq)
+			*eq++ = '\0';
+		rc = job_set(job, token, eq);
+		if (rc < 0)
+			break;
+	}
+	free(buf);
+
+	return rc;
+}
+
+/*
+ *  job_setup()
+ *	work out a group's sizes, check its settings fit
+ *	together and point its template at its own file,
+ *	distribution and random streams
+ */
+int job_setup(job_group_t *job, const uint32_t index, const char *pathname, const char *filename)
+{
+	test_context_t *test = &job->test;
+	const uint32_t size_flags = job->size_flags & JOB_SIZE_FLAGS;
+
+	if (!job->ti) {
+		job_error(job, "Must specify test to run\n");
+		return -1;
+	}
+	if ((test->engine->flags & IO_ENGINE_DIRECT) && !(test->open_flags & O_DIRECT)) {
+		job_error(job, "The %s I/O engine requires O_DIRECT, use the -d option\n",
+			test->engine->name);
+		return -1;
+	}
+	if (test->rwf_flags && !(test->engine->flags & IO_ENGINE_RWF)) {
+		job_error(job, "RWF flags are not supported by the %s I/O engine\n",
+			test->engine->name);
+		return -1;
+	}
+	if (count_bits(size_flags) != 2) {
+		job_error(job, "Must specify either -b and -l, -b and -n, -l and -n options\n");
+		return -1;
+	}
+
+	if ((size_flags & OPT_BLOCK_SIZE) == 0) {
+		test->block_size = test->file_size / test->blocks;
+		test->per_thread_file_size = test->file_size / job->threads;
+	}
+	if ((size_flags & OPT_FILE_SIZE) == 0) {
+		test->file_size = test->block_size * test->blocks;
+		test->per_thread_file_size = (test->block_size * test->blocks) / job->threads;
+		test->file_size = test->per_thread_file_size * job->threads;
+	}
+	if ((size_flags & OPT_BLOCKS) == 0) {
+		test->per_thread_file_size = test->file_size / job->threads;
+		test->blocks = test->file_size / test->block_size;
+	}
+	if ((test->block_size == 0) || (test->per_thread_file_size < test->block_size)) {
+		job_error(job, "Each thread needs at least one block\n");
+		return -1;
+	}
+	test->per_thread_blocks = test->per_thread_file_size / test->block_size;
+	test->d_per_thread_blocks = (double)test->per_thread_file_size / test->block_size;
+
+	if (test->bssplit && (test->bssplit->max_size > test->per_thread_file_size)) {
+		job_error(job, "Block size split sizes must not exceed the per thread file size\n");
+		return -1;
+	}
+	if ((job->dist.type == RAND_DIST_PERMUTE) && test->bssplit) {
+		job_error(job, "The permute distribution needs a fixed block size, it cannot be used with --bssplit\n");
+		return -1;
+	}
+	if ((job->dist.type == RAND_DIST_PERMUTE) &&
+	    (test->per_thread_file_size % test->block_size)) {
+		/* A partial tail op would take a slot and break exactly once */
+		test->per_thread_file_size = test->per_thread_blocks * test->block_size;
+		test->d_per_thread_blocks = (double)test->per_thread_blocks;
+		test->file_size = test->per_thread_file_size * job->threads;
+		test->blocks = test->per_thread_blocks * job->threads;
+		job_error(job, "The permute distribution visits whole blocks, each thread region is cut to %" PRIu64 " bytes\n",
+			test->per_thread_file_size);
+	}
+	if (test->rate_iops && test->rate_bytes) {
+		job_error(job, "Specify either --rate-iops or --rate, not both\n");
+		return -1;
+	}
+	if ((job->ti->test == meta) && (meta_check(test) < 0))
+		return -1;
+	if ((test->data_mode == DATA_CONST) &&
+	    ((test->data_compress > 1.0) || test->data_dedupe)) {
+		job_error(job, "Compression and dedupe targets need random data\n");
+		return -1;
+	}
+	if (test->verify && !verify_unit(test)) {
+		job_error(job, "Verify needs block and per thread sizes that are multiples of 512 bytes\n");
+		return -1;
+	}
+
+	/* Random slots are block sized, or the smallest split size */
+	if (test->bssplit)
+		test->bssplit = &job->bssplit;
+	test->dist = &job->dist;
+	rand_dist_init(&job->dist, test->per_thread_file_size /
+		(test->bssplit ? test->bssplit->min_size : test->block_size));
+
+	/* Groups must not replay each other's random streams */
+	test->randseed += index;
+
+	if (*job->name && !job->shared)
+		snprintf(job->filename, sizeof(job->filename), "%s-%s", filename, job->name);
+	else
+		snprintf(job->filename, sizeof(job->filename), "%s", filename);
+	test->filename = job->filename;
+	test->pathname = (char *)pathname;
+	test->test_info = job->ti;
+	test->threads = job->threads;
+	if ((job->ti->test == db) && (db_check(test) < 0))
+		return -1;
+
+	return 0;
+}
+
+/*
+ *  job_reads_only()
+ *	true for groups that never write their file
+ */
+static bool job_reads_only(const job_group_t *job)
+{
+	return (job->ti->test == read_seq) || (job->ti->test == read_rnd);
+}
+
+/*
+ *  job_file_reuse()
+ *	a laid out file nobody writes is used again each round,
+ *	and with --keep-layouts is named after its layout and
+ *	left in place for later runs.  A file that gets written
+ *	is instead cloned each round from a kept layout
+ */
+static void job_file_reuse(job_group_t *jobs, const uint32_t n, job_group_t *job)
+{
+	test_context_t *test = &job->test;
+	bool written = !job_reads_only(job);
+	uint32_t i;
+
+	if (!job->file_owner || (job->ti->test_init != read_init))
+		return;
+	for (i = 0; job->shared && (i < n); i++) {
+		if (jobs[i].shared && !job_reads_only(&jobs[i]))
+			written = true;
+	}
+
+	if (!written) {
+		test->setup_reuse = true;
+		if (!test->setup_keep)
+			return;
+		read_setup_name(test, job->setup_size, job->filename, sizeof(job->filename));
+		for (i = 0; job->shared && (i < n); i++) {
+			if (jobs[i].shared)
+				memcpy(jobs[i].filename, job->filename, sizeof(jobs[i].filename));
+		}
+	} else if (test->setup_keep) {
+		read_setup_name(test, job->setup_size, job->template, sizeof(job->template));
+		test->setup_template = job->template;
+	}
+}
+
+/*
+ *  job_files()
+ *	each file is set up and removed by one group.  The
+ *	shared file spans the largest sharing group and is laid
+ *	out in full by a reading group if there is one, so
+ *	readers never run into a hole left by a write test
+ */
+void job_files(job_group_t *jobs, const uint32_t n)
+{
+	job_group_t *owner = NULL;
+	uint64_t shared_size = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		job_group_t *job = &jobs[i];
+
+		job->file_owner = !job->shared;
+		job->setup_size = job->test.file_size;
+		if (!job->shared)
+			continue;
+		if (job->test.file_size > shared_size)
+			shared_size = job->test.file_size;
+		if (!owner || ((owner->ti->test_init != read_init) &&
+		    (job->ti->test_init == read_init)))
+			owner = job;
+	}
+	if (owner) {
+		owner->file_owner = true;
+		owner->setup_size = shared_size;
+	}
+	for (i = 0; i < n; i++)
+		job_file_reuse(jobs, n, &jobs[i]);
+}
+
+/*
+ *  job_round_init()
+ *	set up the files for a round
+ */
+int job_round_init(job_group_t *jobs, const uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		job_group_t *job = &jobs[i];
+		test_context_t test;
+
+		if (!job->file_owner || !job->ti->test_init)
+			continue;
+		test = job->test;
+		test.file_size = job->setup_size;
+		if (job->ti->test_init(&test) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ *  job_round_deinit()
+ *	remove the files after a round
+ */
+int job_round_deinit(job_group_t *jobs, const uint32_t n)
+{
+	uint32_t i;
+	int rc = 0;
+
+	for (i = 0; i < n; i++) {
+		job_group_t *job = &jobs[i];
+
+		if (!job->file_owner || !job->ti->test_deinit)
+			continue;
+		if (job->ti->test_deinit(&job->test) < 0)
+			rc = -1;
+	}
+	return rc;
+}
+
+/*
+ *  job_cache_evict()
+ *	take the groups' files out of the page cache
+ */
+int job_cache_evict(job_group_t *jobs, const uint32_t n)
+{
+	uint32_t i;
+	int rc = 0;
+
+	for (i = 0; i < n; i++) {
+		if (jobs[i].file_owner && (cache_evict(jobs[i].filename) < 0))
+			rc = -1;
+	}
+	return rc;
+}
+
+/*
+ *  job_cache_resident()
+ *	total the bytes of the groups' files and how many
+ *	of them are in the page cache
+ */
+void job_cache_resident(job_group_t *jobs, const uint32_t n, uint64_t *cached, uint64_t *size)
+{
+	uint32_t i;
+
+	*cached = 0;
+	*size = 0;
+	for (i = 0; i < n; i++) {
+		uint64_t c, s;
+
+		if (!jobs[i].file_owner || (cache_resident(jobs[i].filename, &c, &s) < 0))
+			continue;
+		*cached += c;
+		*size += s;
+	}
+}
+
+/*
+ *  job_files_done()
+ *	remove the files kept between rounds, unless kept
+ *	for later runs
+ */
+void job_files_done(job_group_t *jobs, const uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		const test_context_t *test = &jobs[i].test;
+
+		if (jobs[i].file_owner && test->setup_reuse && !test->setup_keep)
+			(void)unlink(test->filename);
+	}
+}
+
+/*
+ *  job_round_done()
+ *	gather a group's results from its workers, the group
+ *	duration runs from its first start to its last finish
+ */
+void job_round_done(job_group_t *job, const test_context_t *tests)
+{
+	const test_context_t *test = &tests[job->first];
+	uint64_t start = test->start_ns, end = test->end_ns;
+	uint32_t t, d;
+
+	for (d = 0; d < IO_DIRS; d++) {
+		job->dir_ops[d] = 0;
+		job->dir_bytes[d] = 0;
+		histogram_reset(&job->lat_round[d]);
+	}
+	for (t = 0; t < job->threads; t++, test++) {
+		if (test->start_ns < start)
+			start = test->start_ns;
+		if (test->end_ns > end)
+			end = test->end_ns;
+		for (d = 0; d < IO_DIRS; d++) {
+			job->dir_ops[d] += test->dir_ops[d];
+			job->dir_bytes[d] += test->dir_bytes[d];
+			histogram_merge(&job->lat_round[d], &test->lat_hist[d]);
+		}
+	}
+	job->duration_ns = (end > start) ? end - start : 1;
+
+	job->total_ns += job->duration_ns;
+	for (d = 0; d < IO_DIRS; d++) {
+		job->total_ops[d] += job->dir_ops[d];
+		job->total_bytes[d] += job->dir_bytes[d];
+		histogram_merge(&job->lat_total[d], &job->lat_round[d]);
+	}
+}
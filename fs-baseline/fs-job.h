@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_JOB_H__
+#define __FS_JOB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-rand.h"
+
+#define MAX_JOBS	(64)
+#define JOB_NAME_LEN	(32)
+
+/*
+ *  A job group is a set of workers running one test with its
+ *  own sizes, engine, flags and rate.  All groups of a phase go
+ *  at once, each on its own file or on the common shared one.
+ *  Only fio job files with stonewall have more than one phase.
+ *  Without --job the command line options make a single group.
+ */
+typedef struct {
+	char		name[JOB_NAME_LEN];
+	test_info_t	*ti;
+	test_context_t	test;		/* Template for the group's workers */
+	uint32_t	threads;
+	uint32_t	first;		/* Index of its first worker */
+	uint32_t	phase;		/* Runs after all groups of earlier phases */
+	uint32_t	size_flags;	/* OPT_BLOCK_SIZE, OPT_FILE_SIZE, OPT_BLOCKS given */
+	bool		shared;		/* Runs on the common test file */
+	bool		file_owner;	/* Sets up and removes its file each round */
+	uint64_t	setup_size;	/* File size laid out by the owner */
+	char		filename[PATH_MAX];
+	char		template[PATH_MAX];	/* Kept layout of a file that gets written */
+	io_dist_t	dist;		/* Scaled to this group's regions */
+	io_bssplit_t	bssplit;
+
+	/* Results of the current round */
+	uint64_t	duration_ns;
+	uint64_t	dir_ops[IO_DIRS];
+	uint64_t	dir_bytes[IO_DIRS];
+	histogram_t	lat_round[IO_DIRS];
+
+	/* Results over all rounds */
+	uint64_t	total_ns;
+	uint64_t	total_ops[IO_DIRS];
+	uint64_t	total_bytes[IO_DIRS];
+	histogram_t	lat_total[IO_DIRS];
+} job_group_t;
+
+extern int job_set(job_group_t *job, const char *key, const char *val);
+extern int job_parse(job_group_t *job, const char *spec, const job_group_t *defaults);
+extern int job_setup(job_group_t *job, const uint32_t index,
+	const char *pathname, const char *filename);
+extern void job_files(job_group_t *jobs, const uint32_t n);
+extern int job_round_init(job_group_t *jobs, const uint32_t n);
+extern int job_round_deinit(job_group_t *jobs, const uint32_t n);
+extern void job_files_done(job_group_t *jobs, const uint32_t n);
+extern int job_cache_evict(job_group_t *jobs, const uint32_t n);
+extern void job_cache_resident(job_group_t *jobs, const uint32_t n,
+	uint64_t *cached, uint64_t *size);
+extern void job_round_done(job_group_t *job, const test_context_t *tests);
+
+#endif
@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "fs-test.h"
+#include "fs-affinity.h"
+#include "fs-rand.h"
+#include "fs-meta.h"
+
+/*
+ *  Metadata workload on a tree of directories, fanout
+ *  subdirectories per level and meta_depth levels, files
+ *  spread round robin over the leaf directories.  Each worker
+ *  creates its files, then optionally stats them, reads the
+ *  leaf directories and renames them, then unlinks them, all
+ *  but create and readdir in a random order.  Workers each
+ *  have a tree of their own, or share one to contend on the
+ *  directory locks.
+ */
+#define META_MAX_DEPTH	(32)
+
+static const char *meta_op_names[] = {
+	"mkdir",
+	"create",
+	"stat",
+	"readdir",
+	"rename",
+	"unlink",
+};
+
+typedef struct {
+	test_context_t	*test;
+	char		root[PATH_MAX];
+	uint64_t	files;		/* Per worker */
+	uint64_t	leaves;
+	void		*buffer;	/* Data written to each new file */
+	rand_state_t	rand;
+	char		prefix;		/* 'f' as created, 'r' once renamed */
+} meta_run_t;
+
+const char *meta_op_name(const meta_op_t op)
+{
+	return meta_op_names[op];
+}
+
+/*
+ *  meta_ops_parse()
+ *	comma separated list of the optional ops stat, readdir
+ *	and rename, or none.  Returns -1 for unknown names
+ */
+int meta_ops_parse(const char *list)
+{
+	char *str, *token, *saveptr = NULL;
+	int mask = 0;
+
+	if (!strcmp(list, "none"))
+		return 0;
+	str = strdup(list);
+	if (!str)
+		return -1;
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		if (!strcmp(token, "stat"))
+			mask |= 1 << META_STAT;
+		else if (!strcmp(token, "readdir"))
+			mask |= 1 << META_READDIR;
+		else if (!strcmp(token, "rename"))
+			mask |= 1 << META_RENAME;
+		else {
+			mask = -1;
+			break;
+		}
+	}
+	free(str);
+
+	return mask;
+}
+
+/*
+ *  meta_check()
+ *	the tree must be of a sane size
+ */
+int meta_check(const test_context_t *test)
+{
+	uint64_t n = 1, dirs = 0;
+	uint32_t level;
+
+	if ((test->meta_fanout < 1) || (test->meta_depth > META_MAX_DEPTH)) {
+		fprintf(stderr, "Metadata tree needs a fanout of at least 1 and a depth of at most %d\n",
+			META_MAX_DEPTH);
+		return -1;
+	}
+	for (level = 0; level < test->meta_depth; level++) {
+		n *= test->meta_fanout;
+		dirs += n;
+		if (dirs > META_MAX_DIRS) {
+			fprintf(stderr, "Metadata tree is limited to %d directories\n", META_MAX_DIRS);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  meta_dir_path()
+ *	directory index at a level of the tree, the index in
+ *	base fanout gives the names from the top down
+ */
+static size_t meta_dir_path(
+	char *buf,
+	const size_t len,
+	const char *root,
+	uint64_t index,
+	const uint32_t fanout,
+	const uint32_t level)
+{
+	uint32_t digits[META_MAX_DEPTH], i;
+	size_t n;
+
+	for (i = level; i > 0; i--) {
+		digits[i - 1] = (uint32_t)(index % fanout);
+		index /= fanout;
+	}
+	n = (size_t)snprintf(buf, len, "%s", root);
+	for (i = 0; (i < level) && (n < len); i++)
+		n += (size_t)snprintf(buf + n, len - n, "/%" PRIx32, digits[i]);
+
+	return n;
+}
+
+static void meta_file_path(const meta_run_t *m, char *buf, const size_t len, const uint64_t i)
+{
+	const test_context_t *test = m->test;
+	size_t n = meta_dir_path(buf, len, m->root, i % m->leaves,
+		test->meta_fanout, test->meta_depth);
+
+	if (n < len)
+		snprintf(buf + n, len - n, "/%c%" PRIx32 "-%" PRIx64,
+			m->prefix, test->instance, i);
+}
+
+static void meta_record(
+	test_context_t *test,
+	const meta_op_t op,
+	const uint64_t bytes,
+	const uint64_t ns)
+{
+	const io_dir_t dir = ((op == META_STAT) || (op == META_READDIR)) ?
+		IO_DIR_READ : IO_DIR_WRITE;
+
+	histogram_record(&test->meta_hist[op], ns);
+	histogram_record(&test->lat_hist[dir], ns);
+	counters_update(test->counters, 1, bytes, ns);
+	test->meta_ops[op]++;
+	test->dir_ops[dir]++;
+	test->dir_bytes[dir] += bytes;
+}
+
+static int meta_error(test_context_t *test, const meta_op_t op, const char *path)
+{
+	const int err = errno;
+
+	fprintf(stderr, "Metadata %s of %s failed: %d %s\n",
+		meta_op_names[op], path, err, strerror(err));
+	test->ret = -err;
+	return -err;
+}
+
+/*
+ *  meta_tree()
+ *	make the directories below a root, worker trees are
+ *	timed as mkdir ops, the shared tree is made up front
+ */
+static int meta_tree(test_context_t *test, const char *root, const bool timed)
+{
+	char path[PATH_MAX];
+	uint64_t n = 1, i;
+	uint32_t level;
+
+	for (level = 1; level <= test->meta_depth; level++) {
+		n *= test->meta_fanout;
+		for (i = 0; (i < n) && (!timed || test_continue()); i++) {
+			uint64_t t_start;
+
+			meta_dir_path(path, sizeof(path), root, i, test->meta_fanout, level);
+			t_start = time_now_ns();
+			if (mkdir(path, S_IRWXU) < 0)
+				return meta_error(test, META_MKDIR, path);
+			if (timed)
+				meta_record(test, META_MKDIR, 0, time_now_ns() - t_start);
+		}
+	}
+	return 0;
+}
+
+/*
+ *  meta_pass()
+ *	one op over all of the worker's files, or for readdir
+ *	over its leaf directories
+ */
+static int meta_pass(meta_run_t *m, const meta_op_t op)
+{
+	test_context_t *test = m->test;
+	const uint64_t t_pass = time_now_ns();
+	uint64_t n = m->files, i;
+	rand_perm_t perm;
+	int rc = 0;
+
+	if (op == META_READDIR) {
+		/* Workers split a shared tree's leaves between them */
+		n = test->meta_shared ?
+			(m->leaves + test->threads - 1 - test->instance) / test->threads : m->leaves;
+	} else if (op != META_CREATE) {
+		rand_perm_init(&perm, n, &m->rand);
+	}
+
+	for (i = 0; (i < n) && test_continue(); i++) {
+		char path[PATH_MAX], to[PATH_MAX];
+		uint64_t index = i, t_start, bytes = 0;
+		struct stat buf;
+		int fd;
+
+		if ((op != META_CREATE) && (op != META_READDIR))
+			rand_perm_fill(&perm, &index, 1);
+
+		if (op == META_READDIR) {
+			DIR *dir;
+
+			if (test->meta_shared)
+				index = test->instance + (i * test->threads);
+			meta_dir_path(path, sizeof(path), m->root, index,
+				test->meta_fanout, test->meta_depth);
+			t_start = time_now_ns();
+			dir = opendir(path);
+			if (!dir) {
+				rc = meta_error(test, op, path);
+				break;
+			}
+			while (readdir(dir))
+				;
+			(void)closedir(dir);
+		} else {
+			meta_file_path(m, path, sizeof(path), index);
+			if (op == META_RENAME) {
+				m->prefix = 'r';
+				meta_file_path(m, to, sizeof(to), index);
+				m->prefix = 'f';
+			}
+			t_start = time_now_ns();
+			switch (op) {
+			case META_CREATE:
+				fd = open(path, O_WRONLY | O_CREAT | O_EXCL | test->open_flags,
+					S_IRUSR | S_IWUSR);
+				if (fd < 0) {
+					rc = meta_error(test, op, path);
+					break;
+				}
+				if (write(fd, m->buffer, test->block_size) < 0)
+					rc = meta_error(test, op, path);
+				(void)close(fd);
+				bytes = test->block_size;
+				break;
+			case META_STAT:
+				if (stat(path, &buf) < 0)
+					rc = meta_error(test, op, path);
+				break;
+			case META_RENAME:
+				if (rename(path, to) < 0)
+					rc = meta_error(test, op, path);
+				break;
+			default:
+				if (unlink(path) < 0)
+					rc = meta_error(test, op, path);
+				break;
+			}
+			if (rc < 0)
+				break;
+		}
+		meta_record(test, op, bytes, time_now_ns() - t_start);
+	}
+	if (op == META_RENAME)
+		m->prefix = 'r';
+	test->meta_ns[op] += time_now_ns() - t_pass;
+
+	return rc;
+}
+
+void *meta(void *ctxt)
+{
+	test_context_t *test = (test_context_t *)ctxt;
+	uint64_t time_start, time_end, bytes;
+	meta_run_t m;
+	uint32_t level;
+	int rc = 0;
+
+	test->ret = 0;
+	memset(&m, 0, sizeof(m));
+	m.test = test;
+	m.files = test->per_thread_blocks;
+	for (m.leaves = 1, level = 0; level < test->meta_depth; level++)
+		m.leaves *= test->meta_fanout;
+	rand_seed(&m.rand, test->randseed, test->instance);
+	m.buffer = affinity_alloc_buffer((size_t)test->block_size, test->node);
+	if (!m.buffer) {
+		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
+			errno, strerror(errno));
+		test->ret = -ENOMEM;
+		return NULL;
+	}
+	memset(m.buffer, test->instance & 0xff, test->block_size);
+	if (test->meta_shared)
+		snprintf(m.root, sizeof(m.root), "%s", test->filename);
+	else
+		snprintf(m.root, sizeof(m.root), "%s/t%" PRIx32, test->filename, test->instance);
+
+	time_start = time_now_ns();
+	if (!test->meta_shared) {
+		uint64_t t_start = time_now_ns();
+
+		if (mkdir(m.root, S_IRWXU) < 0)
+			rc = meta_error(test, META_MKDIR, m.root);
+		else
+			meta_record(test, META_MKDIR, 0, time_now_ns() - t_start);
+		if (rc == 0)
+			rc = meta_tree(test, m.root, true);
+		test->meta_ns[META_MKDIR] = time_now_ns() - t_start;
+	}
+	/* Time based runs repeat the whole cycle */
+	while ((rc == 0) && test_continue()) {
+		meta_op_t op;
+
+		m.prefix = 'f';
+		for (op = META_CREATE; (rc == 0) && (op <= META_UNLINK) && test_continue(); op++) {
+			if ((op == META_CREATE) || (op == META_UNLINK) ||
+			    (test->meta_mask & (1U << op)))
+				rc = meta_pass(&m, op);
+		}
+		if (!test->time_based)
+			break;
+	}
+	time_end = time_now_ns();
+	free(m.buffer);
+
+	bytes = test->dir_bytes[IO_DIR_READ] + test->dir_bytes[IO_DIR_WRITE];
+	test->ops = test->dir_ops[IO_DIR_READ] + test->dir_ops[IO_DIR_WRITE];
+	test->duration_ns = (time_end > time_start) ? time_end - time_start : 1;
+	test->response_time_ns = test->ops ? test->duration_ns / test->ops : 0;
+	test->rate = (double)bytes * NS_PER_SEC / (double)test->duration_ns;
+	test->op_rate = (double)test->ops * NS_PER_SEC / (double)test->duration_ns;
+
+	return NULL;
+}
+
+/*
+ *  meta_init()
+ *	make the root of the tree, and all of a shared tree
+ */
+int meta_init(test_context_t *test)
+{
+	(void)meta_deinit(test);
+	if (mkdir(test->filename, S_IRWXU) < 0) {
+		fprintf(stderr, "Cannot create directory %s: %d %s\n",
+			test->filename, errno, strerror(errno));
+		return -errno;
+	}
+	if (test->meta_shared && (meta_tree(test, test->filename, false) < 0))
+		return -1;
+	(void)sync();
+
+	return 0;
+}
+
+static int meta_remove(const char *path, const struct stat *buf, int flag, struct FTW *ftw)
+{
+	(void)buf;
+	(void)ftw;
+
+	(void)(flag == FTW_DP ? rmdir(path) : unlink(path));
+	return 0;
+}
+
+/*
+ *  meta_deinit()
+ *	remove whatever is left of the tree
+ */
+int meta_deinit(test_context_t *test)
+{
+	(void)nftw(test->filename, meta_remove, 64, FTW_DEPTH | FTW_PHYS);
+	return 0;
+}
+
+void meta_results_reset(meta_results_t *res)
+{
+	uint32_t op;
+
+	for (op = 0; op < META_OPS; op++) {
+		res->ops[op] = 0;
+		res->rate[op] = 0.0;
+		histogram_reset(&res->lat[op]);
+	}
+}
+
+/*
+ *  meta_results_add()
+ *	add a worker's ops, its rate for each op is over
+ *	its own time in that op's passes
+ */
+void meta_results_add(meta_results_t *res, const test_context_t *test)
+{
+	uint32_t op;
+
+	for (op = 0; op < META_OPS; op++) {
+		res->ops[op] += test->meta_ops[op];
+		if (test->meta_ns[op])
+			res->rate[op] += (double)test->meta_ops[op] * NS_PER_SEC /
+				(double)test->meta_ns[op];
+		histogram_merge(&res->lat[op], &test->meta_hist[op]);
+	}
+}
+
+/*
+ *  meta_results_merge()
+ *	add a round to the totals, rates are per round
+ *	and are not carried over
+ */
+void meta_results_merge(meta_results_t *dst, const meta_results_t *src)
+{
+	uint32_t op;
+
+	for (op = 0; op < META_OPS; op++) {
+		dst->ops[op] += src->ops[op];
+		histogram_merge(&dst->lat[op], &src->lat[op]);
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_META_H__
+#define __FS_META_H__
+
+#include <stdint.h>
+
+#include "fs-test.h"
+#include "fs-histogram.h"
+
+#define META_MAX_DIRS		(1 << 20)
+#define META_DEFAULT_MASK	((1U << META_STAT) | (1U << META_READDIR) | (1U << META_RENAME))
+
+/*
+ *  Metadata results of a round or of all rounds, the rate
+ *  of an op is the sum of each worker's rate over the time
+ *  it spent in that op's pass
+ */
+typedef struct {
+	uint64_t	ops[META_OPS];
+	double		rate[META_OPS];
+	histogram_t	lat[META_OPS];
+} meta_results_t;
+
+extern void *meta(void *ctxt);
+extern int meta_init(test_context_t *test);
+extern int meta_deinit(test_context_t *test);
+extern int meta_check(const test_context_t *test);
+extern int meta_ops_parse(const char *list);
+extern const char *meta_op_name(const meta_op_t op);
+extern void meta_results_reset(meta_results_t *res);
+extern void meta_results_add(meta_results_t *res, const test_context_t *test);
+extern void meta_results_merge(meta_results_t *dst, const meta_results_t *src);
+
+#endif
@@ -30,12 +30,12 @@
 void *noop(void *ctxt)
 {
 	struct timeval tv;
-	double time_start, time_end;
+	uint64_t time_start, time_end;
 	test_context_t *test = (test_context_t *)ctxt;
 	uint64_t secs = test->per_thread_file_size;
 
-	time_start = timeval_to_double();
-	while ((opt_flags & OPT_CONT) && secs) {
+	time_start = time_now_ns();
+	while (test_continue() && secs) {
 		tv.tv_sec = secs / 1000000;
 		tv.tv_usec = secs % 1000000;
 		if (tv.tv_sec > 1)
@@ -44,10 +44,10 @@ void *noop(void *ctxt)
 		secs -= ((1000000 * tv.tv_sec) + tv.tv_usec);
 		select(0, NULL, NULL, NULL, &tv);
 	}
-	time_end = timeval_to_double();
+	time_end = time_now_ns();
 
-	test->duration_s = time_end - time_start;
-	test->response_time_ms = 0;
+	test->duration_ns = time_end - time_start;
+	test->response_time_ns = 0;
 	test->rate = 0.0;
 	test->ops = 0;
 	test->op_rate = 0;
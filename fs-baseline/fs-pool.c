@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "fs-test.h"
+#include "fs-pool.h"
+#include "fs-affinity.h"
+
+/*
+ *  Long lived workers, created once and reused for every
+ *  round.  Each round all workers are released together by
+ *  the start barrier and main waits on the done barrier.
+ *  Main is the extra party on both barriers.
+ */
+static pthread_t *pool_threads;
+static uint32_t pool_n;
+static pool_stop_t pool_stop_policy;
+static pthread_barrier_t pool_start, pool_done;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_finish;	/* Signalled as each worker finishes */
+static uint32_t pool_finished;
+static bool pool_quit;
+
+static const char *pool_stop_names[] = {
+	"last",
+	"first",
+};
+
+/*
+ *  pool_stop()
+ *	map a --stop name to a pool_stop_t, -1 if invalid
+ */
+int pool_stop(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(pool_stop_names) / sizeof(pool_stop_names[0]); i++) {
+		if (!strcmp(name, pool_stop_names[i]))
+			return (int)i;
+	}
+	return -1;
+}
+
+const char *pool_stop_name(const pool_stop_t stop)
+{
+	return pool_stop_names[stop];
+}
+
+static void *pool_worker(void *arg)
+{
+	test_context_t *test = (test_context_t *)arg;
+
+	/* Wait until all workers exist and the barriers are set up */
+	pthread_mutex_lock(&pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+	if (pool_quit)
+		return NULL;
+
+	/* Only look at pool_quit once released, pool_destroy() waits on the barrier */
+	for (;;) {
+		pthread_barrier_wait(&pool_start);
+		if (pool_quit)
+			break;
+
+		/* Workers of groups in another phase sit this run out */
+		if (test->test_info) {
+			test->start_ns = time_now_ns();
+			(void)test->test_info->test(test);
+			test->end_ns = time_now_ns();
+			/* Only the first finisher needs to dirty the stop line */
+			if ((pool_stop_policy == POOL_STOP_FIRST) && !test_stop.round_done)
+				test_stop.round_done = true;
+		}
+
+		pthread_mutex_lock(&pool_lock);
+		pool_finished++;
+		pthread_cond_signal(&pool_finish);
+		pthread_mutex_unlock(&pool_lock);
+
+		pthread_barrier_wait(&pool_done);
+	}
+	return NULL;
+}
+
+/*
+ *  pool_create()
+ *	start n workers, one per test context, pinned to
+ *	their cpu if a placement is given.  Each runs the
+ *	test of its own context, so groups can differ
+ */
+int pool_create(
+	test_context_t *tests,
+	const uint32_t n,
+	const pool_stop_t stop,
+	const placement_t *place)
+{
+	const size_t mask_size = CPU_ALLOC_SIZE(MAX_CPUS);
+	pthread_attr_t attr;
+	pthread_condattr_t cattr;
+	cpu_set_t *mask;
+	uint32_t i;
+	int ret = 0;
+
+	/* cpu_set_t only covers 1024 cpus, size the mask for all of them */
+	mask = CPU_ALLOC(MAX_CPUS);
+	pool_threads = calloc((size_t)n, sizeof(*pool_threads));
+	if (!pool_threads || !mask) {
+		fprintf(stderr, "Out of memory allocating worker threads\n");
+		free(pool_threads);
+		pool_threads = NULL;
+		if (mask)
+			CPU_FREE(mask);
+		return -ENOMEM;
+	}
+	pool_stop_policy = stop;
+	pool_quit = false;
+
+	pthread_mutex_lock(&pool_lock);
+	for (i = 0; i < n; i++) {
+		pthread_attr_init(&attr);
+		if (place && (place[i].cpu >= 0) && (place[i].cpu < MAX_CPUS)) {
+			CPU_ZERO_S(mask_size, mask);
+			CPU_SET_S(place[i].cpu, mask_size, mask);
+			pthread_attr_setaffinity_np(&attr, mask_size, mask);
+		}
+		ret = pthread_create(&pool_threads[i], &attr, pool_worker, &tests[i]);
+		pthread_attr_destroy(&attr);
+		if (ret) {
+			fprintf(stderr, "Cannot start worker thread instance %" PRIu32 "\n", i);
+			break;
+		}
+	}
+	pool_n = i;
+	CPU_FREE(mask);
+	if (ret) {
+		/* Workers have not reached the barriers yet, just let them go */
+		pool_quit = true;
+		pthread_mutex_unlock(&pool_lock);
+		for (i = 0; i < pool_n; i++)
+			pthread_join(pool_threads[i], NULL);
+		free(pool_threads);
+		pool_threads = NULL;
+		pool_n = 0;
+		return -ret;
+	}
+	pthread_barrier_init(&pool_start, NULL, n + 1);
+	pthread_barrier_init(&pool_done, NULL, n + 1);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&pool_finish, &cattr);
+	pthread_condattr_destroy(&cattr);
+	pthread_mutex_unlock(&pool_lock);
+
+	return 0;
+}
+
+/*
+ *  pool_run()
+ *	release all workers for one round, or one phase of it,
+ *	and wait for them, with a runtime the phase is stopped
+ *	when it is up.  Main sleeps on the deadline so workers
+ *	never read the clock to check it
+ */
+void pool_run(const uint64_t runtime_ns)
+{
+	test_stop.round_done = false;
+	pool_finished = 0;
+	pthread_barrier_wait(&pool_start);
+
+	if (runtime_ns) {
+		struct timespec deadline;
+
+		(void)clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += (time_t)(runtime_ns / NS_PER_SEC);
+		deadline.tv_nsec += (long)(runtime_ns % NS_PER_SEC);
+		if (deadline.tv_nsec >= (long)NS_PER_SEC) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= (long)NS_PER_SEC;
+		}
+
+		pthread_mutex_lock(&pool_lock);
+		while (pool_finished < pool_n) {
+			if (pthread_cond_timedwait(&pool_finish, &pool_lock, &deadline) == ETIMEDOUT) {
+				test_stop.round_done = true;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&pool_lock);
+	}
+	pthread_barrier_wait(&pool_done);
+}
+
+/*
+ *  pool_destroy()
+ *	tell the workers to exit and reap them
+ */
+void pool_destroy(void)
+{
+	uint32_t i;
+
+	if (!pool_threads)
+		return;
+
+	pool_quit = true;
+	pthread_barrier_wait(&pool_start);
+	for (i = 0; i < pool_n; i++)
+		pthread_join(pool_threads[i], NULL);
+	pthread_barrier_destroy(&pool_start);
+	pthread_barrier_destroy(&pool_done);
+	pthread_cond_destroy(&pool_finish);
+	free(pool_threads);
+	pool_threads = NULL;
+	pool_n = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_POOL_H__
+#define __FS_POOL_H__
+
+#include "fs-test.h"
+#include "fs-affinity.h"
+
+typedef enum {
+	POOL_STOP_LAST = 0,	/* Round ends when all workers finish */
+	POOL_STOP_FIRST,	/* Round ends when the first worker finishes */
+} pool_stop_t;
+
+extern int pool_stop(const char *name);
+extern const char *pool_stop_name(const pool_stop_t stop);
+extern int pool_create(test_context_t *tests, const uint32_t n,
+	const pool_stop_t stop, const placement_t *place);
+extern void pool_run(const uint64_t runtime_ns);
+extern void pool_destroy(void);
+
+#endif
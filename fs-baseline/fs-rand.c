@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "fs-rand.h"
+
+/* Terms of the zipf zeta sum computed exactly, the tail is integrated */
+#define ZETA_EXACT_TERMS	(1000000ULL)
+
+static const char *dist_names[] = {
+	"uniform",
+	"zipf",
+	"pareto",
+	"normal",
+	"permute",
+};
+
+/*
+ *  rand_jump()
+ *	advance 2^128 steps, the start of the next stream
+ */
+static void rand_jump(rand_state_t *r)
+{
+	static const uint64_t jump[] = {
+		0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+		0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+	};
+	uint64_t s[4] = { 0, 0, 0, 0 };
+	size_t i;
+	int b;
+
+	for (i = 0; i < sizeof(jump) / sizeof(jump[0]); i++) {
+		for (b = 0; b < 64; b++) {
+			if (jump[i] & (1ULL << b)) {
+				s[0] ^= r->s[0];
+				s[1] ^= r->s[1];
+				s[2] ^= r->s[2];
+				s[3] ^= r->s[3];
+			}
+			(void)rand_u64(r);
+		}
+	}
+	memcpy(r->s, s, sizeof(s));
+}
+
+/*
+ *  rand_seed()
+ *	seed from a 64 bit value and select the stream
+ */
+void rand_seed(rand_state_t *r, const uint64_t seed, const uint32_t stream)
+{
+	uint64_t x = seed;
+	uint32_t i;
+
+	for (i = 0; i < 4; i++)
+		r->s[i] = rand_splitmix64(&x);
+	for (i = 0; i < stream; i++)
+		rand_jump(r);
+}
+
+/*
+ *  rand_dist_parse()
+ *	parse uniform, zipf:theta, pareto:h or normal:stddev%
+ */
+int rand_dist_parse(const char *str, io_dist_t *dist)
+{
+	const char *colon = strchr(str, ':');
+	const size_t len = colon ? (size_t)(colon - str) : strlen(str);
+	size_t i;
+
+	memset(dist, 0, sizeof(*dist));
+	for (i = 0; i < sizeof(dist_names) / sizeof(dist_names[0]); i++) {
+		if ((strlen(dist_names[i]) == len) && !strncmp(str, dist_names[i], len))
+			break;
+	}
+	if (i == sizeof(dist_names) / sizeof(dist_names[0]))
+		return -1;
+	dist->type = (rand_dist_type_t)i;
+
+	if ((dist->type == RAND_DIST_UNIFORM) || (dist->type == RAND_DIST_PERMUTE))
+		return colon ? -1 : 0;
+	if (!colon)
+		return -1;
+	dist->param = atof(colon + 1);
+
+	switch (dist->type) {
+	case RAND_DIST_ZIPF:
+		return (dist->param > 0.0) ? 0 : -1;
+	case RAND_DIST_PARETO:
+		return ((dist->param > 0.0) && (dist->param < 1.0)) ? 0 : -1;
+	case RAND_DIST_NORMAL:
+		return ((dist->param > 0.0) && (dist->param <= 100.0)) ? 0 : -1;
+	default:
+		return -1;
+	}
+}
+
+const char *rand_dist_name(const io_dist_t *dist)
+{
+	return dist_names[dist->type];
+}
+
+/*
+ *  zeta()
+ *	sum of 1/i^theta for i = 1..n, exact for the first
+ *	terms and an Euler-Maclaurin estimate for the tail so
+ *	multi-billion slot regions do not take minutes
+ */
+static double zeta(const uint64_t n, const double theta)
+{
+	const uint64_t exact = n < ZETA_EXACT_TERMS ? n : ZETA_EXACT_TERMS;
+	double sum = 0.0, a, b;
+	uint64_t i;
+
+	for (i = 1; i <= exact; i++)
+		sum += pow((double)i, -theta);
+	if (exact == n)
+		return sum;
+
+	a = (double)exact;
+	b = (double)n;
+	sum += (pow(b, 1.0 - theta) - pow(a, 1.0 - theta)) / (1.0 - theta);
+	sum += 0.5 * (pow(b, -theta) - pow(a, -theta));
+
+	return sum;
+}
+
+/*
+ *  Rejection-inversion helpers, Hoermann and Derflinger,
+ *  "Rejection-inversion to generate variates from monotone
+ *  discrete distributions".  zipf_h() is the unnormalised
+ *  density x^-theta, zipf_hint() its integral, both stay
+ *  finite through theta = 1
+ */
+static inline double zipf_log1p_x(const double x)
+{
+	return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static inline double zipf_expm1_x(const double x)
+{
+	return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+static inline double zipf_h(const double x, const double theta)
+{
+	return exp(-theta * log(x));
+}
+
+static inline double zipf_hint(const double x, const double theta)
+{
+	const double lx = log(x);
+
+	return zipf_expm1_x((1.0 - theta) * lx) * lx;
+}
+
+static inline double zipf_hint_inv(const double x, const double theta)
+{
+	double t = x * (1.0 - theta);
+
+	if (t < -1.0)
+		t = -1.0;
+	return exp(zipf_log1p_x(t) * x);
+}
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+	while (b) {
+		const uint64_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ *  rand_dist_init()
+ *	precompute the distribution constants for n slots
+ */
+void rand_dist_init(io_dist_t *dist, const uint64_t n)
+{
+	const double theta = dist->param;
+
+	dist->n = n ? n : 1;
+
+	/* A multiplier coprime to n makes the scatter a bijection */
+	dist->scatter_mul = 0x9e3779b97f4a7c15ULL % dist->n;
+	while (gcd64(dist->scatter_mul, dist->n) != 1)
+		dist->scatter_mul++;
+	dist->scatter_add = 0x6a09e667f3bcc909ULL % dist->n;
+
+	switch (dist->type) {
+	case RAND_DIST_ZIPF:
+		if (theta < 1.0) {
+			/* Gray et al, "Quickly Generating Billion-Record Synthetic Databases" */
+			dist->zetan = zeta(dist->n, theta);
+			dist->zeta2 = zeta(2, theta);
+			dist->alpha = 1.0 / (1.0 - theta);
+			dist->eta = (1.0 - pow(2.0 / (double)dist->n, 1.0 - theta)) /
+				(1.0 - dist->zeta2 / dist->zetan);
+		} else {
+			/* Gray et al's inversion only holds below 1, use rejection-inversion */
+			dist->hx1 = zipf_hint(1.5, theta) - 1.0;
+			dist->hxn = zipf_hint((double)dist->n + 0.5, theta);
+			dist->squeeze = 2.0 - zipf_hint_inv(zipf_hint(2.5, theta) -
+				zipf_h(2.0, theta), theta);
+		}
+		break;
+	case RAND_DIST_PARETO:
+		dist->pareto_pow = log(dist->param) / log(1.0 - dist->param);
+		break;
+	case RAND_DIST_NORMAL:
+		dist->sigma = (double)dist->n * dist->param / 100.0;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ *  rand_scatter()
+ *	zipf and pareto put the hot slots at the start, map
+ *	them one to one over the region so the hot set is
+ *	spread out and every slot can still be reached
+ */
+static inline uint64_t rand_scatter(const io_dist_t *dist, const uint64_t val)
+{
+	return (uint64_t)(((unsigned __int128)val * dist->scatter_mul +
+		dist->scatter_add) % dist->n);
+}
+
+/*
+ *  rand_zipf_ri()
+ *	zipf rank in [0, n) by rejection-inversion, for theta >= 1
+ */
+static inline uint64_t rand_zipf_ri(const io_dist_t *dist, rand_state_t *r)
+{
+	const double theta = dist->param;
+
+	for (;;) {
+		const double u = dist->hxn + rand_double(r) * (dist->hx1 - dist->hxn);
+		const double x = zipf_hint_inv(u, theta);
+		double k = floor(x + 0.5);
+
+		if (k < 1.0)
+			k = 1.0;
+		else if (k > (double)dist->n)
+			k = (double)dist->n;
+		if ((k - x <= dist->squeeze) ||
+		    (u >= zipf_hint(k + 0.5, theta) - zipf_h(k, theta)))
+			return (uint64_t)k - 1;
+	}
+}
+
+/*
+ *  rand_dist_fill()
+ *	generate count slots in [0, n), batched so the
+ *	generator stays out of the per op path
+ */
+void rand_dist_fill(
+	const io_dist_t *dist,
+	rand_state_t *r,
+	const uint64_t centre,
+	uint64_t *out,
+	const uint32_t count)
+{
+	const uint64_t n = dist->n;
+	uint32_t i;
+
+	switch (dist->type) {
+	case RAND_DIST_UNIFORM:
+		for (i = 0; i < count; i++)
+			out[i] = rand_bounded(r, n);
+		break;
+	case RAND_DIST_ZIPF:
+		if (dist->param >= 1.0) {
+			for (i = 0; i < count; i++)
+				out[i] = rand_scatter(dist, rand_zipf_ri(dist, r));
+			break;
+		}
+		for (i = 0; i < count; i++) {
+			const double u = rand_double(r);
+			const double uz = u * dist->zetan;
+			uint64_t v;
+
+			if (uz < 1.0)
+				v = 0;
+			else if (uz < 1.0 + pow(0.5, dist->param))
+				v = 1;
+			else
+				v = (uint64_t)((double)n * pow(dist->eta * u - dist->eta + 1.0, dist->alpha));
+			out[i] = rand_scatter(dist, v < n ? v : n - 1);
+		}
+		break;
+	case RAND_DIST_PARETO:
+		for (i = 0; i < count; i++) {
+			const uint64_t v = (uint64_t)((double)(n - 1) * pow(rand_double(r), dist->pareto_pow));
+
+			out[i] = rand_scatter(dist, v < n ? v : n - 1);
+		}
+		break;
+	case RAND_DIST_PERMUTE:
+		/* Needs per pass state, see rand_perm_fill() */
+		break;
+	case RAND_DIST_NORMAL:
+		for (i = 0; i < count; i += 2) {
+			/* Box-Muller gives a pair of deviates per draw */
+			const double u1 = 1.0 - rand_double(r);
+			const double u2 = rand_double(r);
+			const double mag = dist->sigma * sqrt(-2.0 * log(u1));
+			const double d[2] = { mag * cos(2.0 * M_PI * u2), mag * sin(2.0 * M_PI * u2) };
+			uint32_t j;
+
+			for (j = 0; (j < 2) && (i + j < count); j++) {
+				int64_t v = (int64_t)centre + (int64_t)llround(d[j]);
+
+				v %= (int64_t)n;
+				if (v < 0)
+					v += (int64_t)n;
+				out[i + j] = (uint64_t)v;
+			}
+		}
+		break;
+	}
+}
+
+/*
+ *  rand_perm_init()
+ *	pick fresh keys for a permutation of [0, n)
+ */
+void rand_perm_init(rand_perm_t *perm, const uint64_t n, rand_state_t *r)
+{
+	uint32_t bits = 2, i;
+
+	perm->n = n ? n : 1;
+	while ((bits < 64) && ((1ULL << bits) < perm->n))
+		bits += 2;
+	perm->half_bits = bits / 2;
+	perm->half_mask = (1ULL << perm->half_bits) - 1;
+	for (i = 0; i < RAND_PERM_ROUNDS; i++)
+		perm->keys[i] = rand_u64(r);
+	perm->next = 0;
+}
+
+static inline uint64_t rand_perm_round(const uint64_t x, const uint64_t key)
+{
+	uint64_t z = x ^ key;
+
+	z = (z ^ (z >> 33)) * 0xff51afd7ed558ccdULL;
+	z = (z ^ (z >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+	return z ^ (z >> 33);
+}
+
+/*
+ *  rand_perm_map()
+ *	Feistel over 2 * half_bits, the domain is at most 4n
+ *	so cycle walking takes a few steps at worst
+ */
+static inline uint64_t rand_perm_map(const rand_perm_t *perm, uint64_t x)
+{
+	do {
+		uint64_t left = x >> perm->half_bits;
+		uint64_t right = x & perm->half_mask;
+		uint32_t i;
+
+		for (i = 0; i < RAND_PERM_ROUNDS; i++) {
+			const uint64_t tmp = right;
+
+			right = left ^ (rand_perm_round(right, perm->keys[i]) & perm->half_mask);
+			left = tmp;
+		}
+		x = (left << perm->half_bits) | right;
+	} while (x >= perm->n);
+
+	return x;
+}
+
+/*
+ *  rand_perm_fill()
+ *	next count slots of the permutation, wrapping at n
+ */
+void rand_perm_fill(rand_perm_t *perm, uint64_t *out, const uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = rand_perm_map(perm, perm->next);
+		if (++perm->next == perm->n)
+			perm->next = 0;
+	}
+}
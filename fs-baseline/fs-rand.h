@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_RAND_H__
+#define __FS_RAND_H__
+
+#include <stdint.h>
+
+/*
+ *  xoshiro256** 64 bit generator, each worker gets its own
+ *  non-overlapping stream by jumping 2^128 steps per instance
+ */
+typedef struct {
+	uint64_t	s[4];
+} rand_state_t;
+
+typedef enum {
+	RAND_DIST_UNIFORM = 0,
+	RAND_DIST_ZIPF,		/* zipf:theta */
+	RAND_DIST_PARETO,	/* pareto:h */
+	RAND_DIST_NORMAL,	/* normal:stddev% around a centre moving each pass */
+	RAND_DIST_PERMUTE,	/* Every slot exactly once per pass */
+} rand_dist_type_t;
+
+#define RAND_PERM_ROUNDS	(4)
+
+/*
+ *  Keyed bijection over [0, n), a balanced Feistel network
+ *  over the smallest even bit width covering n, cycle walked
+ *  back into range.  O(1) state however large n is.
+ */
+typedef struct {
+	uint64_t	n;
+	uint32_t	half_bits;
+	uint64_t	half_mask;
+	uint64_t	keys[RAND_PERM_ROUNDS];
+	uint64_t	next;		/* Next index to map */
+} rand_perm_t;
+
+/*
+ *  Random offset distribution over n slots, the
+ *  precomputed values are shared by all workers
+ */
+typedef struct io_dist_t {
+	rand_dist_type_t type;
+	double		param;		/* theta, h or stddev % */
+	uint64_t	n;		/* Number of slots */
+	double		zetan;		/* zipf, theta < 1 */
+	double		zeta2;
+	double		alpha;
+	double		eta;
+	double		hx1;		/* zipf, theta >= 1 */
+	double		hxn;
+	double		squeeze;
+	double		pareto_pow;	/* pareto */
+	double		sigma;		/* normal, in slots */
+	uint64_t	scatter_mul;	/* zipf and pareto, coprime to n */
+	uint64_t	scatter_add;
+} io_dist_t;
+
+static inline uint64_t rand_rotl(const uint64_t x, const int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/*
+ *  rand_splitmix64()
+ *	step a splitmix64 sequence, used to expand seeds
+ */
+static inline uint64_t rand_splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rand_u64(rand_state_t *r)
+{
+	const uint64_t result = rand_rotl(r->s[1] * 5, 7) * 9;
+	const uint64_t t = r->s[1] << 17;
+
+	r->s[2] ^= r->s[0];
+	r->s[3] ^= r->s[1];
+	r->s[1] ^= r->s[2];
+	r->s[0] ^= r->s[3];
+	r->s[2] ^= t;
+	r->s[3] = rand_rotl(r->s[3], 45);
+
+	return result;
+}
+
+/*
+ *  rand_bounded()
+ *	unbiased value in [0, n) using Lemire's multiply
+ *	and reject, almost never needs a second draw
+ */
+static inline uint64_t rand_bounded(rand_state_t *r, const uint64_t n)
+{
+	unsigned __int128 m = (unsigned __int128)rand_u64(r) * n;
+	uint64_t low = (uint64_t)m;
+
+	if (low < n) {
+		const uint64_t threshold = -n % n;
+
+		while (low < threshold) {
+			m = (unsigned __int128)rand_u64(r) * n;
+			low = (uint64_t)m;
+		}
+	}
+	return (uint64_t)(m >> 64);
+}
+
+/*
+ *  rand_double()
+ *	uniform double in [0, 1) from the top 53 bits
+ */
+static inline double rand_double(rand_state_t *r)
+{
+	return (double)(rand_u64(r) >> 11) * 0x1.0p-53;
+}
+
+extern void rand_seed(rand_state_t *r, const uint64_t seed, const uint32_t stream);
+extern int rand_dist_parse(const char *str, io_dist_t *dist);
+extern void rand_dist_init(io_dist_t *dist, const uint64_t n);
+extern const char *rand_dist_name(const io_dist_t *dist);
+extern void rand_dist_fill(const io_dist_t *dist, rand_state_t *r,
+	const uint64_t centre, uint64_t *out, const uint32_t count);
+extern void rand_perm_init(rand_perm_t *perm, const uint64_t n, rand_state_t *r);
+extern void rand_perm_fill(rand_perm_t *perm, uint64_t *out, const uint32_t count);
+
+#endif
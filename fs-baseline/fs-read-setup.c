@@ -18,64 +18,394 @@
  * Author Colin Ian King,  colin.king@canonical.com
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/xattr.h>
 #include <fcntl.h>
+#include <linux/fs.h>
 
 #include "fs-test.h"
+#include "fs-rand.h"
+#include "fs-verify.h"
+#include "fs-data.h"
+#include "fs-read-setup.h"
 
-int read_init(test_context_t *test)
+#define SETUP_BUF_SIZE		(1024 * 1024)		/* Per write */
+#define SETUP_SLICE		(64ULL * 1024 * 1024)	/* Handed to each writer in turn */
+#define SETUP_MAX_THREADS	(8)
+#define SETUP_MAGIC		(0x53445346)		/* "FSDS" */
+#define SETUP_XATTR		"user.fs-test.layout"
+
+/*
+ *  What a laid out file holds.  It is kept in an xattr on
+ *  the file so a later round or run can tell whether the
+ *  file can be used again without writing it
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	verify_unit;	/* 0 for no block headers */
+	uint64_t	size;
+	uint64_t	seed;
+	uint32_t	data_mode;
+	uint32_t	data_dedupe;
+	double		data_compress;
+} setup_key_t;
+
+/* A layout shared by its writer threads */
+typedef struct {
+	const test_context_t *test;
+	const setup_key_t *key;
+	int		fd;
+	uint64_t	next;		/* Start of the next free slice */
+	volatile bool	failed;
+} setup_state_t;
+
+typedef struct {
+	setup_state_t	*state;
+	pthread_t	thread;
+	int		ret;
+} setup_writer_t;
+
+/*
+ *  setup_key()
+ *	describe the layout a test needs
+ */
+static void setup_key(setup_key_t *key, const test_context_t *test, const uint64_t size)
 {
-	int fd, rc = 0;
+	memset(key, 0, sizeof(*key));
+	key->magic = SETUP_MAGIC;
+	key->verify_unit = test->verify ? verify_unit(test) : 0;
+	key->size = size;
+	key->seed = test->randseed;
+	key->data_mode = (uint32_t)test->data_mode;
+	key->data_dedupe = test->data_dedupe;
+	key->data_compress = test->data_compress;
+}
+
+/*
+ *  read_setup_name()
+ *	name a kept layout after what it holds, so any run
+ *	needing the same layout finds it
+ */
+void read_setup_name(const test_context_t *test, const uint64_t size, char *buf, const size_t len)
+{
+	setup_key_t key;
+	uint64_t words[sizeof(key) / sizeof(uint64_t)], hash = 0, x;
+	size_t i;
+
+	setup_key(&key, test, size);
+	memcpy(words, &key, sizeof(words));
+	for (i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		x = hash ^ words[i];
+		hash = rand_splitmix64(&x);
+	}
+	snprintf(buf, len, "%s/fs-test-layout-%016" PRIx64, test->pathname, hash);
+}
+
+/*
+ *  setup_fill()
+ *	generate the layout of len bytes at offset into buf,
+ *	which holds the constant fill when the data is not
+ *	generated.  offset must be a multiple of DATA_CHUNK
+ */
+static void setup_fill(
+	const setup_key_t *key,
+	data_gen_t *gen,
+	void *buf,
+	const uint64_t offset,
+	const size_t len)
+{
+	if (gen->active) {
+		data_gen_seek(gen, offset);
+		data_fill(gen, buf, len);
+	}
+	/* Verified readers expect every block to carry a header */
+	if (key->verify_unit)
+		verify_fill(buf, len, (off_t)offset, key->verify_unit, VERIFY_SETUP, 0, key->seed);
+}
+
+/*
+ *  setup_writer()
+ *	lay out slices of the file until none are left
+ */
+static void *setup_writer(void *arg)
+{
+	setup_writer_t *w = (setup_writer_t *)arg;
+	setup_state_t *s = w->state;
+	const uint64_t size = s->key->size;
+	data_gen_t gen;
 	void *buffer;
-	uint64_t fs = test->file_size;
 
-#define BUF_SIZE	(128 * 1024)
+	if (posix_memalign(&buffer, 4096, SETUP_BUF_SIZE) != 0) {
+		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
+			errno, strerror(errno));
+		w->ret = -ENOMEM;
+		s->failed = true;
+		return NULL;
+	}
+	memset(buffer, 0xff, SETUP_BUF_SIZE);
+	data_gen_init(&gen, s->test, true);
+
+	while ((opt_flags & OPT_CONT) && !s->failed) {
+		const uint64_t slice = __atomic_fetch_add(&s->next, SETUP_SLICE, __ATOMIC_RELAXED);
+		const uint64_t end = (size - slice > SETUP_SLICE) ? slice + SETUP_SLICE : size;
+		uint64_t offset;
+
+		if (slice >= size)
+			break;
+		for (offset = slice; offset < end; offset += SETUP_BUF_SIZE) {
+			const size_t sz = (end - offset > SETUP_BUF_SIZE) ? SETUP_BUF_SIZE : end - offset;
+			ssize_t n;
+
+			if (!(opt_flags & OPT_CONT) || s->failed)
+				break;
+			setup_fill(s->key, &gen, buffer, offset, sz);
+			n = pwrite(s->fd, buffer, sz, (off_t)offset);
+			if (n < 0) {
+				fprintf(stderr, "Write failed: %d %s\n",
+					errno, strerror(errno));
+				w->ret = -errno;
+				s->failed = true;
+				break;
+			}
+			if ((size_t)n != sz) {
+				fprintf(stderr, "Short write laying out file\n");
+				w->ret = -EIO;
+				s->failed = true;
+				break;
+			}
+		}
+	}
+	free(buffer);
+
+	return NULL;
+}
+
+/*
+ *  setup_layout()
+ *	write the file from scratch.  Space is fallocated up
+ *	front and slices are written by up to SETUP_MAX_THREADS
+ *	threads with large O_DIRECT writes where the size allows
+ */
+static int setup_layout(const test_context_t *test, const char *filename, const setup_key_t *key)
+{
+	setup_writer_t writers[SETUP_MAX_THREADS];
+	setup_state_t state;
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t slices = (key->size + SETUP_SLICE - 1) / SETUP_SLICE;
+	uint32_t i, nthreads = SETUP_MAX_THREADS;
+	bool direct = (key->size % 4096) == 0;
+	int fd, rc = 0;
 
 	/* Start off with clean already existing file */
-	(void)unlink(test->filename);
-	fd = open(test->filename, O_WRONLY | O_CREAT,  S_IRUSR | S_IWUSR);
+	(void)unlink(filename);
+	fd = open(filename, O_WRONLY | O_CREAT | (direct ? O_DIRECT : 0), S_IRUSR | S_IWUSR);
+	if ((fd < 0) && direct && (errno == EINVAL)) {
+		direct = false;
+		fd = open(filename, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	}
 	if (fd < 0) {
 		fprintf(stderr, "Cannot open for writing: %s: %d %s\n",
-			test->filename, errno, strerror(errno));
+			filename, errno, strerror(errno));
 		return -errno;
 	}
-	if (posix_memalign(&buffer, 4096, BUF_SIZE) < 0) {
-		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
-			errno, strerror(errno));
-		close(fd);
-		return -ENOMEM;
+	if (key->size && (fallocate(fd, 0, 0, (off_t)key->size) < 0) &&
+	    (errno != EOPNOTSUPP) && (errno != ENOSYS)) {
+		fprintf(stderr, "Cannot allocate %" PRIu64 " bytes: %s: %d %s\n",
+			key->size, filename, errno, strerror(errno));
+		(void)close(fd);
+		return -errno;
 	}
 
-	memset(buffer, 0xff, BUF_SIZE);
+	memset(&state, 0, sizeof(state));
+	state.test = test;
+	state.key = key;
+	state.fd = fd;
 
-	while ((opt_flags & OPT_CONT) && (fs != 0)) {
-		size_t sz = fs > BUF_SIZE ? BUF_SIZE : fs;
-		ssize_t n = write(fd, buffer, sz);
-		if (n < 0) {
-			fprintf(stderr, "Write failed: %d %s\n",
-				errno, strerror(errno));
-			rc = -errno;
+	if ((cpus > 0) && ((uint32_t)cpus < nthreads))
+		nthreads = (uint32_t)cpus;
+	if (slices < nthreads)
+		nthreads = slices ? (uint32_t)slices : 1;
+	memset(writers, 0, sizeof(writers));
+	for (i = 0; i < nthreads; i++)
+		writers[i].state = &state;
+	/* This thread is writer 0 and picks up the slack of any that fail to start */
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&writers[i].thread, NULL, setup_writer, &writers[i]))
 			break;
-		}
-		fs -= n;
 	}
+	nthreads = i;
+	(void)setup_writer(&writers[0]);
+	for (i = 1; i < nthreads; i++)
+		(void)pthread_join(writers[i].thread, NULL);
+	for (i = 0; i < nthreads; i++) {
+		if (writers[i].ret && (rc == 0))
+			rc = writers[i].ret;
+	}
+	if ((rc == 0) && !(opt_flags & OPT_CONT))
+		rc = -EINTR;
+
+	/*
+	 *  Dirty setup pages written back under a later O_DIRECT
+	 *  write can land over it, so get the layout onto disk first
+	 */
+	if ((rc == 0) && key->verify_unit && !direct && (fdatasync(fd) < 0)) {
+		fprintf(stderr, "Cannot sync: %s: %d %s\n",
+			filename, errno, strerror(errno));
+		rc = -errno;
+	}
+	/* Without xattrs the file still works, it just is not reused */
+	if (rc == 0)
+		(void)fsetxattr(fd, SETUP_XATTR, key, sizeof(*key), 0);
 
 	(void)close(fd);
-	free(buffer);
 
 	return rc;
+}
+
+/*
+ *  setup_match()
+ *	check a file holds the layout, going by its size and
+ *	xattr and then the contents of its first and last chunk
+ */
+static bool setup_match(const test_context_t *test, const char *filename, const setup_key_t *key)
+{
+	uint8_t have[DATA_CHUNK], want[DATA_CHUNK];
+	const uint64_t offsets[2] = {
+		0, key->size ? ((key->size - 1) / DATA_CHUNK) * DATA_CHUNK : 0
+	};
+	setup_key_t stored;
+	data_gen_t gen;
+	struct stat statbuf;
+	bool match = false;
+	int fd;
+	size_t i;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+	if ((fstat(fd, &statbuf) < 0) || ((uint64_t)statbuf.st_size != key->size))
+		goto out;
+	if ((fgetxattr(fd, SETUP_XATTR, &stored, sizeof(stored)) != sizeof(stored)) ||
+	    memcmp(&stored, key, sizeof(stored)))
+		goto out;
+
+	data_gen_init(&gen, test, true);
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+		const size_t len = (key->size - offsets[i] > DATA_CHUNK) ?
+			DATA_CHUNK : (size_t)(key->size - offsets[i]);
+
+		memset(want, 0xff, len);
+		setup_fill(key, &gen, want, offsets[i], len);
+		if ((pread(fd, have, len, (off_t)offsets[i]) != (ssize_t)len) ||
+		    memcmp(have, want, len))
+			goto out;
+	}
+	match = true;
+out:
+	(void)close(fd);
+
+	return match;
+}
+
+/*
+ *  setup_clone()
+ *	make filename a copy of a kept layout, sharing its
+ *	extents where the filesystem can reflink and otherwise
+ *	letting the kernel copy it.  -EOPNOTSUPP when neither
+ *	works here
+ */
+static int setup_clone(const char *template, const char *filename, const uint64_t size)
+{
+	int in, out, rc = 0;
+	uint64_t done = 0;
+
+	in = open(template, O_RDONLY);
+	if (in < 0) {
+		fprintf(stderr, "Cannot open for reading: %s: %d %s\n",
+			template, errno, strerror(errno));
+		return -errno;
+	}
+	(void)unlink(filename);
+	out = open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (out < 0) {
+		fprintf(stderr, "Cannot open for writing: %s: %d %s\n",
+			filename, errno, strerror(errno));
+		(void)close(in);
+		return -errno;
+	}
+	if (ioctl(out, FICLONE, in) == 0)
+		goto out;
+
+	while ((opt_flags & OPT_CONT) && (done < size)) {
+		const ssize_t n = copy_file_range(in, NULL, out, NULL, (size_t)(size - done), 0);
+
+		if (n <= 0) {
+			if ((n < 0) && (done == 0) &&
+			    ((errno == EXDEV) || (errno == EOPNOTSUPP) ||
+			     (errno == ENOSYS) || (errno == EINVAL))) {
+				rc = -EOPNOTSUPP;
+			} else {
+				fprintf(stderr, "Cannot copy %s to %s: %d %s\n",
+					template, filename, errno, strerror(errno));
+				rc = n < 0 ? -errno : -EIO;
+			}
+			break;
+		}
+		done += (uint64_t)n;
+	}
+	if ((rc == 0) && !(opt_flags & OPT_CONT))
+		rc = -EINTR;
+out:
+	(void)close(out);
+	(void)close(in);
+
+	return rc;
+}
 
-#undef BUF_SIZE
+/*
+ *  read_init()
+ *	lay out the file read tests run on.  A file only read
+ *	is used again while it still matches, a file tests
+ *	write is cloned from a kept layout when there is one
+ */
+int read_init(test_context_t *test)
+{
+	setup_key_t key;
+	int rc;
+
+	setup_key(&key, test, test->file_size);
+	if (test->setup_reuse && setup_match(test, test->filename, &key))
+		return 0;
+	if (test->setup_template) {
+		if (!setup_match(test, test->setup_template, &key)) {
+			rc = setup_layout(test, test->setup_template, &key);
+			if (rc < 0)
+				return rc;
+		}
+		rc = setup_clone(test->setup_template, test->filename, key.size);
+		if (rc != -EOPNOTSUPP)
+			return rc;
+	}
+	return setup_layout(test, test->filename, &key);
 }
 
 int read_deinit(test_context_t *test)
 {
-	(void)unlink(test->filename);
+	/* Reused files are removed once all rounds are done */
+	if (!test->setup_reuse)
+		(void)unlink(test->filename);
 	return 0;
 }
@@ -21,9 +21,14 @@
 #ifndef __FS_READ_SETUP_H__
 #define __FS_READ_SETUP_H__
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include "fs-test.h"
 
 extern int read_init(test_context_t *test);
 extern int read_deinit(test_context_t *test);
+extern void read_setup_name(const test_context_t *test, const uint64_t size,
+	char *buf, const size_t len);
 
 #endif
@@ -31,10 +31,12 @@
 #include <signal.h>
 #include <errno.h>
 #include <ctype.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <math.h>
 
 #include "fs-test.h"
@@ -47,17 +49,87 @@
 #include "fs-read-seq.h"
 #include "fs-read-rnd.h"
 #include "fs-read-write-rnd.h"
+#include "fs-read-write-seq.h"
 #include "fs-noop.h"
+#include "fs-meta.h"
+#include "fs-fsync.h"
+#include "fs-db.h"
+#include "fs-verify.h"
+#include "fs-data.h"
+#include "fs-cache.h"
+#include "fs-hot.h"
 #include "fs-dump-results.h"
+#include "fs-io.h"
+#include "fs-io-mmap.h"
+#include "fs-io-pvsync2.h"
+#include "fs-interval-log.h"
+#include "fs-pool.h"
+#include "fs-affinity.h"
+#include "fs-rand.h"
+#include "fs-job.h"
+#include "fs-fio-job.h"
 
 #define TEST_NAME		"write-test"
 
-#define MAX_THREADS		99
+#define MAX_THREADS		4096
+#define MAX_IODEPTH		4096
+#define MAX_VEC_BLOCKS		1024
+
+/* Long only options */
+#define OPT_LONG_IODEPTH	(256)
+#define OPT_LONG_IODEPTH_BATCH	(257)
+#define OPT_LONG_FIXEDBUFS	(258)
+#define OPT_LONG_REGISTERFILES	(259)
+#define OPT_LONG_SQPOLL		(260)
+#define OPT_LONG_IODEPTH_BATCH_COMPLETE	(261)
+#define OPT_LONG_MMAP_POPULATE	(262)
+#define OPT_LONG_MADVISE	(263)
+#define OPT_LONG_MSYNC		(264)
+#define OPT_LONG_VEC_BLOCKS	(265)
+#define OPT_LONG_RWF		(266)
+#define OPT_LONG_LOG_AVG_MSEC	(267)
+#define OPT_LONG_LOG		(268)
+#define OPT_LONG_CLOCK		(269)
+#define OPT_LONG_STOP		(270)
+#define OPT_LONG_AFFINITY	(271)
+#define OPT_LONG_RWMIXREAD	(272)
+#define OPT_LONG_BSSPLIT	(273)
+#define OPT_LONG_RANDOM_DIST	(274)
+#define OPT_LONG_RANDSEED	(275)
+#define OPT_LONG_RUNTIME	(276)
+#define OPT_LONG_TIME_BASED	(277)
+#define OPT_LONG_RATE_IOPS	(278)
+#define OPT_LONG_RATE		(279)
+#define OPT_LONG_THINKTIME	(280)
+#define OPT_LONG_THINKTIME_BLOCKS	(281)
+#define OPT_LONG_JOB		(282)
+#define OPT_LONG_FIO_JOB	(283)
+#define OPT_LONG_META_FANOUT	(284)
+#define OPT_LONG_META_DEPTH	(285)
+#define OPT_LONG_META_DIRS	(286)
+#define OPT_LONG_META_OPS	(287)
+#define OPT_LONG_FSYNC_METHODS	(288)
+#define OPT_LONG_FSYNC_SIZES	(289)
+#define OPT_LONG_DB_CHECKPOINT	(290)
+#define OPT_LONG_DB_TXN_READS	(291)
+#define OPT_LONG_VERIFY		(292)
+#define OPT_LONG_DATA		(293)
+#define OPT_LONG_COMPRESS_RATIO	(294)
+#define OPT_LONG_DEDUPE		(295)
+#define OPT_LONG_KEEP_LAYOUTS	(296)
+#define OPT_LONG_CACHE		(297)
+#define OPT_LONG_HOT_SWEEP	(298)
 
 const stat_table_t stat_table[] = {
 	{ STAT_DURATION,	"Duration",		"secs",		1.0,	false,	false },
 	{ STAT_RATE,		"Rate",			"MB/sec", 1048576.0, 	false,	false },
 	{ STAT_OP_RATE,		"Op-Rate",		"Ops/sec",	1.0, 	false,	false },
+	{ STAT_READ_RATE,	"Read Rate",		"MB/sec", 1048576.0, 	false,	false },
+	{ STAT_READ_OP_RATE,	"Read Op-Rate",		"Ops/sec",	1.0, 	false,	false },
+	{ STAT_WRITE_RATE,	"Write Rate",		"MB/sec", 1048576.0, 	false,	false },
+	{ STAT_WRITE_OP_RATE,	"Write Op-Rate",	"Ops/sec",	1.0, 	false,	false },
+	{ STAT_START_SKEW,	"Start Skew",		"us",	     1000.0,	false,	false },
+	{ STAT_FINISH_SKEW,	"Finish Skew",		"us",	     1000.0,	false,	false },
 	{ STAT_NULL,		"",			"",		1.0,	false,	false },
 
 	{ STAT_PID_UTIME,	"CPU user %",		NULL,		1.0,	true,	false },
@@ -65,6 +137,10 @@ const stat_table_t stat_table[] = {
 	{ STAT_PID_TTIME,	"CPU total %",		NULL,		1.0,	true,	false },
 	{ STAT_NULL,		"",			"",		1.0,	false,	false },
 
+	{ STAT_PID_MINFLT,	"Minor Page Faults",	NULL,		1.0,	true,	false },
+	{ STAT_PID_MAJFLT,	"Major Page Faults",	NULL,		1.0,	true,	false },
+	{ STAT_NULL,		"",			"",		1.0,	false,	false },
+
 	{ STAT_READS_COMPLETED,	"Reads Completed",	NULL,		1.0,	true,	false },
 	{ STAT_READS_MERGED,	"Reads Merged",		NULL,		1.0,	true,	false },
 	{ STAT_SECTORS_READ,	"Sectors Read",		NULL,		1.0,	true,	false },
@@ -85,6 +161,18 @@ const stat_table_t stat_table[] = {
 	{ STAT_NULL,		"",			"",		1.0,	false,	false },
 
 	{ STAT_RESPONSE_TIME,	"Response Time",	"us",	     0.001,	true,	false },
+	{ STAT_LAT_P50,		"Latency p50",		"us",	     1000.0,	false,	false },
+	{ STAT_LAT_P99,		"Latency p99",		"us",	     1000.0,	false,	false },
+	{ STAT_LAT_P999,	"Latency p99.9",	"us",	     1000.0,	false,	false },
+	{ STAT_LAT_MAX,		"Latency Max",		"us",	     1000.0,	false,	false },
+	{ STAT_READ_LAT_P50,	"Read Latency p50",	"us",	     1000.0,	false,	false },
+	{ STAT_READ_LAT_P99,	"Read Latency p99",	"us",	     1000.0,	false,	false },
+	{ STAT_READ_LAT_P999,	"Read Latency p99.9",	"us",	     1000.0,	false,	false },
+	{ STAT_READ_LAT_MAX,	"Read Latency Max",	"us",	     1000.0,	false,	false },
+	{ STAT_WRITE_LAT_P50,	"Write Latency p50",	"us",	     1000.0,	false,	false },
+	{ STAT_WRITE_LAT_P99,	"Write Latency p99",	"us",	     1000.0,	false,	false },
+	{ STAT_WRITE_LAT_P999,	"Write Latency p99.9",	"us",	     1000.0,	false,	false },
+	{ STAT_WRITE_LAT_MAX,	"Write Latency Max",	"us",	     1000.0,	false,	false },
 	{ STAT_IO_IN_PROGRESS,	"IO In Progress",	NULL,		1.0,	true,	true },
 	{ STAT_IO_TIME_SPENT_MS, "IO Time Spent",	"ms",		1.0,	true,	false },
 	{ STAT_IO_TIME_SPENT_WEIGHTED_MS, "IO Time Spent (Weighted)", "ms",	1.0,	true,	true },
@@ -105,6 +193,8 @@ const stat_table_t stat_table[] = {
 	{ STAT_MEM_CACHED,	"Memory Cached",	"MB",        1024.0,	false,	false },
 	{ STAT_MEM_DIRTY,	"Memory Dirty",		"MB",	     1024.0,	false,	false },
 	{ STAT_MEM_WRITEBACK,	"Memory Writeback",	"MB",	     1024.0,	false,	false },
+	{ STAT_CACHE_START,	"Files Cached at Start %", NULL,	1.0,	false,	false },
+	{ STAT_CACHE_END,	"Files Cached at End %", NULL,		1.0,	false,	false },
 
 	{ STAT_MAX_VAL,		NULL,			NULL,		1.0,	false,	false }
 };
@@ -115,8 +205,12 @@ static test_info_t test_info[] = {
 	{ "Read",	read_seq,	read_init,	read_deinit,	"rd_seq",	"Read Sequential" },
 	{ "Read",	read_rnd,	read_init,	read_deinit,	"rd_rnd",	"Read Random" },
 	{ "Rd+Wr",	read_write_rnd,	read_init,	read_deinit,	"rdwr_rnd",	"Read+Write Random" },
+	{ "Rd+Wr",	read_write_seq,	read_init,	read_deinit,	"rdwr_seq",	"Read+Write Sequential" },
 	{ "Rewrite",	rewrite_seq,	write_init,	write_deinit,	"rewr_seq",	"Rewrite Sequentual" },
 	{ "WrMany",	write_many,	NULL,		NULL,		"wr_many",	"Write Many" },
+	{ "Meta",	meta,		meta_init,	meta_deinit,	"meta",		"Metadata Create/Stat/Readdir/Rename/Unlink" },
+	{ "Commit",	fsync_test,	NULL,		NULL,		"fsync",	"Fsync Method Comparison" },
+	{ "Txn",	db,		db_init,	db_deinit,	"db",		"Database WAL/Page Read/Checkpoint" },
 	{ "Noop",	noop,		NULL,		NULL,		"noop",		"No I/O ops" },
 	{ NULL,		NULL,		NULL,		NULL,		NULL,		NULL }
 };
@@ -127,7 +221,65 @@ typedef struct {
 } scale_t;
 
 unsigned int opt_flags = OPT_CONT;
+test_stop_t test_stop;
 static char *opt_ofilename = NULL;
+static char *opt_log_filename = NULL;
+static uint32_t opt_log_avg_msec = 500;
+static int opt_clock = TIME_CLOCK_RAW;
+static int opt_stop = POOL_STOP_LAST;
+static char *opt_affinity = NULL;
+static uint64_t opt_runtime_ns = 0;
+static int opt_cache = CACHE_EVICT;
+static uint32_t opt_hot[HOT_MAX_STEPS];
+static uint32_t opt_hot_n = 0;
+
+static const struct option long_options[] = {
+	{ "ioengine",		required_argument,	NULL,	'e' },
+	{ "iodepth",		required_argument,	NULL,	OPT_LONG_IODEPTH },
+	{ "iodepth-batch",	required_argument,	NULL,	OPT_LONG_IODEPTH_BATCH },
+	{ "iodepth-batch-complete", required_argument,	NULL,	OPT_LONG_IODEPTH_BATCH_COMPLETE },
+	{ "fixedbufs",		no_argument,		NULL,	OPT_LONG_FIXEDBUFS },
+	{ "registerfiles",	no_argument,		NULL,	OPT_LONG_REGISTERFILES },
+	{ "sqpoll",		no_argument,		NULL,	OPT_LONG_SQPOLL },
+	{ "mmap-populate",	no_argument,		NULL,	OPT_LONG_MMAP_POPULATE },
+	{ "madvise",		required_argument,	NULL,	OPT_LONG_MADVISE },
+	{ "msync",		required_argument,	NULL,	OPT_LONG_MSYNC },
+	{ "vec-blocks",		required_argument,	NULL,	OPT_LONG_VEC_BLOCKS },
+	{ "rwf",		required_argument,	NULL,	OPT_LONG_RWF },
+	{ "log-avg-msec",	required_argument,	NULL,	OPT_LONG_LOG_AVG_MSEC },
+	{ "log",		required_argument,	NULL,	OPT_LONG_LOG },
+	{ "clock",		required_argument,	NULL,	OPT_LONG_CLOCK },
+	{ "stop",		required_argument,	NULL,	OPT_LONG_STOP },
+	{ "affinity",		required_argument,	NULL,	OPT_LONG_AFFINITY },
+	{ "rwmixread",		required_argument,	NULL,	OPT_LONG_RWMIXREAD },
+	{ "bssplit",		required_argument,	NULL,	OPT_LONG_BSSPLIT },
+	{ "random-distribution", required_argument,	NULL,	OPT_LONG_RANDOM_DIST },
+	{ "randseed",		required_argument,	NULL,	OPT_LONG_RANDSEED },
+	{ "runtime",		required_argument,	NULL,	OPT_LONG_RUNTIME },
+	{ "time-based",		no_argument,		NULL,	OPT_LONG_TIME_BASED },
+	{ "rate-iops",		required_argument,	NULL,	OPT_LONG_RATE_IOPS },
+	{ "rate",		required_argument,	NULL,	OPT_LONG_RATE },
+	{ "thinktime",		required_argument,	NULL,	OPT_LONG_THINKTIME },
+	{ "thinktime-blocks",	required_argument,	NULL,	OPT_LONG_THINKTIME_BLOCKS },
+	{ "job",		required_argument,	NULL,	OPT_LONG_JOB },
+	{ "fio-job",		required_argument,	NULL,	OPT_LONG_FIO_JOB },
+	{ "meta-fanout",	required_argument,	NULL,	OPT_LONG_META_FANOUT },
+	{ "meta-depth",		required_argument,	NULL,	OPT_LONG_META_DEPTH },
+	{ "meta-dirs",		required_argument,	NULL,	OPT_LONG_META_DIRS },
+	{ "meta-ops",		required_argument,	NULL,	OPT_LONG_META_OPS },
+	{ "fsync-methods",	required_argument,	NULL,	OPT_LONG_FSYNC_METHODS },
+	{ "fsync-sizes",	required_argument,	NULL,	OPT_LONG_FSYNC_SIZES },
+	{ "db-checkpoint",	required_argument,	NULL,	OPT_LONG_DB_CHECKPOINT },
+	{ "db-txn-reads",	required_argument,	NULL,	OPT_LONG_DB_TXN_READS },
+	{ "verify",		no_argument,		NULL,	OPT_LONG_VERIFY },
+	{ "data",		required_argument,	NULL,	OPT_LONG_DATA },
+	{ "compress-ratio",	required_argument,	NULL,	OPT_LONG_COMPRESS_RATIO },
+	{ "dedupe",		required_argument,	NULL,	OPT_LONG_DEDUPE },
+	{ "keep-layouts",	no_argument,		NULL,	OPT_LONG_KEEP_LAYOUTS },
+	{ "cache",		required_argument,	NULL,	OPT_LONG_CACHE },
+	{ "hot-sweep",		required_argument,	NULL,	OPT_LONG_HOT_SWEEP },
+	{ NULL,			0,			NULL,	0 }
+};
 
 static void init_stats(stat_t *stat_vals)
 {
@@ -155,12 +307,12 @@ static int read_diskstats(const char *path, stat_t *stat_vals)
 
 	while (!feof(fp)) {
 		char fbuf[4096];
-		unsigned int major, minor;
+		unsigned int dev_major, dev_minor;
 
 		fgets(fbuf, sizeof(fbuf), fp);
-		sscanf(fbuf, "%u %u", &major, &minor);
-		if (major == major(buf.st_dev) &&
-		    minor == minor(buf.st_dev)) {
+		sscanf(fbuf, "%u %u", &dev_major, &dev_minor);
+		if (dev_major == major(buf.st_dev) &&
+		    dev_minor == minor(buf.st_dev)) {
 			sscanf(fbuf, "%*d %*d %*s"
 				" %lf %lf %lf %lf %lf"
 				" %lf %lf %lf %lf %lf",
@@ -295,7 +447,7 @@ static int read_pid_proc_stat(stat_t *stat_vals)
 {
 	char path[PATH_MAX];
 	char comm[20];
-	unsigned long utime, stime, clock_ticks;
+	unsigned long utime, stime, minflt, majflt, clock_ticks;
 	FILE *fp;
 
 	clock_ticks = sysconf(_SC_CLK_TCK);
@@ -305,11 +457,13 @@ static int read_pid_proc_stat(stat_t *stat_vals)
 		return -1;
 	}
 	if (fscanf(fp, "%*d (%20[^)]) %*c %*d %*d %*d %*d "
-		       "%*d %*u %*u %*u %*u %*u %16lu %16lu",
-                        comm, &utime, &stime) == 3) {
+		       "%*d %*u %16lu %*u %16lu %*u %16lu %16lu",
+                        comm, &minflt, &majflt, &utime, &stime) == 5) {
 		stat_vals->val[STAT_PID_UTIME] = (double)(100.0 * utime) / clock_ticks;
 		stat_vals->val[STAT_PID_STIME] = (double)(100.0 * stime) / clock_ticks;
 		stat_vals->val[STAT_PID_TTIME] = (double)(100.0 * (stime + utime)) / clock_ticks;
+		stat_vals->val[STAT_PID_MINFLT] = (double)minflt;
+		stat_vals->val[STAT_PID_MAJFLT] = (double)majflt;
 	}
 	fclose(fp);
 
@@ -460,7 +614,7 @@ static char *size_to_str(const double val, const char *fmt, char *buf, size_t le
  *  count_bits()
  *	count bits set, from C Programming Language 2nd Ed
  */
-static unsigned int count_bits(const unsigned int val)
+unsigned int count_bits(const unsigned int val)
 {
 	register unsigned int c, n = val;
 
@@ -474,7 +628,7 @@ static unsigned int count_bits(const unsigned int val)
  *  get_u64
  *	get a u64
  */
-static uint64_t get_u64(const char *const str)
+uint64_t get_u64(const char *const str)
 {
 	uint64_t val;
 
@@ -487,7 +641,7 @@ static uint64_t get_u64(const char *const str)
 	return val;
 }
 
-static uint32_t get_u32(const char *const str)
+uint32_t get_u32(const char *const str)
 {
 	uint32_t val;
 
@@ -539,7 +693,7 @@ static uint64_t get_u64_scale(
  *  get_u64_byte()
  *	size in bytes, K bytes, M bytes or G bytes
  */
-static uint64_t get_u64_byte(const char *const str)
+uint64_t get_u64_byte(const char *const str)
 {
 	static const scale_t scales[] = {
 		{ 'b', 	1 },
@@ -592,6 +746,114 @@ void calculate_stats(
 	}
 }
 
+/*
+ *  latency_stats()
+ *	percentiles of a merged latency histogram, in ns, into
+ *	the p50, p99, p99.9 and max stats starting at first
+ */
+static void latency_stats(const histogram_t *hist, stat_t *stat_vals, const stat_val_t first)
+{
+	stat_vals->val[first + 0] = (double)histogram_percentile(hist, 50.0);
+	stat_vals->val[first + 1] = (double)histogram_percentile(hist, 99.0);
+	stat_vals->val[first + 2] = (double)histogram_percentile(hist, 99.9);
+	stat_vals->val[first + 3] = (double)hist->max_ns;
+}
+
+/*
+ *  stat_dir_hidden()
+ *	per direction rows only say something new when
+ *	both reads and writes were issued
+ */
+static bool stat_dir_hidden(const stat_val_t s, const stat_t *results)
+{
+	const bool mixed = (results[STAT_MAX].val[STAT_READ_OP_RATE] > 0.0) &&
+			   (results[STAT_MAX].val[STAT_WRITE_OP_RATE] > 0.0);
+
+	if (mixed)
+		return false;
+	return (s == STAT_READ_RATE) || (s == STAT_READ_OP_RATE) ||
+	       (s == STAT_WRITE_RATE) || (s == STAT_WRITE_OP_RATE) ||
+	       ((s >= STAT_READ_LAT_P50) && (s <= STAT_WRITE_LAT_MAX));
+}
+
+/*
+ *  parse_bssplit()
+ *	parse size/pct:size/pct:... , entries without a
+ *	percentage share whatever is left of 100 equally
+ */
+void parse_bssplit(const char *str, io_bssplit_t *split)
+{
+	char *buf, *token, *saveptr = NULL;
+	uint32_t pct[MAX_BSSPLIT], i, total = 0, blanks = 0, seen = 0, cum = 0;
+
+	buf = strdup(str);
+	if (!buf) {
+		fprintf(stderr, "Out of memory parsing block size split\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(split, 0, sizeof(*split));
+	for (token = strtok_r(buf, ":", &saveptr); token;
+	     token = strtok_r(NULL, ":", &saveptr)) {
+		char *slash = strchr(token, '/');
+
+		if (split->n == MAX_BSSPLIT) {
+			fprintf(stderr, "Block size split is limited to %d entries\n", MAX_BSSPLIT);
+			exit(EXIT_FAILURE);
+		}
+		if (slash) {
+			*slash = '\0';
+			pct[split->n] = get_u32(slash + 1);
+			total += pct[split->n];
+		} else {
+			pct[split->n] = UINT32_MAX;
+			blanks++;
+		}
+		split->size[split->n] = get_u64_byte(token);
+		if (split->size[split->n] == 0) {
+			fprintf(stderr, "Block size split sizes must be non-zero\n");
+			exit(EXIT_FAILURE);
+		}
+		split->n++;
+	}
+	free(buf);
+
+	if ((split->n == 0) || (total > 100) || (!blanks && (total != 100))) {
+		fprintf(stderr, "Block size split %s must have percentages adding up to 100\n", str);
+		exit(EXIT_FAILURE);
+	}
+
+	split->min_size = split->max_size = split->size[0];
+	for (i = 0; i < split->n; i++) {
+		if (pct[i] == UINT32_MAX) {
+			/* Any rounding remainder goes to the last blank entry */
+			pct[i] = (100 - total) / blanks;
+			if (++seen == blanks)
+				pct[i] += (100 - total) % blanks;
+		}
+		cum += pct[i];
+		split->cum_pct[i] = cum;
+		if (split->size[i] < split->min_size)
+			split->min_size = split->size[i];
+		if (split->size[i] > split->max_size)
+			split->max_size = split->size[i];
+	}
+}
+
+/*
+ *  test_find()
+ *	find a test by its tag, NULL if there is none
+ */
+test_info_t *test_find(const char *tag)
+{
+	test_info_t *ti;
+
+	for (ti = test_info; ti->test; ti++) {
+		if (!strcmp(tag, ti->tag))
+			return ti;
+	}
+	return NULL;
+}
+
 static void show_tests(void)
 {
 	int i;
@@ -622,8 +884,74 @@ static void show_usage(void)
 	       "  -l\tlength, specify length of file.\n"
 	       "  -n\tblocks, specify length by number of blocks.\n"
 	       "  -p\tpathname, directory to write test file.\n"
-	       "  -S\tdump out full statistics of performance.\n");
+	       "  -S\tdump out full statistics of performance.\n"
+	       "  -e\tengine, I/O engine to use, default is sync.\n"
+	       "  --ioengine=engine\n\tsame as -e.\n"
+	       "  --iodepth=N\n\tnumber of ops kept in flight by queued engines, default is 1.\n"
+	       "  --iodepth-batch=N\n\tmaximum ops submitted per call, default is iodepth.\n"
+	       "  --iodepth-batch-complete=N\n\tminimum completions reaped per wait, default is 1.\n"
+	       "  --fixedbufs\n\tio_uring: use registered buffers.\n"
+	       "  --registerfiles\n\tio_uring: use a registered file.\n"
+	       "  --sqpoll\n\tio_uring: use a kernel submission queue polling thread.\n"
+	       "  --mmap-populate\n\tmmap: prefault the mapping with MAP_POPULATE.\n"
+	       "  --madvise=advice\n\tmmap: normal, seq, random, willneed or hugepage.\n"
+	       "  --msync=policy\n\tmmap: none, end, async or sync (per block) on writes.\n"
+	       "  --vec-blocks=N\n\tpvsync2: contiguous blocks per call, default is 1.\n"
+	       "  --rwf=flags\n\tpvsync2: comma list of hipri, nowait, dsync, uncached.\n"
+	       "  --log=file\n\tlog throughput, latency and dirty memory per interval.\n"
+	       "  --log-avg-msec=N\n\tinterval log period in milliseconds, default is 500.\n"
+	       "  --clock=source\n\ttiming clock, raw (CLOCK_MONOTONIC_RAW, default) or tsc.\n"
+	       "  --cache=evict|drop|keep\n\tbefore each round sync and evict just the test files from the page\n"
+	       "\tcache (default), drop all caches (needs root) or leave the cache as it is.\n"
+	       "  --hot-sweep=N,N,...\n\trd_seq or rd_rnd: warm the file into the page cache and read it with\n"
+	       "\teach ascending thread count in turn, next to a memcpy() baseline.\n"
+	       "  --stop=first|last\n\tend each round when the first or last (default) worker finishes.\n"
+	       "  --affinity=policy\n\tpin workers: compact, scatter, node (device's NUMA node) or a cpu list.\n"
+	       "  --rwmixread=N\n\tpercentage of reads in mixed read/write tests, default is 50.\n"
+	       "  --bssplit=size/pct:...\n\tweighted op sizes, e.g. 4k/50:16k/30:64k/20, blank pcts share the rest.\n"
+	       "  --random-distribution=dist\n\tuniform (default), zipf:theta, pareto:h, normal:stddev%%\n"
+	       "\tor permute (every block exactly once per pass).\n"
+	       "  --randseed=N\n\tseed for the per thread random streams.\n"
+	       "  --runtime=secs\n\tstop each round after this many seconds.\n"
+	       "  --time-based\n\tkeep repeating passes over the file until the runtime is up.\n"
+	       "  --verify\n\tstamp each written block with a header and CRC32C, check every block\n"
+	       "\tread and read back written blocks after each write workload.\n"
+	       "  --data=const|random\n\twrite a constant byte per thread (default) or data generated for\n"
+	       "\tevery write so no two blocks match.\n"
+	       "  --compress-ratio=R\n\trandom data that compresses about R:1, each 4K chunk is random\n"
+	       "\tup to 1/R of its length and zero after that.\n"
+	       "  --dedupe=N\n\trandom data with N%% of 4K chunks repeating a pool shared by all threads,\n"
+	       "\t--verify headers make every chunk unique.\n"
+	       "  --keep-layouts\n\tleave read test files in place named after their size, seed and data,\n"
+	       "\tlater runs reuse them and files that tests write are cloned from them.\n"
+	       "  --rate-iops=N\n\topen loop, each thread issues N ops per second on a fixed schedule.\n"
+	       "  --rate=size\n\topen loop, each thread issues size bytes per second on a fixed schedule.\n"
+	       "  --thinktime=usecs\n\tidle between bursts of ops.\n"
+	       "  --thinktime-blocks=N\n\tops per burst between thinktime idles, default is 1.\n"
+	       "  --job=name:key=val,...\n\tadd a job group, all groups run at once.  Keys are test, threads,\n"
+	       "\tbs, size, blocks, bssplit, engine, iodepth, direct, sync, noatime, rwmixread,\n"
+	       "\trate-iops, rate, thinktime, thinktime-blocks, time-based, random-distribution,\n"
+	       "\tfanout, depth, dirs=own|shared, meta-ops, checkpoint, txn-reads, verify, data,\n"
+	       "\tcompress-ratio, dedupe and file=own|shared, anything not given comes from the\n"
+	       "\tother options.\n"
+	       "  --fio-job=file\n\trun a fio job file, each section is a job group.  Supports rw, rwmixread,\n"
+	       "\tbs, bssplit, size, numjobs, iodepth, ioengine, direct, runtime, time_based,\n"
+	       "\tthinktime, stonewall, nrfiles, filename, directory, refill_buffers,\n"
+	       "\tbuffer_compress_percentage, dedupe_percentage and ${VAR} from the environment.\n"
+	       "  --meta-fanout=N\n\tmeta: subdirectories per directory, default is 16.\n"
+	       "  --meta-depth=N\n\tmeta: directory levels, files go in the deepest, default is 1.\n"
+	       "  --meta-dirs=own|shared\n\tmeta: a tree per thread (default) or one tree for all threads.\n"
+	       "  --meta-ops=list\n\tmeta: ops between create and unlink, stat, readdir, rename or none,\n"
+	       "\tdefault is all.  -n is the number of files, -b the data written to each.\n"
+	       "  --fsync-methods=list\n\tfsync: write+fsync, write+fdatasync, O_DSYNC, O_SYNC, RWF_DSYNC,\n"
+	       "\tsync_file_range, io_uring+fsync or all (default).\n"
+	       "  --fsync-sizes=list\n\tfsync: up to %d commit sizes, default is -b.  -n commits are made\n"
+	       "\tper method, size and open mode.\n"
+	       "  --db-checkpoint=msecs\n\tdb: interval between checkpoints, default is 1000.\n"
+	       "  --db-txn-reads=N\n\tdb: page reads per transaction, default is 4.  -b is the page size,\n"
+	       "\t-n the pages, thread 0 writes the WAL, thread 1 checkpoints.\n", FSYNC_MAX_SIZES);
 	show_tests();
+	io_engines_show();
 	printf("\n");
 }
 
@@ -632,26 +960,521 @@ void sighandler(int dummy)
 	(void)dummy;
 
 	opt_flags &= ~OPT_CONT;
+	test_stop.interrupted = true;
+}
+
+/*
+ *  show_job()
+ *	describe a group's workload, groups from --job
+ *	are introduced by name and indented
+ */
+static void show_job(const job_group_t *job)
+{
+	const test_context_t *test = &job->test;
+	const char *in = *job->name ? "  " : "";
+	char buf[64];
+
+	if (*job->name)
+		printf("Job %s: %s (%s), %s file\n", job->name, job->ti->tag, job->ti->name,
+			job->shared ? "shared" : "own");
+	if (test->engine->flags & IO_ENGINE_QUEUED)
+		printf("%sUsing %s I/O engine, iodepth %" PRIu32 "\n",
+			in, test->engine->name, test->iodepth);
+	else if (test->engine->flags & IO_ENGINE_VECTORED)
+		printf("%sUsing %s I/O engine, %" PRIu32 " blocks per call\n",
+			in, test->engine->name, test->vec_blocks);
+	else
+		printf("%sUsing %s I/O engine\n", in, test->engine->name);
+	if (job->dist.type == RAND_DIST_PERMUTE)
+		printf("%sRandom offsets permuted over %" PRIu64 " slots, seed %" PRIu64 "\n",
+			in, job->dist.n, test->randseed);
+	else if (job->dist.type != RAND_DIST_UNIFORM)
+		printf("%sRandom offsets %s %g over %" PRIu64 " slots, seed %" PRIu64 "\n",
+			in, rand_dist_name(&job->dist), job->dist.param, job->dist.n, test->randseed);
+	if (test->bssplit) {
+		const io_bssplit_t *split = test->bssplit;
+		uint32_t i, pct = 0;
+
+		printf("%s%s: %" PRIu32 " threads x blocks of",
+			in, size_to_str_h(test->file_size, "%.2f", buf, sizeof(buf)), job->threads);
+		for (i = 0; i < split->n; i++) {
+			printf(" %" PRIu64 " bytes %" PRIu32 "%%%s", split->size[i],
+				split->cum_pct[i] - pct, (i + 1 < split->n) ? "," : "\n");
+			pct = split->cum_pct[i];
+		}
+	} else {
+		printf("%s%s: %" PRIu32 " threads x %" PRIu64 " byte sized blocks x %.1f blocks\n",
+			in, size_to_str_h(test->file_size, "%.2f", buf, sizeof(buf)),
+			job->threads, test->block_size, test->d_per_thread_blocks);
+	}
+	if (test->time_based)
+		printf("%sTime based, passes repeat until the runtime is up\n", in);
+	if (test->rate_iops || test->rate_bytes) {
+		if (test->rate_iops)
+			printf("%sOpen loop at %" PRIu64 " ops per sec per thread", in, test->rate_iops);
+		else
+			printf("%sOpen loop at %s per sec per thread",
+				in, size_to_str_h(test->rate_bytes, "%.2f", buf, sizeof(buf)));
+		printf(", latency from the scheduled issue time\n");
+	}
+	if (test->thinktime_ns)
+		printf("%sThink time %" PRIu64 " us every %" PRIu32 " ops\n",
+			in, test->thinktime_ns / 1000, test->thinktime_blocks);
+	if (test->verify)
+		printf("%sVerifying %" PRIu32 " byte blocks with CRC32C (%s)\n",
+			in, verify_unit(test), verify_crc_impl());
+	if (test->data_mode == DATA_RANDOM)
+		printf("%sRandom data, %.1f:1 compressible, %" PRIu32 "%% of %d byte chunks deduped\n",
+			in, test->data_compress, test->data_dedupe, DATA_CHUNK);
+	if (job->ti->test == meta)
+		printf("%sMetadata tree fanout %" PRIu32 ", depth %" PRIu32 ", %s directories, "
+			"create,%s%s%sunlink\n", in, test->meta_fanout, test->meta_depth,
+			test->meta_shared ? "shared" : "own",
+			(test->meta_mask & (1U << META_STAT)) ? "stat," : "",
+			(test->meta_mask & (1U << META_READDIR)) ? "readdir," : "",
+			(test->meta_mask & (1U << META_RENAME)) ? "rename," : "");
+}
+
+/*
+ *  job_latency()
+ *	a group's reads and writes in one histogram
+ */
+static void job_latency(const histogram_t *dir_hist, histogram_t *hist)
+{
+	uint32_t d;
+
+	histogram_reset(hist);
+	for (d = 0; d < IO_DIRS; d++)
+		histogram_merge(hist, &dir_hist[d]);
+}
+
+/*
+ *  show_job_round()
+ *	a group's line under each round, its rates are
+ *	over its own duration
+ */
+static void show_job_round(const job_group_t *job, const int width)
+{
+	const double secs = (double)job->duration_ns / NS_PER_SEC;
+	histogram_t hist;
+	char buf[64];
+
+	job_latency(job->lat_round, &hist);
+	printf("  %-*s%8.3f %12s %12.3f  p50 %.3f us, p99 %.3f us, p99.9 %.3f us\n",
+		width, job->name, secs,
+		size_to_str((double)(job->dir_bytes[IO_DIR_READ] + job->dir_bytes[IO_DIR_WRITE]) / secs,
+			"%12.3f", buf, sizeof(buf)),
+		(double)(job->dir_ops[IO_DIR_READ] + job->dir_ops[IO_DIR_WRITE]) / secs,
+		(double)histogram_percentile(&hist, 50.0) / 1000.0,
+		(double)histogram_percentile(&hist, 99.0) / 1000.0,
+		(double)histogram_percentile(&hist, 99.9) / 1000.0);
+}
+
+/*
+ *  show_job_total()
+ *	a group's latency over all rounds
+ */
+static void show_job_total(const job_group_t *job, const int width)
+{
+	histogram_t hist;
+
+	job_latency(job->lat_total, &hist);
+	printf("  %-*s (us):              p50 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+		width, job->name,
+		(double)histogram_percentile(&hist, 50.0) / 1000.0,
+		(double)histogram_percentile(&hist, 99.0) / 1000.0,
+		(double)histogram_percentile(&hist, 99.9) / 1000.0,
+		(double)hist.max_ns / 1000.0);
+}
+
+/*
+ *  show_meta_round()
+ *	metadata ops of a round, each op's rate is over
+ *	the time the workers spent in its passes
+ */
+static void show_meta_round(const meta_results_t *res)
+{
+	uint32_t op;
+
+	for (op = 0; op < META_OPS; op++) {
+		if (!res->ops[op])
+			continue;
+		printf("  %-8s                     %12.3f  p50 %.3f us, p99 %.3f us\n",
+			meta_op_name((meta_op_t)op), res->rate[op],
+			(double)histogram_percentile(&res->lat[op], 50.0) / 1000.0,
+			(double)histogram_percentile(&res->lat[op], 99.0) / 1000.0);
+	}
+}
+
+/*
+ *  show_meta_total()
+ *	metadata op latencies over all rounds
+ */
+static void show_meta_total(const meta_results_t *res)
+{
+	uint32_t op;
+
+	for (op = 0; op < META_OPS; op++) {
+		if (!res->ops[op])
+			continue;
+		printf("  %-8s (us): %10" PRIu64 " ops, p50 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+			meta_op_name((meta_op_t)op), res->ops[op],
+			(double)histogram_percentile(&res->lat[op], 50.0) / 1000.0,
+			(double)histogram_percentile(&res->lat[op], 99.0) / 1000.0,
+			(double)histogram_percentile(&res->lat[op], 99.9) / 1000.0,
+			(double)res->lat[op].max_ns / 1000.0);
+	}
+}
+
+/*
+ *  show_db_round()
+ *	commit latency and read latency with and
+ *	without a checkpoint running
+ */
+static void show_db_round(const histogram_t *hist)
+{
+	uint32_t h;
+
+	for (h = DB_COMMIT; h <= DB_READ_CKPT; h++) {
+		if (!hist[h].count)
+			continue;
+		printf("  %-10s %10" PRIu64 " ops          p50 %.3f us, p99 %.3f us\n",
+			db_hist_name((db_hist_t)h), hist[h].count,
+			(double)histogram_percentile(&hist[h], 50.0) / 1000.0,
+			(double)histogram_percentile(&hist[h], 99.0) / 1000.0);
+	}
+}
+
+/*
+ *  show_db_total()
+ *	database latencies over all rounds, with the commits
+ *	per WAL sync and pages per checkpoint
+ */
+static void show_db_total(const histogram_t *hist)
+{
+	uint32_t h;
+
+	printf("\nDatabase emulation:\n");
+	for (h = 0; h < DB_HISTS; h++) {
+		if (!hist[h].count)
+			continue;
+		printf("  %-10s (us): %10" PRIu64 " ops, p50 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+			db_hist_name((db_hist_t)h), hist[h].count,
+			(double)histogram_percentile(&hist[h], 50.0) / 1000.0,
+			(double)histogram_percentile(&hist[h], 99.0) / 1000.0,
+			(double)histogram_percentile(&hist[h], 99.9) / 1000.0,
+			(double)hist[h].max_ns / 1000.0);
+	}
+	if (hist[DB_WAL_SYNC].count)
+		printf("  %.3f commits per WAL sync\n",
+			(double)hist[DB_COMMIT].count / (double)hist[DB_WAL_SYNC].count);
+	if (hist[DB_CKPT].count)
+		printf("  %.3f pages per checkpoint\n",
+			(double)hist[DB_PAGE_WRITE].count / (double)hist[DB_CKPT].count);
+}
+
+/*
+ *  show_fsync_total()
+ *	commit methods over all rounds, fastest first
+ */
+static void show_fsync_total(const fsync_result_t *res, const uint32_t rounds)
+{
+	static const char *mode_name[FSYNC_MODES] = { "persistent fd", "open per commit" };
+	uint32_t order[FSYNC_RESULTS], n, i, shown = 0;
+	bool not_durable = false;
+
+	n = fsync_rank(res, order);
+	printf("\nCommit methods ranked by commits per sec, latency (us):\n");
+	for (i = 0; i < n; i++) {
+		const fsync_result_t *r = &res[order[i]];
+		const uint32_t m = order[i] % FSYNC_METHODS;
+
+		not_durable |= (m == FSYNC_SYNC_FILE_RANGE);
+		printf("  %2" PRIu32 " %-16s %8" PRIu64 " B %-16s %12.3f  p50 %.3f, p99 %.3f, p99.9 %.3f%s\n",
+			i + 1, fsync_method_name((fsync_method_t)m), r->size,
+			mode_name[order[i] / (FSYNC_MAX_SIZES * FSYNC_METHODS)],
+			r->rate / (double)rounds,
+			(double)histogram_percentile(&r->lat, 50.0) / 1000.0,
+			(double)histogram_percentile(&r->lat, 99.0) / 1000.0,
+			(double)histogram_percentile(&r->lat, 99.9) / 1000.0,
+			(m == FSYNC_SYNC_FILE_RANGE) ? " *" : "");
+	}
+	for (i = 0; i < FSYNC_RESULTS; i++) {
+		const uint32_t m = i % FSYNC_METHODS;
+
+		if (!res[i].err || (shown & (1U << m)))
+			continue;
+		shown |= 1U << m;
+		printf("     %-16s not supported: %s\n",
+			fsync_method_name((fsync_method_t)m), strerror(res[i].err));
+	}
+	if (not_durable)
+		printf("  * sync_file_range does not flush metadata or the device cache\n");
+}
+
+/*
+ *  phase_span()
+ *	a phase runs from the release of its workers to the
+ *	first or last finish, workers of other phases are
+ *	skipped.  The largest skews of the round are kept
+ */
+static uint64_t phase_span(
+	const test_context_t *tests,
+	const uint32_t n,
+	uint64_t *time_start,
+	stat_t *stat)
+{
+	uint64_t start = UINT64_MAX, start_last = 0, end_first = UINT64_MAX, end = 0;
+	uint32_t t;
+
+	for (t = 0; t < n; t++) {
+		if (!tests[t].test_info)
+			continue;
+		if (tests[t].start_ns < start)
+			start = tests[t].start_ns;
+		if (tests[t].start_ns > start_last)
+			start_last = tests[t].start_ns;
+		if (tests[t].end_ns < end_first)
+			end_first = tests[t].end_ns;
+		if (tests[t].end_ns > end)
+			end = tests[t].end_ns;
+	}
+	if ((double)(start_last - start) > stat->val[STAT_START_SKEW])
+		stat->val[STAT_START_SKEW] = (double)(start_last - start);
+	if ((double)(end - end_first) > stat->val[STAT_FINISH_SKEW])
+		stat->val[STAT_FINISH_SKEW] = (double)(end - end_first);
+	if (opt_stop == POOL_STOP_FIRST)
+		end = end_first;
+	*time_start = start;
+
+	return (end > start) ? end - start : 1;
+}
+
+/*
+ *  alloc_per_thread()
+ *	zeroed, cache line aligned array of n per thread items
+ */
+static void *alloc_per_thread(const uint32_t n, const size_t size, const char *what)
+{
+	void *ptr;
+
+	if (posix_memalign(&ptr, CACHE_LINE_SIZE, (size_t)n * size) != 0) {
+		fprintf(stderr, "Out of memory allocating %s\n", what);
+		return NULL;
+	}
+	memset(ptr, 0, (size_t)n * size);
+
+	return ptr;
+}
+
+/*
+ *  hot_step()
+ *	point the first n workers at one step of the sweep,
+ *	each reading or copying its share of the file, and run
+ *	them.  Returns the bytes per second over the step
+ */
+static double hot_step(
+	job_group_t *job,
+	test_info_t *ti,
+	test_context_t *tests,
+	histogram_t *lat_hists,
+	io_counters_t *counters,
+	const placement_t *place,
+	const uint32_t max,
+	const uint32_t n)
+{
+	const test_context_t *test = &job->test;
+	const uint64_t per = ((test->file_size / n) / test->block_size) * test->block_size;
+	uint64_t bytes = 0, duration_ns, start;
+	stat_t stat;
+	uint32_t t;
+
+	rand_dist_init(&job->dist, per / (test->bssplit ? test->bssplit->min_size : test->block_size));
+	for (t = 0; t < max; t++) {
+		tests[t] = *test;
+		tests[t].instance = t;
+		tests[t].threads = n;
+		tests[t].per_thread_file_size = per;
+		tests[t].per_thread_blocks = per / test->block_size;
+		tests[t].d_per_thread_blocks = (double)per / test->block_size;
+		tests[t].lat_hist = &lat_hists[t * IO_DIRS];
+		tests[t].counters = &counters[t];
+		tests[t].cpu = place[t].cpu;
+		tests[t].node = place[t].node;
+		tests[t].test_info = (t < n) ? ti : NULL;
+		histogram_reset(&lat_hists[t * IO_DIRS + IO_DIR_READ]);
+		histogram_reset(&lat_hists[t * IO_DIRS + IO_DIR_WRITE]);
+	}
+	memset(counters, 0, (size_t)max * sizeof(io_counters_t));
+	memset(&stat, 0, sizeof(stat));
+
+	pool_run(opt_runtime_ns);
+	duration_ns = phase_span(tests, max, &start, &stat);
+	for (t = 0; t < n; t++) {
+		if (tests[t].ret < 0)
+			return -1.0;
+		bytes += tests[t].dir_bytes[IO_DIR_READ];
+	}
+	return (double)bytes * NS_PER_SEC / (double)duration_ns;
+}
+
+/*
+ *  hot_sweep()
+ *	--hot-sweep: warm the file into the page cache, check
+ *	all of it is there and read it with each thread count
+ *	in turn, each step followed by a memcpy() of the same
+ *	amount from memory.  Shows where cached reads stop
+ *	scaling and how close they get to memory bandwidth
+ */
+static int hot_sweep(
+	job_group_t *job,
+	test_context_t *tests,
+	histogram_t *lat_hists,
+	io_counters_t *counters,
+	const placement_t *place,
+	const uint32_t *steps,
+	const uint32_t nsteps)
+{
+	const uint32_t max = steps[nsteps - 1];
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	double first_rate = 0.0, prev_rate = 0.0;
+	uint32_t s, first = 0, prev = 0, flat = 0;
+	uint64_t cached, size;
+	char buf[4][64];
+	int rc = 0;
+
+	if (job_round_init(job, 1) < 0)
+		return -1;
+	if (hot_warm(job->filename) < 0) {
+		rc = -1;
+		goto out;
+	}
+	job_cache_resident(job, 1, &cached, &size);
+	if (!size || (cached < size)) {
+		fprintf(stderr, "Only %.1f%% of the %s file stays cached, it must fit in memory\n",
+			size ? 100.0 * (double)cached / (double)size : 0.0,
+			size_to_str_h((double)size, "%.2f", buf[0], sizeof(buf[0])));
+		rc = -1;
+		goto out;
+	}
+	if (hot_copy_init(size, max, job->test.block_size) < 0) {
+		rc = -1;
+		goto out;
+	}
+
+	printf("Hot cache sweep over %s, all cached, memcpy() baseline from %s of memory\n",
+		size_to_str_h((double)size, "%.2f", buf[0], sizeof(buf[0])),
+		size_to_str_h((double)hot_copy_size(), "%.2f", buf[1], sizeof(buf[1])));
+	printf("Threads   Read Rate/s    Per Core/s  Scaling  memcpy Rate/s  Read/memcpy\n");
+	for (s = 0; (opt_flags & OPT_CONT) && (s < nsteps); s++) {
+		const uint32_t n = steps[s];
+		const uint32_t cores = ((cpus > 0) && ((uint32_t)cpus < n)) ? (uint32_t)cpus : n;
+		double rate, copy_rate;
+
+		/* Memory pressure from the last step may have evicted some of it */
+		job_cache_resident(job, 1, &cached, &size);
+		if (cached < size)
+			(void)hot_warm(job->filename);
+
+		rate = hot_step(job, job->ti, tests, lat_hists, counters, place, max, n);
+		copy_rate = hot_step(job, &hot_copy_info, tests, lat_hists, counters, place, max, n);
+		if ((rate < 0.0) || (copy_rate < 0.0)) {
+			fprintf(stderr, "Sweep step of %" PRIu32 " threads failed\n", n);
+			rc = -1;
+			break;
+		}
+		if (!first) {
+			first = n;
+			first_rate = rate;
+		} else if (!flat && (rate / prev_rate - 1.0 <
+			   HOT_FLAT_GAIN * ((double)n / (double)prev - 1.0))) {
+			flat = n;
+		}
+		printf("%7" PRIu32 " %13s %13s %7.1f%% %14s %11.1f%%%s\n",
+			n,
+			size_to_str_h(rate, "%8.2f", buf[0], sizeof(buf[0])),
+			size_to_str_h(rate / cores, "%8.2f", buf[1], sizeof(buf[1])),
+			100.0 * (rate / first_rate) / ((double)n / (double)first),
+			size_to_str_h(copy_rate, "%8.2f", buf[2], sizeof(buf[2])),
+			copy_rate > 0.0 ? 100.0 * rate / copy_rate : 0.0,
+			cached < size ? " (rewarmed)" : "");
+		prev = n;
+		prev_rate = rate;
+	}
+	if ((rc == 0) && (s == nsteps) && (nsteps > 1)) {
+		if (flat)
+			printf("Scaling flattens at %" PRIu32 " threads, under %.0f%% of the ideal gain\n",
+				flat, HOT_FLAT_GAIN * 100.0);
+		else
+			printf("Reads scale to %" PRIu32 " threads\n", max);
+	}
+	hot_copy_free();
+out:
+	if (job_round_deinit(job, 1) < 0)
+		rc = -1;
+	job_files_done(job, 1);
+
+	return rc;
 }
 
 int main(int argc, char **argv)
 {
-	int n, rc = EXIT_SUCCESS;
+	int rc = EXIT_SUCCESS;
 	uint32_t i, j, repeats = 1, r, num_threads = 1, t;
 	char filename[PATH_MAX];
 	char buf[64];
-	char *pathname, *opt_test;
-	stat_t *stat_vals, results[STAT_RESULT_MAX];
+	char *pathname = NULL, *opt_test = NULL;
+	stat_t *stat_vals, results[STAT_RESULT_MAX], lat_all;
+	histogram_t *lat_hists, *meta_hists = NULL, lat_round, lat_total;
+	meta_results_t meta_round, meta_total;
+	fsync_result_t *fsync_res = NULL, *fsync_total = NULL;
+	histogram_t *db_hists = NULL, db_round[DB_HISTS], db_total[DB_HISTS];
+	uint32_t db_groups = 0, shared_groups = 0;
+	uint64_t verify_total = 0, verify_failed = 0;
+	bool meta_run = false, fsync_run = false, verify_run = false;
+	histogram_t lat_round_dir[IO_DIRS], lat_total_dir[IO_DIRS];
+	static const stat_val_t lat_dir_stat[IO_DIRS] = { STAT_READ_LAT_P50, STAT_WRITE_LAT_P50 };
+	static const char *dir_name[IO_DIRS] = { "Reads", "Writes" };
+	io_bssplit_t bssplit;
+	io_dist_t dist;
+	job_group_t *jobs = NULL, *defaults;
+	char *job_specs[MAX_JOBS];
+	char *opt_fio_job = NULL;
+	fio_job_t fio;
+	uint32_t njobs = 0, num_groups, num_phases = 1, g, p;
+	int name_width = 8;
+	uint64_t file_bytes = 0;
+	io_counters_t *counters = NULL;
+	placement_t *place = NULL;
 	test_info_t *ti = NULL;
 	uint64_t mem_total;
+	const char *op_name;
 	struct sigaction new_action, old_action;
 
-	test_context_t tests[MAX_THREADS], test;
+	test_context_t *tests, test;
 
 	memset(&test, 0, sizeof(test));
+	test.engine = io_engine_find("sync");
+	test.iodepth = 1;
+	test.mmap_advice = -1;
+	test.mmap_msync = IO_MSYNC_NONE;
+	test.vec_blocks = 1;
+	test.rwmixread = 50;
+	test.randseed = 0x2545f4914f6cdd1dULL;
+	test.thinktime_blocks = 1;
+	test.meta_fanout = 16;
+	test.meta_depth = 1;
+	test.meta_mask = META_DEFAULT_MASK;
+	test.fsync_mask = FSYNC_ALL_MASK;
+	test.db_ckpt_ns = NS_PER_SEC;
+	test.db_txn_reads = 4;
+	test.data_compress = 1.0;
+	(void)rand_dist_parse("uniform", &dist);
+	test.dist = &dist;
 
 	for (;;) {
-		int c = getopt(argc, argv, "adsb:l:n:hHp:r:t:Tx:o:");
+		int c = getopt_long(argc, argv, "adsb:e:l:n:hHp:r:St:Tx:o:",
+			long_options, NULL);
 		if (c == -1)
 			break;
 		switch (c) {
@@ -708,56 +1531,372 @@ int main(int argc, char **argv)
 		case 'x':
 			opt_test = optarg;
 			break;
+		case 'e':
+			test.engine = io_engine_find(optarg);
+			if (!test.engine) {
+				fprintf(stderr, "%s is not a valid I/O engine\n", optarg);
+				io_engines_show();
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_IODEPTH:
+			test.iodepth = get_u32(optarg);
+			if ((test.iodepth < 1) || (test.iodepth > MAX_IODEPTH)) {
+				fprintf(stderr, "iodepth must be 1..%d\n", MAX_IODEPTH);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_IODEPTH_BATCH:
+			test.iodepth_batch = get_u32(optarg);
+			break;
+		case OPT_LONG_IODEPTH_BATCH_COMPLETE:
+			test.iodepth_batch_complete = get_u32(optarg);
+			break;
+		case OPT_LONG_FIXEDBUFS:
+			test.io_flags |= IO_FLAG_FIXED_BUFS;
+			break;
+		case OPT_LONG_REGISTERFILES:
+			test.io_flags |= IO_FLAG_FIXED_FILES;
+			break;
+		case OPT_LONG_SQPOLL:
+			test.io_flags |= IO_FLAG_SQPOLL;
+			break;
+		case OPT_LONG_MMAP_POPULATE:
+			test.io_flags |= IO_FLAG_MMAP_POPULATE;
+			break;
+		case OPT_LONG_MADVISE:
+			test.mmap_advice = io_mmap_advice(optarg);
+			if (test.mmap_advice < 0) {
+				fprintf(stderr, "%s is not a valid madvise advice\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_VEC_BLOCKS:
+			test.vec_blocks = get_u32(optarg);
+			if ((test.vec_blocks < 1) || (test.vec_blocks > MAX_VEC_BLOCKS)) {
+				fprintf(stderr, "vec-blocks must be 1..%d\n", MAX_VEC_BLOCKS);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_RWF:
+			test.rwf_flags = io_rwf_flags(optarg);
+			if (test.rwf_flags < 0) {
+				fprintf(stderr, "%s is not a valid list of RWF flags\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_MSYNC:
+			test.mmap_msync = io_mmap_msync(optarg);
+			if (test.mmap_msync < 0) {
+				fprintf(stderr, "%s is not a valid msync policy\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_RWMIXREAD:
+			test.rwmixread = get_u32(optarg);
+			if (test.rwmixread > 100) {
+				fprintf(stderr, "Read percentage must be 0..100\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_BSSPLIT:
+			parse_bssplit(optarg, &bssplit);
+			test.bssplit = &bssplit;
+			break;
+		case OPT_LONG_RANDOM_DIST:
+			if (rand_dist_parse(optarg, &dist) < 0) {
+				fprintf(stderr, "%s is not a valid random distribution\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_RANDSEED:
+			test.randseed = get_u64(optarg);
+			break;
+		case OPT_LONG_JOB:
+			if (njobs == MAX_JOBS) {
+				fprintf(stderr, "Maximum of %d job groups allowed\n", MAX_JOBS);
+				exit(EXIT_FAILURE);
+			}
+			job_specs[njobs++] = optarg;
+			break;
+		case OPT_LONG_FIO_JOB:
+			opt_fio_job = optarg;
+			break;
+		case OPT_LONG_META_FANOUT:
+			test.meta_fanout = get_u32(optarg);
+			break;
+		case OPT_LONG_META_DEPTH:
+			test.meta_depth = get_u32(optarg);
+			break;
+		case OPT_LONG_META_DIRS:
+			if (!strcmp(optarg, "shared") || !strcmp(optarg, "own")) {
+				test.meta_shared = !strcmp(optarg, "shared");
+			} else {
+				fprintf(stderr, "Metadata directories must be shared or own\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_META_OPS:
+			{
+				const int mask = meta_ops_parse(optarg);
+
+				if (mask < 0) {
+					fprintf(stderr, "%s is not a valid list of metadata ops\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				test.meta_mask = (uint32_t)mask;
+			}
+			break;
+		case OPT_LONG_FSYNC_METHODS:
+			{
+				const int mask = fsync_methods_parse(optarg);
+
+				if (mask < 0) {
+					fprintf(stderr, "%s is not a valid list of commit methods\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				test.fsync_mask = (uint32_t)mask;
+			}
+			break;
+		case OPT_LONG_DB_CHECKPOINT:
+			test.db_ckpt_ns = get_u64(optarg) * 1000000ULL;
+			break;
+		case OPT_LONG_DB_TXN_READS:
+			test.db_txn_reads = get_u32(optarg);
+			break;
+		case OPT_LONG_FSYNC_SIZES:
+			if (fsync_sizes_parse(optarg, &test) < 0) {
+				fprintf(stderr, "Commit sizes must be a list of up to %d sizes\n",
+					FSYNC_MAX_SIZES);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_RUNTIME:
+			opt_runtime_ns = get_u64(optarg) * NS_PER_SEC;
+			break;
+		case OPT_LONG_TIME_BASED:
+			test.time_based = true;
+			break;
+		case OPT_LONG_VERIFY:
+			test.verify = true;
+			break;
+		case OPT_LONG_DATA:
+			{
+				const int mode = data_mode_parse(optarg);
+
+				if (mode < 0) {
+					fprintf(stderr, "Data must be const or random\n");
+					exit(EXIT_FAILURE);
+				}
+				test.data_mode = (data_mode_t)mode;
+			}
+			break;
+		case OPT_LONG_COMPRESS_RATIO:
+			if (data_compress_parse(optarg, &test.data_compress) < 0) {
+				fprintf(stderr, "Compression ratio must be a number of at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			test.data_mode = DATA_RANDOM;
+			break;
+		case OPT_LONG_KEEP_LAYOUTS:
+			test.setup_keep = true;
+			break;
+		case OPT_LONG_DEDUPE:
+			test.data_dedupe = get_u32(optarg);
+			if (test.data_dedupe > 100) {
+				fprintf(stderr, "Dedupe percentage must be 0..100\n");
+				exit(EXIT_FAILURE);
+			}
+			test.data_mode = DATA_RANDOM;
+			break;
+		case OPT_LONG_RATE_IOPS:
+			test.rate_iops = get_u64(optarg);
+			break;
+		case OPT_LONG_RATE:
+			test.rate_bytes = get_u64_byte(optarg);
+			break;
+		case OPT_LONG_THINKTIME:
+			test.thinktime_ns = get_u64(optarg) * 1000;
+			break;
+		case OPT_LONG_THINKTIME_BLOCKS:
+			test.thinktime_blocks = get_u32(optarg);
+			if (test.thinktime_blocks < 1) {
+				fprintf(stderr, "Thinktime blocks must be at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_AFFINITY:
+			if (affinity_policy(optarg) < 0) {
+				fprintf(stderr, "%s is not a valid affinity policy or cpu list\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			opt_affinity = optarg;
+			break;
+		case OPT_LONG_CACHE:
+			opt_cache = cache_mode_parse(optarg);
+			if (opt_cache < 0) {
+				fprintf(stderr, "Cache must be evict, drop or keep\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_HOT_SWEEP:
+			if (hot_steps_parse(optarg, opt_hot, &opt_hot_n) < 0) {
+				fprintf(stderr, "Hot sweep needs a list of up to %d ascending thread counts\n",
+					HOT_MAX_STEPS);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_STOP:
+			opt_stop = pool_stop(optarg);
+			if (opt_stop < 0) {
+				fprintf(stderr, "%s is not a valid stop policy\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_CLOCK:
+			opt_clock = time_clock(optarg);
+			if (opt_clock < 0) {
+				fprintf(stderr, "%s is not a valid clock source\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_LONG_LOG:
+			opt_log_filename = optarg;
+			break;
+		case OPT_LONG_LOG_AVG_MSEC:
+			opt_log_avg_msec = get_u32(optarg);
+			if (opt_log_avg_msec < 1) {
+				fprintf(stderr, "Log interval must be at least 1 ms\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
 		default:
 			show_usage();
 			exit(EXIT_FAILURE);
 		}
 	}
 
-	if (pathname == NULL) {
-		fprintf(stderr, "Must specify pathname with -p option\n");
+	if (time_init((time_clock_t)opt_clock) < 0)
+		exit(EXIT_FAILURE);
+
+	if (opt_fio_job && njobs) {
+		fprintf(stderr, "Cannot use --job with --fio-job\n");
 		exit(EXIT_FAILURE);
 	}
-	if (opt_test == NULL) {
+	if (opt_test) {
+		ti = test_find(opt_test);
+		if (!ti) {
+			fprintf(stderr, "%s is not a valid test name\n", opt_test);
+			show_tests();
+			exit(EXIT_FAILURE);
+		}
+	} else if (!njobs && !opt_fio_job) {
 		fprintf(stderr, "Must specify test to run\n");
 		exit(EXIT_FAILURE);
 	}
-	for (ti = test_info; ti->test; ti++) {
-		if (!strcmp(opt_test, ti->tag))
-			break;
-	}
-	if (!ti->test) {
-		fprintf(stderr, "%s is not a valid test name\n", opt_test);
-		show_tests();
+
+	/* The options are the single group, or the defaults for each --job or fio job */
+	num_groups = opt_fio_job ? MAX_JOBS : (njobs ? njobs : 1);
+	jobs = calloc((size_t)num_groups + 1, sizeof(*jobs));
+	if (!jobs) {
+		fprintf(stderr, "Out of memory allocating job groups\n");
 		exit(EXIT_FAILURE);
 	}
+	defaults = &jobs[num_groups];
+	defaults->ti = ti;
+	defaults->test = test;
+	defaults->threads = num_threads;
+	defaults->size_flags = opt_flags & (OPT_BLOCK_SIZE | OPT_FILE_SIZE | OPT_BLOCKS);
+	defaults->dist = dist;
+	if (test.bssplit)
+		defaults->bssplit = bssplit;
+	if (opt_fio_job) {
+		if (fio_job_load(opt_fio_job, defaults, jobs, MAX_JOBS, &fio) < 0)
+			exit(EXIT_FAILURE);
+		njobs = num_groups = fio.groups;
+		num_phases = fio.phases;
+		if (!opt_runtime_ns)
+			opt_runtime_ns = fio.runtime_ns;
+		if (!pathname)
+			pathname = fio.directory;
+	}
+	if (!njobs)
+		jobs[0] = *defaults;
+	for (g = 0; g < njobs; g++) {
+		if (!opt_fio_job && (job_parse(&jobs[g], job_specs[g], defaults) < 0))
+			exit(EXIT_FAILURE);
+		for (i = 0; i < g; i++) {
+			if (!strcmp(jobs[i].name, jobs[g].name)) {
+				fprintf(stderr, "Job %s is given more than once\n", jobs[g].name);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
 
-	n = count_bits(opt_flags & (OPT_BLOCK_SIZE | OPT_FILE_SIZE | OPT_BLOCKS));
-	if (n != 2) {
-		fprintf(stderr, "Must specify either -b and -l, -b and -n, -l and -n options\n");
+	if (pathname == NULL) {
+		fprintf(stderr, "Must specify pathname with -p option\n");
 		exit(EXIT_FAILURE);
 	}
+	snprintf(filename, sizeof(filename), "%s/temp-%d", pathname, getpid());
+	if (opt_hot_n) {
+		if (num_groups > 1) {
+			fprintf(stderr, "Hot sweep runs a single test, not job groups\n");
+			exit(EXIT_FAILURE);
+		}
+		/* The pool holds the largest step, smaller steps leave the rest idle */
+		jobs[0].threads = opt_hot[opt_hot_n - 1];
+	}
+	num_threads = 0;
+	for (g = 0; g < num_groups; g++) {
+		job_group_t *job = &jobs[g];
 
-	if ((opt_flags & OPT_BLOCK_SIZE) == 0) {
-		test.block_size = test.file_size / test.blocks;
-		test.per_thread_file_size = test.file_size / num_threads;
+		if (job_setup(job, g, pathname, filename) < 0)
+			exit(EXIT_FAILURE);
+		if (job->test.time_based && !opt_runtime_ns) {
+			fprintf(stderr, "Time based runs need a --runtime\n");
+			exit(EXIT_FAILURE);
+		}
+		job->first = num_threads;
+		num_threads += job->threads;
+		file_bytes += job->test.file_size * job->threads;
+	}
+	if (num_threads > MAX_THREADS) {
+		fprintf(stderr, "Maximum of %d threads allowed\n", MAX_THREADS);
+		exit(EXIT_FAILURE);
+	}
+	for (g = 0; g < num_groups; g++)
+		db_groups += (jobs[g].ti->test == db);
+	if (db_groups > 1) {
+		fprintf(stderr, "Only one database emulation group can be run\n");
+		exit(EXIT_FAILURE);
 	}
-	if ((opt_flags & OPT_FILE_SIZE) == 0) {
-		test.file_size = test.block_size * test.blocks;
-		test.per_thread_file_size = (test.block_size * test.blocks) / num_threads;
-		test.file_size = test.per_thread_file_size * num_threads;
+	if (opt_hot_n && (((jobs[0].ti->test != read_seq) && (jobs[0].ti->test != read_rnd)) ||
+	    (jobs[0].test.open_flags & O_DIRECT))) {
+		fprintf(stderr, "Hot sweep needs the rd_seq or rd_rnd test without -d\n");
+		exit(EXIT_FAILURE);
+	}
+	job_files(jobs, num_groups);
+	/* Group lines are as wide as the longest name so none get cut */
+	for (g = 0; g < num_groups; g++) {
+		if ((int)strlen(jobs[g].name) > name_width)
+			name_width = (int)strlen(jobs[g].name);
 	}
-	if ((opt_flags & OPT_BLOCKS) == 0) {
-		test.per_thread_file_size = test.file_size / num_threads;
-		test.blocks = test.file_size / test.block_size;
+	for (g = 0; g < num_groups; g++) {
+		verify_run |= jobs[g].test.verify;
+		shared_groups += jobs[g].shared;
 	}
-	test.per_thread_blocks = test.per_thread_file_size / test.block_size;
-	test.d_per_thread_blocks = (double)test.per_thread_file_size / test.block_size;
+	if (verify_run && (shared_groups > 1)) {
+		/* Blocks are checked against the writing thread's last write */
+		fprintf(stderr, "Verify needs each group on a file of its own\n");
+		exit(EXIT_FAILURE);
+	}
+	if (verify_run)
+		verify_init();
 
 	if ((mem_total = get_mem_total()) == 0) {
 		exit(EXIT_FAILURE);
 	}
-	if (test.file_size * num_threads < (mem_total * 2)) {
+	if (!opt_hot_n && (file_bytes < (mem_total * 2))) {
 		fprintf(stderr, "WARNING: Recommend file size to be at least %-s\n",
 			size_to_str(mem_total * 2, "%.3f", buf, sizeof(buf)));
 	}
@@ -767,80 +1906,214 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Out of memory allocating stats\n");
 		exit(EXIT_FAILURE);
 	}
+	/* Per thread state is sized by -t, each item on its own cache lines */
+	tests = alloc_per_thread(num_threads, sizeof(test_context_t), "thread contexts");
+	lat_hists = alloc_per_thread(num_threads * IO_DIRS, sizeof(histogram_t), "latency histograms");
+	for (g = 0; g < num_groups; g++)
+		meta_run |= (jobs[g].ti->test == meta);
+	if (meta_run) {
+		meta_hists = alloc_per_thread(num_threads * META_OPS, sizeof(histogram_t),
+			"metadata latency histograms");
+		if (!meta_hists) {
+			rc = EXIT_FAILURE;
+			goto out;
+		}
+		meta_results_reset(&meta_total);
+	}
+	for (g = 0; g < num_groups; g++)
+		fsync_run |= (jobs[g].ti->test == fsync_test);
+	if (fsync_run) {
+		fsync_res = alloc_per_thread(num_threads * FSYNC_RESULTS, sizeof(fsync_result_t),
+			"commit results");
+		fsync_total = alloc_per_thread(1, FSYNC_RESULTS * sizeof(fsync_result_t),
+			"commit totals");
+		if (!fsync_res || !fsync_total) {
+			rc = EXIT_FAILURE;
+			goto out;
+		}
+		fsync_results_reset(fsync_total);
+	}
+	if (db_groups) {
+		db_hists = alloc_per_thread(num_threads * DB_HISTS, sizeof(histogram_t),
+			"database latency histograms");
+		if (!db_hists) {
+			rc = EXIT_FAILURE;
+			goto out;
+		}
+		for (i = 0; i < DB_HISTS; i++)
+			histogram_reset(&db_total[i]);
+	}
+	counters = alloc_per_thread(num_threads, sizeof(io_counters_t), "thread counters");
+	place = alloc_per_thread(num_threads, sizeof(placement_t), "thread placement");
+	if (!tests || !lat_hists || !counters || !place) {
+		rc = EXIT_FAILURE;
+		goto out;
+	}
+	histogram_reset(&lat_total);
+	histogram_reset(&lat_total_dir[IO_DIR_READ]);
+	histogram_reset(&lat_total_dir[IO_DIR_WRITE]);
+	if (opt_log_filename) {
+		if (interval_log_open(opt_log_filename, opt_log_avg_msec) < 0) {
+			rc = EXIT_FAILURE;
+			goto out;
+		}
+	}
 
-	printf("Running test %s (%s)\n", ti->tag, ti->name);
-	printf("%s bytes: %" PRIu32 " threads x %" PRIu64 " byte sized blocks x %.1f blocks\n",
-		size_to_str_h(test.file_size, "%.2f", buf, sizeof(buf)),
-		num_threads, test.block_size, test.d_per_thread_blocks);
-
-	snprintf(filename, sizeof(filename), "%s/temp-%d", pathname, getpid());
-
-	test.filename = filename;
-	test.pathname = pathname;
-	test.test_info = ti;
+	if (opt_fio_job)
+		printf("Running fio job file %s, %" PRIu32 " job groups in %" PRIu32 " phases\n",
+			opt_fio_job, num_groups, num_phases);
+	else if (njobs)
+		printf("Running %" PRIu32 " job groups\n", num_groups);
+	else
+		printf("Running test %s (%s)\n", jobs[0].ti->tag, jobs[0].ti->name);
+	if (time_source.clock == TIME_CLOCK_TSC)
+		printf("Timing with %s clock at %.3f MHz, %" PRIu64 " ns per read\n",
+			time_clock_name(), (double)time_source.counter_hz / 1000000.0,
+			time_source.overhead_ns);
+	else
+		printf("Timing with %s clock, %" PRIu64 " ns per read\n",
+			time_clock_name(), time_source.overhead_ns);
+	for (g = 0; g < num_groups; g++) {
+		if (jobs[g].phase && (!g || (jobs[g].phase != jobs[g - 1].phase)))
+			printf("Phase %" PRIu32 " starts when all earlier groups have finished\n",
+				jobs[g].phase);
+		show_job(&jobs[g]);
+	}
 
 	new_action.sa_handler = sighandler;
 	sigemptyset(&new_action.sa_mask);
 	new_action.sa_flags = 0;
 	sigaction(SIGINT, &new_action, &old_action);
 
+	for (t = 0; t < num_threads; t++) {
+		place[t].cpu = -1;
+		place[t].node = -1;
+	}
+	if (opt_affinity) {
+		if (affinity_place(opt_affinity, pathname, num_threads, place) < 0) {
+			rc = EXIT_FAILURE;
+			goto out;
+		}
+		affinity_show(opt_affinity, num_threads, place);
+	}
+
+	if (pool_create(tests, num_threads, (pool_stop_t)opt_stop, place) < 0) {
+		rc = EXIT_FAILURE;
+		goto out;
+	}
+	printf("Rounds stop when the %s worker finishes\n", pool_stop_name((pool_stop_t)opt_stop));
+	if (opt_hot_n)
+		printf("Test files are kept in the page cache for the sweep\n");
+	else if (opt_cache == CACHE_EVICT)
+		printf("Test files are evicted from the page cache before each round\n");
+	else if (opt_cache == CACHE_DROP)
+		printf("All caches are dropped before each round\n");
+	else
+		printf("The page cache is left as it is between rounds\n");
+	if (opt_runtime_ns)
+		printf("Rounds run at most %" PRIu64 " secs\n",
+			(uint64_t)(opt_runtime_ns / NS_PER_SEC));
+
+	if (opt_hot_n) {
+		if (hot_sweep(&jobs[0], tests, lat_hists, counters, place, opt_hot, opt_hot_n) < 0)
+			rc = EXIT_FAILURE;
+		goto out;
+	}
+
+	op_name = (num_groups > 1) ? "I/O" : jobs[0].ti->op_name;
 	printf("          Duration   %8.8s Rate %11.11ss  %s Resp.\n",
-		ti->op_name, ti->op_name, ti->op_name);
+		op_name, op_name, op_name);
 	printf("           (secs)        (per sec)    (per sec)  Time (ms)\n");
-	for (r = 0; (opt_flags && OPT_CONT) && (r < repeats); r++) {
+	for (r = 0; (opt_flags & OPT_CONT) && (r < repeats); r++) {
 		double duration;
-		double time_start, time_end;
-		uint64_t ops = 0;
+		uint64_t time_start = 0, duration_ns = 0;
+		uint64_t ops = 0, nowait_retries = 0, verify_blocks = 0, verify_errors = 0;
+		uint64_t cache_start, cache_size, cache_end, cache_end_size;
+		uint64_t dir_ops[IO_DIRS] = { 0, 0 }, dir_bytes[IO_DIRS] = { 0, 0 };
+		uint32_t d;
 		stat_t stat_start, stat_end;
 
 		init_stats(&stat_vals[r]);
 		init_stats(&stat_start);
 		init_stats(&stat_end);
 
-		if (ti->test_init) {
-			if (ti->test_init(&test) < 0) {
-				rc = EXIT_FAILURE;
-				break;
-			}
+		if (job_round_init(jobs, num_groups) < 0) {
+			rc = EXIT_FAILURE;
+			break;
 		}
 		read_pid_proc_stat(&stat_start);
 		read_slab_stat(&stat_start);
-		read_diskstats(test.pathname, &stat_start);
+		read_diskstats(pathname, &stat_start);
 		read_pid_proc_io(&stat_start);
-		(void)drop_caches();
-
-		time_start = timeval_to_double();
-		for (t = 0; t < num_threads; t++) {
-			tests[t] = test;
-			tests[t].instance = t;
-
-			if (pthread_create(&tests[t].thread, NULL, ti->test, &tests[t]) < 0) {
-				fprintf(stderr, "Cannot start worker thread instance %" PRIu32 "\n", t);
-				rc = EXIT_FAILURE;
-				break;
+		if (opt_cache == CACHE_DROP)
+			(void)drop_caches();
+		else if (opt_cache == CACHE_EVICT)
+			(void)job_cache_evict(jobs, num_groups);
+		job_cache_resident(jobs, num_groups, &cache_start, &cache_size);
+		stat_vals[r].val[STAT_CACHE_START] = cache_size ?
+			100.0 * (double)cache_start / (double)cache_size : 0.0;
+
+		memset(counters, 0, (size_t)num_threads * sizeof(io_counters_t));
+		(void)interval_log_start(r, counters, num_threads);
+
+		for (g = 0, t = 0; t < num_threads; t++) {
+			if (t == jobs[g].first + jobs[g].threads)
+				g++;
+			/* Regions are per group, groups sharing a file overlap */
+			tests[t] = jobs[g].test;
+			tests[t].instance = t - jobs[g].first;
+			tests[t].lat_hist = &lat_hists[t * IO_DIRS];
+			tests[t].counters = &counters[t];
+			tests[t].cpu = place[t].cpu;
+			tests[t].node = place[t].node;
+			histogram_reset(&lat_hists[t * IO_DIRS + IO_DIR_READ]);
+			histogram_reset(&lat_hists[t * IO_DIRS + IO_DIR_WRITE]);
+			if (jobs[g].ti->test == meta) {
+				tests[t].meta_hist = &meta_hists[t * META_OPS];
+				for (d = 0; d < META_OPS; d++)
+					histogram_reset(&tests[t].meta_hist[d]);
+			}
+			if (jobs[g].ti->test == fsync_test) {
+				tests[t].fsync_res = &fsync_res[t * FSYNC_RESULTS];
+				fsync_results_reset(tests[t].fsync_res);
+			}
+			if (jobs[g].ti->test == db) {
+				tests[t].db_hist = &db_hists[t * DB_HISTS];
+				for (d = 0; d < DB_HISTS; d++)
+					histogram_reset(&tests[t].db_hist[d]);
 			}
 		}
 
-		for (t = 0; t < num_threads; t++) {
-			void *ret;
-			test_context_t *test = &tests[t];
+		/* Stonewalled phases run one after another, the round spans them all */
+		stat_vals[r].val[STAT_START_SKEW] = 0.0;
+		stat_vals[r].val[STAT_FINISH_SKEW] = 0.0;
+		for (p = 0; p < num_phases; p++) {
+			uint64_t phase_start;
 
-			pthread_join(test->thread, &ret);
+			for (g = 0; g < num_groups; g++) {
+				for (t = jobs[g].first; t < jobs[g].first + jobs[g].threads; t++)
+					tests[t].test_info = (jobs[g].phase == p) ? jobs[g].ti : NULL;
+			}
+			pool_run(opt_runtime_ns);
+			duration_ns += phase_span(tests, num_threads, &phase_start, &stat_vals[r]);
+			if (p == 0)
+				time_start = phase_start;
 		}
-		time_end = timeval_to_double();
-		duration = time_end - time_start;
+		duration = (double)duration_ns / NS_PER_SEC;
+		interval_log_stop();
 
 		read_pid_proc_io(&stat_end);
 		read_pid_proc_stat(&stat_end);
 		read_slab_stat(&stat_end);
-		read_diskstats(test.pathname, &stat_end);
+		read_diskstats(pathname, &stat_end);
 		read_memstats(&stat_vals[r]);
+		job_cache_resident(jobs, num_groups, &cache_end, &cache_end_size);
+		stat_vals[r].val[STAT_CACHE_END] = cache_end_size ?
+			100.0 * (double)cache_end / (double)cache_end_size : 0.0;
 
-		if (ti->test_deinit) {
-			if (ti->test_deinit(&test) < 0) {
-				rc = EXIT_FAILURE;
-				break;
-			}
+		if (job_round_deinit(jobs, num_groups) < 0) {
+			rc = EXIT_FAILURE;
+			break;
 		}
 		calc_stats_delta(&stat_start, &stat_end, &stat_vals[r]);
 		calc_pid_proc_stat(duration, &stat_vals[r]);
@@ -848,24 +2121,53 @@ int main(int argc, char **argv)
 		if (!(opt_flags & OPT_CONT))
 			break;
 
+		histogram_reset(&lat_round);
+		histogram_reset(&lat_round_dir[IO_DIR_READ]);
+		histogram_reset(&lat_round_dir[IO_DIR_WRITE]);
 		for (t = 0; t < num_threads; t++) {
 			test_context_t *test = &tests[t];
 			ops += test->ops;
+			nowait_retries += test->nowait_retries;
+			verify_blocks += test->verify_blocks;
+			verify_errors += test->verify_errors;
+			/* A verify run that could not check its blocks has not passed */
+			if (test->verify && (test->ret < 0))
+				verify_failed++;
+			for (d = 0; d < IO_DIRS; d++) {
+				dir_ops[d] += test->dir_ops[d];
+				dir_bytes[d] += test->dir_bytes[d];
+				histogram_merge(&lat_round_dir[d], &test->lat_hist[d]);
+			}
 
 			if (opt_flags & OPT_THREAD_STATS) {
 				printf("Thread %-2" PRIu32 " %8.3f %s %12.3f %12.7f\n",
 					t,
-					test->duration_s,
+					(double)test->duration_ns / NS_PER_SEC,
 					size_to_str(test->rate, "%12.3f", buf, sizeof(buf)),
 					test->op_rate,
-					test->response_time_ms);
+					(double)test->response_time_ns / 1000000.0);
+				printf("          started +%.3f us, finished +%.3f us\n",
+					(double)(test->start_ns - time_start) / 1000.0,
+					(double)(test->end_ns - time_start) / 1000.0);
 			}
 		}
 
 		stat_vals[r].val[STAT_DURATION] = duration;
-		stat_vals[r].val[STAT_RATE] = (double)(ops * test.block_size) / duration;
-		stat_vals[r].val[STAT_OP_RATE] = (double)ops / duration;
-		stat_vals[r].val[STAT_RESPONSE_TIME] = 1000.0 * duration / (double)ops;
+		stat_vals[r].val[STAT_RATE] = (double)(dir_bytes[IO_DIR_READ] + dir_bytes[IO_DIR_WRITE]) *
+			NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_OP_RATE] = (double)ops * NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_READ_RATE] = (double)dir_bytes[IO_DIR_READ] * NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_READ_OP_RATE] = (double)dir_ops[IO_DIR_READ] * NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_WRITE_RATE] = (double)dir_bytes[IO_DIR_WRITE] * NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_WRITE_OP_RATE] = (double)dir_ops[IO_DIR_WRITE] * NS_PER_SEC / (double)duration_ns;
+		stat_vals[r].val[STAT_RESPONSE_TIME] = ops ? (double)(duration_ns / ops) / 1000000.0 : 0.0;
+		for (d = 0; d < IO_DIRS; d++) {
+			histogram_merge(&lat_round, &lat_round_dir[d]);
+			histogram_merge(&lat_total_dir[d], &lat_round_dir[d]);
+			latency_stats(&lat_round_dir[d], &stat_vals[r], lat_dir_stat[d]);
+		}
+		latency_stats(&lat_round, &stat_vals[r], STAT_LAT_P50);
+		histogram_merge(&lat_total, &lat_round);
 
 		printf("Round %-2" PRIu32 "  %8.3f %12s %12.3f %12.7f\n",
 			r,
@@ -873,7 +2175,68 @@ int main(int argc, char **argv)
 			size_to_str(stat_vals[r].val[STAT_RATE], "%12.3f", buf, sizeof(buf)),
 			stat_vals[r].val[STAT_OP_RATE],
 			stat_vals[r].val[STAT_RESPONSE_TIME]);
+		if (dir_ops[IO_DIR_READ] && dir_ops[IO_DIR_WRITE]) {
+			for (d = 0; d < IO_DIRS; d++) {
+				const stat_val_t l = lat_dir_stat[d];
+
+				printf("  %-6s          %12s %12.3f  p50 %.3f us, p99 %.3f us\n",
+					dir_name[d],
+					size_to_str(d == IO_DIR_READ ?
+						stat_vals[r].val[STAT_READ_RATE] :
+						stat_vals[r].val[STAT_WRITE_RATE], "%12.3f", buf, sizeof(buf)),
+					d == IO_DIR_READ ?
+						stat_vals[r].val[STAT_READ_OP_RATE] :
+						stat_vals[r].val[STAT_WRITE_OP_RATE],
+					stat_vals[r].val[l] / 1000.0,
+					stat_vals[r].val[l + 1] / 1000.0);
+			}
+		}
+		for (g = 0; g < num_groups; g++) {
+			job_round_done(&jobs[g], tests);
+			if (njobs)
+				show_job_round(&jobs[g], name_width);
+		}
+		if (meta_run) {
+			meta_results_reset(&meta_round);
+			for (t = 0; t < num_threads; t++) {
+				if (tests[t].meta_hist)
+					meta_results_add(&meta_round, &tests[t]);
+			}
+			show_meta_round(&meta_round);
+			meta_results_merge(&meta_total, &meta_round);
+		}
+		if (db_groups) {
+			for (d = 0; d < DB_HISTS; d++)
+				histogram_reset(&db_round[d]);
+			for (t = 0; t < num_threads; t++) {
+				for (d = 0; tests[t].db_hist && (d < DB_HISTS); d++)
+					histogram_merge(&db_round[d], &tests[t].db_hist[d]);
+			}
+			show_db_round(db_round);
+			for (d = 0; d < DB_HISTS; d++)
+				histogram_merge(&db_total[d], &db_round[d]);
+		}
+		for (t = 0; fsync_run && (t < num_threads); t++) {
+			if (tests[t].fsync_res)
+				fsync_results_add(fsync_total, &tests[t]);
+		}
+		if (cache_size || cache_end_size)
+			printf("  Cache           %s, %.1f%% of %s of files cached at start, %.1f%% at end\n",
+				cache_state(stat_vals[r].val[STAT_CACHE_START]),
+				stat_vals[r].val[STAT_CACHE_START],
+				size_to_str_h(cache_size ? cache_size : cache_end_size, "%.2f", buf, sizeof(buf)),
+				stat_vals[r].val[STAT_CACHE_END]);
+		if (nowait_retries)
+			printf("          %" PRIu64 " RWF_NOWAIT ops would block and were retried\n",
+				nowait_retries);
+		if (verify_run)
+			printf("  Verify          %" PRIu64 " blocks checked, %" PRIu64 " bad\n",
+				verify_blocks, verify_errors);
+		verify_total += verify_errors;
 	}
+	job_files_done(jobs, num_groups);
+
+	pool_destroy();
 
 	if (!(opt_flags & OPT_CONT)) {
 		fprintf(stderr, "Aborted!\n");
@@ -893,7 +2256,7 @@ int main(int argc, char **argv)
 			continue;
 		}
 
-		if (stat_table[j].ignore)
+		if (stat_table[j].ignore || stat_dir_hidden(s, results))
 			continue;
 		if (stat_table[j].units)
 			snprintf(buf, sizeof(buf), "%s (%s)", stat_table[j].label, stat_table[j].units);
@@ -905,10 +2268,59 @@ int main(int argc, char **argv)
 		printf("\n");
 	}
 
+	latency_stats(&lat_total, &lat_all, STAT_LAT_P50);
+	latency_stats(&lat_total_dir[IO_DIR_READ], &lat_all, STAT_READ_LAT_P50);
+	latency_stats(&lat_total_dir[IO_DIR_WRITE], &lat_all, STAT_WRITE_LAT_P50);
+	printf("\nLatency over all rounds (us): p50 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+		lat_all.val[STAT_LAT_P50] / 1000.0,
+		lat_all.val[STAT_LAT_P99] / 1000.0,
+		lat_all.val[STAT_LAT_P999] / 1000.0,
+		lat_all.val[STAT_LAT_MAX] / 1000.0);
+	if (lat_total_dir[IO_DIR_READ].count && lat_total_dir[IO_DIR_WRITE].count) {
+		for (i = 0; i < IO_DIRS; i++) {
+			const stat_val_t l = lat_dir_stat[i];
+
+			printf("  %-6s (us):                p50 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+				dir_name[i],
+				lat_all.val[l] / 1000.0,
+				lat_all.val[l + 1] / 1000.0,
+				lat_all.val[l + 2] / 1000.0,
+				lat_all.val[l + 3] / 1000.0);
+		}
+	}
+
+	for (g = 0; njobs && (g < num_groups); g++)
+		show_job_total(&jobs[g], name_width);
+	if (meta_run)
+		show_meta_total(&meta_total);
+	if (fsync_run)
+		show_fsync_total(fsync_total, repeats);
+	if (db_groups)
+		show_db_total(db_total);
+	if (verify_total) {
+		printf("\nVerify found %" PRIu64 " bad blocks\n", verify_total);
+		rc = EXIT_FAILURE;
+	}
+	if (verify_failed) {
+		printf("\nVerify failed in %" PRIu64 " workers\n", verify_failed);
+		rc = EXIT_FAILURE;
+	}
+
 	if (opt_ofilename)
-		dump_results(opt_ofilename, results);
+		dump_results(opt_ofilename, results, &lat_all, jobs, njobs ? num_groups : 0);
 
 out:
+	pool_destroy();
+	interval_log_close();
+	free(place);
+	free(counters);
+	free(meta_hists);
+	free(db_hists);
+	free(fsync_total);
+	free(fsync_res);
+	free(lat_hists);
+	free(tests);
+	free(jobs);
 	free(stat_vals);
 	exit(rc);
 }
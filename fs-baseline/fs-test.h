@@ -24,7 +24,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
-#include <sys/time.h>
+
+#include "fs-histogram.h"
+#include "fs-time.h"
 
 #define OPT_BLOCK_SIZE		(0x00000001)
 #define OPT_FILE_SIZE		(0x00000002)
@@ -37,10 +39,19 @@
 #define OPT_YAML		(0x00000100)
 #define OPT_JSON		(0x00000200)
 
+#define CACHE_LINE_SIZE		(64)
+#define CACHE_ALIGNED		__attribute__((aligned(CACHE_LINE_SIZE)))
+
 typedef enum {
 	STAT_DURATION = 0,
 	STAT_RATE,
 	STAT_OP_RATE,
+	STAT_READ_RATE,
+	STAT_READ_OP_RATE,
+	STAT_WRITE_RATE,
+	STAT_WRITE_OP_RATE,
+	STAT_START_SKEW,
+	STAT_FINISH_SKEW,
 
 	STAT_MEM_TOTAL,
 	STAT_MEM_FREE,
@@ -49,8 +60,22 @@ typedef enum {
 	STAT_MEM_CACHED,
 	STAT_MEM_DIRTY,
 	STAT_MEM_WRITEBACK,
+	STAT_CACHE_START,
+	STAT_CACHE_END,
 
 	STAT_RESPONSE_TIME,
+	STAT_LAT_P50,
+	STAT_LAT_P99,
+	STAT_LAT_P999,
+	STAT_LAT_MAX,
+	STAT_READ_LAT_P50,
+	STAT_READ_LAT_P99,
+	STAT_READ_LAT_P999,
+	STAT_READ_LAT_MAX,
+	STAT_WRITE_LAT_P50,
+	STAT_WRITE_LAT_P99,
+	STAT_WRITE_LAT_P999,
+	STAT_WRITE_LAT_MAX,
 	STAT_READS_COMPLETED,
 	STAT_READS_MERGED,
 	STAT_SECTORS_READ,
@@ -74,6 +99,8 @@ typedef enum {
 	STAT_PID_UTIME,
 	STAT_PID_STIME,
 	STAT_PID_TTIME,
+	STAT_PID_MINFLT,
+	STAT_PID_MAJFLT,
 
 	STAT_SLAB_BLKDEV_QUEUE,
 	STAT_SLAB_BLKDEV_REQUESTS,
@@ -98,7 +125,60 @@ typedef struct {
 	double val[STAT_MAX_VAL];
 } stat_t;
 
+typedef enum {
+	IO_DIR_READ = 0,
+	IO_DIR_WRITE,
+	IO_DIRS
+} io_dir_t;
+
+/* Metadata test ops, each reported on its own */
+typedef enum {
+	META_MKDIR = 0,
+	META_CREATE,
+	META_STAT,
+	META_READDIR,
+	META_RENAME,
+	META_UNLINK,
+	META_OPS
+} meta_op_t;
+
+/* Durability test commit methods, each ranked on its own */
+typedef enum {
+	FSYNC_WRITE_FSYNC = 0,
+	FSYNC_WRITE_FDATASYNC,
+	FSYNC_O_DSYNC,
+	FSYNC_O_SYNC,
+	FSYNC_RWF_DSYNC,
+	FSYNC_SYNC_FILE_RANGE,
+	FSYNC_URING_LINKED,
+	FSYNC_METHODS
+} fsync_method_t;
+
+#define FSYNC_MAX_SIZES		(4)
+
+/* What written blocks contain */
+typedef enum {
+	DATA_CONST = 0,		/* Every byte the writer's instance */
+	DATA_RANDOM,		/* Generated per write, optionally compressible or deduped */
+} data_mode_t;
+
+/*
+ *  Live per thread counters, written only by the owning worker
+ *  and sampled by the interval log thread.  Each sits in its
+ *  own cache line so the sampler never contends with workers.
+ */
+typedef struct {
+	uint64_t	ops;
+	uint64_t	bytes;
+	uint64_t	lat_sum_ns;
+	uint64_t	lat_max_ns;	/* Reset by the sampler each interval */
+} CACHE_ALIGNED io_counters_t;
+
 typedef struct test_context_t test_context_t;
+typedef struct io_engine_t io_engine_t;
+typedef struct io_bssplit_t io_bssplit_t;
+typedef struct io_dist_t io_dist_t;
+typedef struct fsync_result_t fsync_result_t;
 
 typedef struct {
 	const char *op_name;			/* Test op name */
@@ -122,17 +202,78 @@ typedef struct test_context_t {
 	char		*filename;
 	char		*pathname;
 	int 		open_flags;
-	pthread_t	thread;
+	histogram_t	*lat_hist;	/* Per thread op latencies, one per io_dir_t */
+	io_counters_t	*counters;	/* Per thread live counters */
+	int		cpu;		/* Pinned cpu or -1 */
+	int		node;		/* NUMA node for buffers or -1 */
 	test_info_t	*test_info;
+	const io_engine_t *engine;
+	uint32_t	iodepth;
+	uint32_t	iodepth_batch;
+	uint32_t	iodepth_batch_complete;
+	uint32_t	io_flags;
+	int		mmap_advice;	/* MADV_* or -1 for none */
+	int		mmap_msync;	/* io_msync_t */
+	uint32_t	vec_blocks;	/* Blocks per vectored call */
+	int		rwf_flags;	/* RWF_* per I/O flags */
+	uint32_t	rwmixread;	/* Read percentage of mixed workloads */
+	const io_bssplit_t *bssplit;	/* Block size distribution or NULL */
+	const io_dist_t	*dist;		/* Random offset distribution */
+	uint64_t	randseed;	/* Seed for all worker streams */
+	bool		time_based;	/* Repeat passes until the runtime is up */
+	uint64_t	rate_iops;	/* Open loop ops per sec per thread, 0 closed loop */
+	uint64_t	rate_bytes;	/* Open loop bytes per sec per thread */
+	uint64_t	thinktime_ns;	/* Idle time after each thinktime_blocks ops */
+	uint32_t	thinktime_blocks;
+	uint32_t	threads;	/* Workers in the group */
+	bool		verify;		/* Stamp written blocks and check all reads */
+	data_mode_t	data_mode;
+	double		data_compress;	/* Target compression ratio, 1.0 is incompressible */
+	uint32_t	data_dedupe;	/* Percentage of chunks repeating earlier ones */
+	bool		setup_reuse;	/* Laid out file is kept between rounds */
+	bool		setup_keep;	/* Laid out files outlive the run */
+	const char	*setup_template;	/* Kept layout cloned each round, or NULL */
+	uint32_t	meta_fanout;	/* Metadata tree subdirectories per directory */
+	uint32_t	meta_depth;	/* Metadata tree levels below the root */
+	bool		meta_shared;	/* All workers use one tree */
+	uint32_t	meta_mask;	/* Optional metadata ops, 1 << meta_op_t */
+	histogram_t	*meta_hist;	/* Per thread metadata op latencies, one per meta_op_t */
+	uint32_t	fsync_mask;	/* Commit methods, 1 << fsync_method_t */
+	uint32_t	fsync_nsizes;	/* Commit sizes, 0 for just the block size */
+	uint64_t	fsync_sizes[FSYNC_MAX_SIZES];
+	fsync_result_t	*fsync_res;	/* Per thread results, one per method, size and open mode */
+	uint64_t	db_ckpt_ns;	/* Database checkpoint interval */
+	uint32_t	db_txn_reads;	/* Page reads per transaction */
+	histogram_t	*db_hist;	/* Per thread database latencies, one per db_hist_t */
 	int		ret;
 
 	/* Returned value from test */
 	uint64_t	ops;
-	double		duration_s;
+	uint64_t	dir_ops[IO_DIRS];
+	uint64_t	dir_bytes[IO_DIRS];
+	uint64_t	meta_ops[META_OPS];
+	uint64_t	meta_ns[META_OPS];	/* Time spent in each op's pass */
+	uint64_t	duration_ns;
 	double		rate;
 	double		op_rate;
-	double		response_time_ms;
-} test_context_t;
+	uint64_t	response_time_ns;
+	uint64_t	nowait_retries;
+	uint64_t	verify_blocks;	/* Blocks checked, by reads and the post write pass */
+	uint64_t	verify_errors;
+	uint64_t	start_ns;	/* When the worker was released */
+	uint64_t	end_ns;		/* When the worker finished */
+} CACHE_ALIGNED test_context_t;
+
+/*
+ *  Workers poll this in their inner loops, so it sits alone
+ *  in its own cache line and is only written when the run is
+ *  interrupted or when a round is cut short by --stop=first
+ *  or --runtime
+ */
+typedef struct {
+	volatile bool	interrupted;	/* SIGINT */
+	volatile bool	round_done;	/* First worker finished or runtime up */
+} CACHE_ALIGNED test_stop_t;
 
 typedef struct {
 	stat_val_t stat;
@@ -144,20 +285,44 @@ typedef struct {
 } stat_table_t;
 
 /*
- *  timeval_to_double()
- *      convert timeval to seconds as a double
+ *  counters_update()
+ *	single writer update of the live counters, relaxed
+ *	atomics so the sampler never sees torn values
  */
-static inline double timeval_to_double(void)
+static inline void counters_update(
+	io_counters_t *c,
+	const uint64_t ops,
+	const uint64_t bytes,
+	const uint64_t lat_ns)
 {
-        struct timeval tv;
-
-        gettimeofday(&tv, NULL);
-        return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+	__atomic_store_n(&c->ops, c->ops + ops, __ATOMIC_RELAXED);
+	__atomic_store_n(&c->bytes, c->bytes + bytes, __ATOMIC_RELAXED);
+	__atomic_store_n(&c->lat_sum_ns, c->lat_sum_ns + lat_ns, __ATOMIC_RELAXED);
+	if (lat_ns > __atomic_load_n(&c->lat_max_ns, __ATOMIC_RELAXED))
+		__atomic_store_n(&c->lat_max_ns, lat_ns, __ATOMIC_RELAXED);
 }
 
 extern const stat_table_t stat_table[];
 extern unsigned int opt_flags;
+extern test_stop_t test_stop;
 
 extern uint32_t mwc(uint32_t *z, uint32_t *w);
+extern unsigned int count_bits(const unsigned int val);
+extern uint64_t get_u64(const char *const str);
+extern uint32_t get_u32(const char *const str);
+extern uint64_t get_u64_byte(const char *const str);
+extern void parse_bssplit(const char *str, io_bssplit_t *split);
+extern test_info_t *test_find(const char *tag);
+
+/*
+ *  test_continue()
+ *	workers keep going until interrupted or, with
+ *	--stop=first, until another worker has finished or,
+ *	with --runtime, until the round's time is up
+ */
+static inline bool test_continue(void)
+{
+	return !(test_stop.interrupted | test_stop.round_done);
+}
 
 #endif
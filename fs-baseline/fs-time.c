@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "fs-time.h"
+
+#define TIME_CALIBRATE_NS	(100000000ULL)	/* 100 ms */
+#define TIME_OVERHEAD_LOOPS	(100000)
+
+time_source_t time_source = { TIME_CLOCK_RAW, 0, 0, 0, 0, 0 };
+
+static const char *time_clock_names[] = {
+	"raw",
+	"tsc",
+};
+
+/*
+ *  time_clock()
+ *	map a --clock name to a time_clock_t, -1 if invalid
+ */
+int time_clock(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(time_clock_names) / sizeof(time_clock_names[0]); i++) {
+		if (!strcmp(name, time_clock_names[i]))
+			return (int)i;
+	}
+	return -1;
+}
+
+const char *time_clock_name(void)
+{
+	return time_clock_names[time_source.clock];
+}
+
+#if defined(HAVE_TIME_COUNTER)
+/*
+ *  time_counter_stable()
+ *	the counter is only usable across CPUs and frequency
+ *	changes if it is invariant
+ */
+static bool time_counter_stable(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	FILE *fp;
+	char buffer[4096];
+	bool constant = false, nonstop = false;
+
+	if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+		return false;
+	while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+		if (strncmp(buffer, "flags", 5))
+			continue;
+		constant = strstr(buffer, " constant_tsc") != NULL;
+		nonstop = strstr(buffer, " nonstop_tsc") != NULL;
+		break;
+	}
+	(void)fclose(fp);
+
+	return constant && nonstop;
+#else
+	/* The ARMv8 generic timer is architecturally constant rate */
+	return true;
+#endif
+}
+
+/*
+ *  time_calibrate()
+ *	measure the counter rate against CLOCK_MONOTONIC_RAW
+ */
+static int time_calibrate(void)
+{
+	uint64_t c_start, c_end, t_start, t_end;
+
+	t_start = time_raw_ns();
+	c_start = time_counter();
+	do {
+		t_end = time_raw_ns();
+	} while (t_end - t_start < TIME_CALIBRATE_NS);
+	c_end = time_counter();
+
+	if (c_end <= c_start)
+		return -EINVAL;
+
+	time_source.counter_hz = (c_end - c_start) * NS_PER_SEC / (t_end - t_start);
+	time_source.mult = (uint64_t)(((unsigned __int128)(t_end - t_start) << TIME_SHIFT) /
+		(c_end - c_start));
+	time_source.base_ns = time_raw_ns();
+	time_source.base_counter = time_counter();
+
+	return 0;
+}
+#endif
+
+/*
+ *  time_overhead()
+ *	average cost of back to back time_now_ns() calls
+ */
+static uint64_t time_overhead(void)
+{
+	uint64_t t_start, t_end;
+	volatile uint64_t sink = 0;
+	int i;
+
+	t_start = time_now_ns();
+	for (i = 0; i < TIME_OVERHEAD_LOOPS; i++)
+		sink += time_now_ns();
+	t_end = time_now_ns();
+	(void)sink;
+
+	return (t_end - t_start) / TIME_OVERHEAD_LOOPS;
+}
+
+/*
+ *  time_init()
+ *	select and calibrate the time source, falls back
+ *	to CLOCK_MONOTONIC_RAW if the counter is unusable
+ */
+int time_init(const time_clock_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) < 0) {
+		fprintf(stderr, "CLOCK_MONOTONIC_RAW is not available: %d %s\n",
+			errno, strerror(errno));
+		return -errno;
+	}
+	time_source.clock = TIME_CLOCK_RAW;
+
+	if (clock == TIME_CLOCK_TSC) {
+#if defined(HAVE_TIME_COUNTER)
+		if (!time_counter_stable())
+			fprintf(stderr, "CPU cycle counter is not invariant, using raw clock\n");
+		else if (time_calibrate() < 0)
+			fprintf(stderr, "Cannot calibrate CPU cycle counter, using raw clock\n");
+		else
+			time_source.clock = TIME_CLOCK_TSC;
+#else
+		fprintf(stderr, "No CPU cycle counter on this architecture, using raw clock\n");
+#endif
+	}
+	time_source.overhead_ns = time_overhead();
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_TIME_H__
+#define __FS_TIME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TIME_COUNTER
+#elif defined(__aarch64__)
+#define HAVE_TIME_COUNTER
+#endif
+
+#define NS_PER_SEC	(1000000000ULL)
+
+typedef enum {
+	TIME_CLOCK_RAW = 0,	/* clock_gettime(CLOCK_MONOTONIC_RAW) */
+	TIME_CLOCK_TSC,		/* Calibrated cycle counter */
+} time_clock_t;
+
+/*
+ *  Cycle counter to ns conversion, ns = base_ns +
+ *  ((counter - base_counter) * mult) >> TIME_SHIFT
+ */
+#define TIME_SHIFT	(32)
+
+typedef struct {
+	time_clock_t	clock;
+	uint64_t	base_counter;
+	uint64_t	base_ns;
+	uint64_t	mult;
+	uint64_t	counter_hz;
+	uint64_t	overhead_ns;	/* Cost of one time_now_ns() call */
+} time_source_t;
+
+extern time_source_t time_source;
+
+extern int time_clock(const char *name);
+extern int time_init(const time_clock_t clock);
+extern const char *time_clock_name(void);
+
+static inline uint64_t time_raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ((uint64_t)ts.tv_sec * NS_PER_SEC) + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t time_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t val;
+
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (val));
+	return val;
+#else
+	return 0;
+#endif
+}
+
+/*
+ *  time_now_ns()
+ *	monotonic time in nanoseconds for per op timing
+ */
+static inline uint64_t time_now_ns(void)
+{
+#if defined(HAVE_TIME_COUNTER)
+	if (time_source.clock == TIME_CLOCK_TSC) {
+		const uint64_t delta = time_counter() - time_source.base_counter;
+
+		return time_source.base_ns +
+			(uint64_t)(((unsigned __int128)delta * time_source.mult) >> TIME_SHIFT);
+	}
+#endif
+	return time_raw_ns();
+}
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "fs-test.h"
+#include "fs-io.h"
+#include "fs-verify.h"
+
+/*
+ *  CRC32C (Castagnoli), reflected.  With the SSE4.2 or ARMv8
+ *  CRC instructions a verified block is run as three
+ *  interleaved streams to hide the instruction latency and
+ *  the stream CRCs are joined by multiplying by x^(8 * stream
+ *  length) mod P, a constant for the fixed block length that
+ *  is applied by table lookup.  Other lengths and CPUs
+ *  without the instructions take one stream.
+ */
+#define CRC32C_POLY		(0x82f63b78)
+
+static const char *verify_err_names[] = {
+	"ok",
+	"bad magic",
+	"wrong offset",
+	"bad CRC32C",
+	"stale data",
+};
+
+/* Block sizes taking the three stream path, as returned by verify_unit() */
+static const uint32_t verify_units[] = { 4096, 512 };
+
+#define VERIFY_UNITS	(sizeof(verify_units) / sizeof(verify_units[0]))
+
+typedef struct {
+	size_t		len;		/* Bytes covered by the CRC */
+	size_t		stream;		/* Bytes in each stream */
+	uint32_t	shift[4][256];	/* x^(8 * stream) mod P times a byte */
+} crc_three_t;
+
+static uint32_t crc_table[256];
+static crc_three_t crc_threes[VERIFY_UNITS];
+static uint32_t (*crc_raw)(uint32_t crc, const uint8_t *p, size_t len);
+static uint32_t (*crc_three)(const crc_three_t *t, const uint8_t *p);
+static const char *crc_impl = "table";
+
+const char *verify_err_name(const verify_err_t err)
+{
+	return verify_err_names[err];
+}
+
+const char *verify_crc_impl(void)
+{
+	return crc_impl;
+}
+
+static uint32_t crc_raw_table(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+/*
+ *  multmodp()
+ *	a times b modulo the polynomial, reflected
+ */
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+	return p;
+}
+
+/*
+ *  xnmodp()
+ *	x^n mod P, by squaring
+ */
+static uint32_t xnmodp(uint64_t n)
+{
+	uint32_t p = 1U << 31, sq = 1U << 30;	/* x^0 and x^1 */
+
+	while (n) {
+		if (n & 1)
+			p = multmodp(sq, p);
+		sq = multmodp(sq, sq);
+		n >>= 1;
+	}
+	return p;
+}
+
+static inline uint32_t crc_join(const crc_three_t *t, const uint32_t crc1, const uint32_t crc2)
+{
+	return t->shift[0][crc1 & 0xff] ^ t->shift[1][(crc1 >> 8) & 0xff] ^
+	       t->shift[2][(crc1 >> 16) & 0xff] ^ t->shift[3][crc1 >> 24] ^ crc2;
+}
+
+#if defined(__x86_64__)
+#define CRC_TARGET	__attribute__((target("sse4.2")))
+
+CRC_TARGET static inline uint64_t crc_u64(const uint64_t crc, const uint64_t v)
+{
+	return _mm_crc32_u64(crc, v);
+}
+
+CRC_TARGET static inline uint32_t crc_u8(const uint32_t crc, const uint8_t v)
+{
+	return _mm_crc32_u8(crc, v);
+}
+
+static const char *crc_hw(void)
+{
+	return __builtin_cpu_supports("sse4.2") ? "sse4.2" : NULL;
+}
+#elif defined(__aarch64__)
+#define CRC_TARGET	__attribute__((target("+crc")))
+
+CRC_TARGET static inline uint64_t crc_u64(const uint64_t crc, const uint64_t v)
+{
+	return __crc32cd((uint32_t)crc, v);
+}
+
+CRC_TARGET static inline uint32_t crc_u8(const uint32_t crc, const uint8_t v)
+{
+	return __crc32cb(crc, v);
+}
+
+static const char *crc_hw(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) ? "armv8 crc" : NULL;
+}
+#endif
+
+#if defined(CRC_TARGET)
+CRC_TARGET static uint32_t crc_raw_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t c = crc;
+
+	for (; len >= 8; len -= 8, p += 8) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		c = crc_u64(c, v);
+	}
+	crc = (uint32_t)c;
+	while (len--)
+		crc = crc_u8(crc, *p++);
+	return crc;
+}
+
+CRC_TARGET static uint32_t crc_three_hw(const crc_three_t *t, const uint8_t *p)
+{
+	const size_t n = t->stream;
+	uint64_t a = 0xffffffff, b = 0xffffffff, c = 0xffffffff;
+	uint32_t crc;
+	size_t i;
+
+	for (i = 0; i < n; i += 8) {
+		uint64_t va, vb, vc;
+
+		memcpy(&va, p + i, sizeof(va));
+		memcpy(&vb, p + n + i, sizeof(vb));
+		memcpy(&vc, p + (2 * n) + i, sizeof(vc));
+		a = crc_u64(a, va);
+		b = crc_u64(b, vb);
+		c = crc_u64(c, vc);
+	}
+	crc = crc_join(t, ~(uint32_t)a, ~(uint32_t)b);
+	crc = crc_join(t, crc, ~(uint32_t)c);
+
+	return ~crc_raw_hw(~crc, p + (3 * n), t->len - (3 * n));
+}
+#endif
+
+/*
+ *  verify_init()
+ *	pick the CRC32C code and set up the three stream
+ *	path for each verified block size
+ */
+void verify_init(void)
+{
+	uint32_t i, k, u;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t crc = i;
+
+		for (k = 0; k < 8; k++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc_table[i] = crc;
+	}
+	crc_raw = crc_raw_table;
+	crc_three = NULL;
+
+#if defined(CRC_TARGET)
+	if ((crc_impl = crc_hw()) == NULL) {
+		crc_impl = "table";
+		return;
+	}
+	crc_raw = crc_raw_hw;
+	crc_three = crc_three_hw;
+	for (u = 0; u < VERIFY_UNITS; u++) {
+		crc_three_t *t = &crc_threes[u];
+		uint32_t x;
+
+		t->len = verify_units[u] - VERIFY_CRC_START;
+		t->stream = (t->len / 24) * 8;
+		x = xnmodp(8 * (uint64_t)t->stream);
+		for (k = 0; k < 4; k++) {
+			for (i = 0; i < 256; i++)
+				t->shift[k][i] = multmodp(x, i << (8 * k));
+		}
+	}
+#else
+	(void)u;
+	(void)xnmodp;
+	(void)crc_join;
+#endif
+}
+
+uint32_t crc32c(const void *buf, const size_t len)
+{
+	uint32_t u;
+
+	for (u = 0; crc_three && (u < VERIFY_UNITS); u++) {
+		if (len == crc_threes[u].len)
+			return crc_three(&crc_threes[u], (const uint8_t *)buf);
+	}
+	return ~crc_raw(0xffffffff, (const uint8_t *)buf, len);
+}
+
+/*
+ *  verify_unit()
+ *	verified block size, the largest of 4K or 512 bytes
+ *	that every op size and region boundary is a multiple
+ *	of, or 0 if there is none
+ */
+uint32_t verify_unit(const test_context_t *test)
+{
+	const uint64_t size = test->bssplit ? test->bssplit->min_size : test->block_size;
+	uint32_t i, j;
+
+	for (i = 0; i < VERIFY_UNITS; i++) {
+		const uint32_t u = verify_units[i];
+		bool ok = ((size % u) == 0) && ((test->per_thread_file_size % u) == 0);
+
+		for (j = 0; ok && test->bssplit && (j < test->bssplit->n); j++)
+			ok = (test->bssplit->size[j] % u) == 0;
+		if (ok)
+			return u;
+	}
+	return 0;
+}
+
+/*
+ *  verify_fill()
+ *	stamp a header and CRC on each block of a buffer
+ *	about to be written at offset
+ */
+void verify_fill(
+	void *buf,
+	const size_t size,
+	const off_t offset,
+	const uint32_t unit,
+	const uint32_t thread,
+	const uint32_t seq,
+	const uint64_t seed)
+{
+	uint8_t *p = (uint8_t *)buf;
+	size_t i;
+
+	for (i = 0; i < size; i += unit) {
+		verify_hdr_t *hdr = (verify_hdr_t *)(p + i);
+
+		hdr->magic = VERIFY_MAGIC;
+		hdr->offset = (uint64_t)offset + i;
+		hdr->seed = seed;
+		hdr->thread = thread;
+		hdr->seq = seq;
+		hdr->crc = crc32c(p + i + VERIFY_CRC_START, unit - VERIFY_CRC_START);
+	}
+}
+
+/*
+ *  verify_block()
+ *	check one block read from offset
+ */
+verify_err_t verify_block(const void *buf, const off_t offset, const uint32_t unit)
+{
+	const verify_hdr_t *hdr = (const verify_hdr_t *)buf;
+
+	if (hdr->magic != VERIFY_MAGIC)
+		return VERIFY_BAD_MAGIC;
+	if (hdr->offset != (uint64_t)offset)
+		return VERIFY_BAD_OFFSET;
+	if (hdr->crc != crc32c((const uint8_t *)buf + VERIFY_CRC_START, unit - VERIFY_CRC_START))
+		return VERIFY_BAD_CRC;
+	return VERIFY_OK;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Canonical
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * Author Colin Ian King,  colin.king@canonical.com
+ */
+
+#ifndef __FS_VERIFY_H__
+#define __FS_VERIFY_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "fs-test.h"
+
+#define VERIFY_MAGIC		(0x42565346)	/* "FSVB" */
+#define VERIFY_SETUP		(0xffffffff)	/* Writer of blocks laid out before the test */
+#define VERIFY_CRC_START	(8)		/* The CRC covers the block after magic and crc */
+#define VERIFY_MAX_REPORTS	(8)		/* Bad blocks reported per thread */
+#define VERIFY_FLIGHT_RACED	(0x80000000)	/* Written again while a write was in flight */
+#define VERIFY_FLIGHT_COUNT	(0x7fffffff)	/* Writes of the block in flight */
+
+/*
+ *  Every verified block starts with this header, so a bad
+ *  block says where it was meant to be and who wrote it
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	crc;		/* CRC32C of the block from VERIFY_CRC_START */
+	uint64_t	offset;		/* File offset of the block */
+	uint64_t	seed;		/* Random seed of the writing group */
+	uint32_t	thread;		/* Writer instance or VERIFY_SETUP */
+	uint32_t	seq;		/* Writer's write count, 0 for setup */
+} verify_hdr_t;
+
+typedef enum {
+	VERIFY_OK = 0,
+	VERIFY_BAD_MAGIC,
+	VERIFY_BAD_OFFSET,
+	VERIFY_BAD_CRC,
+	VERIFY_STALE,		/* Valid, but not this thread's last write */
+} verify_err_t;
+
+extern void verify_init(void);
+extern const char *verify_crc_impl(void);
+extern uint32_t crc32c(const void *buf, const size_t len);
+extern uint32_t verify_unit(const test_context_t *test);
+extern void verify_fill(void *buf, const size_t size, const off_t offset,
+	const uint32_t unit, const uint32_t thread, const uint32_t seq, const uint64_t seed);
+extern verify_err_t verify_block(const void *buf, const off_t offset, const uint32_t unit);
+extern const char *verify_err_name(const verify_err_t err);
+
+#endif
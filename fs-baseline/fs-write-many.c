@@ -18,9 +18,11 @@
  * Author Colin Ian King,  colin.king@canonical.com
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
@@ -30,33 +32,151 @@
 #include <limits.h>
 
 #include "fs-test.h"
+#include "fs-affinity.h"
+#include "fs-rand.h"
 
-static void mk_filename(uint32_t *z, uint32_t *w, char *path, char *filename, size_t len)
+/*
+ *  Each thread writes its files into WRITE_MANY_SHARDS
+ *  subdirectories of a directory of its own.  Files are made
+ *  with openat() on shard fds opened once, so there is no
+ *  path walk per file, and the names are kept in a list to
+ *  unlink them afterwards.
+ */
+#define WRITE_MANY_SHARDS	(16)
+#define WRITE_MANY_NAME_MIN	(16)
+#define WRITE_MANY_NAME_MAX	(79)
+
+typedef struct {
+	char	*buf;		/* Names, each NUL terminated */
+	size_t	len;
+	size_t	size;
+} name_list_t;
+
+/*
+ *  mk_name()
+ *	random lower case name of len characters, each 64 bit
+ *	random value gives 13 letters
+ */
+static void mk_name(rand_state_t *r, char *name, const size_t len)
 {
-	size_t i;
-	char *ptr;
+	size_t i = 0;
 
-	ptr = filename + snprintf(filename, len, "%s/temp-%d-", path, getpid());
+	while (i < len) {
+		uint64_t x = rand_u64(r);
+		int j;
 
-	for (i = 0; i < len - 1; i++)
-		*ptr++ = 'a' + mwc(z, w) % 26;
+		for (j = 0; (j < 13) && (i < len); j++, i++) {
+			name[i] = (char)('a' + (x % 26));
+			x /= 26;
+		}
+	}
+	name[len] = '\0';
+}
 
-	*ptr = '\0';
+/*
+ *  name_add()
+ *	append a name to the list, growing it by doubling
+ */
+static int name_add(name_list_t *names, const char *name, const size_t len)
+{
+	if (names->len + len + 1 > names->size) {
+		size_t size = names->size ? names->size * 2 : 64 * 1024;
+		char *buf;
+
+		while (size < names->len + len + 1)
+			size *= 2;
+		buf = realloc(names->buf, size);
+		if (!buf)
+			return -ENOMEM;
+		names->buf = buf;
+		names->size = size;
+	}
+	memcpy(names->buf + names->len, name, len + 1);
+	names->len += len + 1;
+
+	return 0;
+}
+
+/*
+ *  shards_open()
+ *	make the thread's directory and its shards and
+ *	open them, returns the number of shards opened or
+ *	-1 if the directory was not created by this run
+ */
+static int shards_open(test_context_t *test, const char *dir, int *fds)
+{
+	char name[16];
+	int dfd, i;
+
+	if (mkdir(dir, S_IRWXU) < 0) {
+		fprintf(stderr, "Cannot create directory %s: %d %s\n",
+			dir, errno, strerror(errno));
+		test->ret = -errno;
+		return -1;
+	}
+	dfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dfd < 0) {
+		fprintf(stderr, "Cannot open directory %s: %d %s\n",
+			dir, errno, strerror(errno));
+		test->ret = -errno;
+		return 0;
+	}
+	for (i = 0; i < WRITE_MANY_SHARDS; i++) {
+		snprintf(name, sizeof(name), "%x", i);
+		if ((mkdirat(dfd, name, S_IRWXU) < 0) ||
+		    ((fds[i] = openat(dfd, name, O_RDONLY | O_DIRECTORY)) < 0)) {
+			fprintf(stderr, "Cannot create shard %s/%s: %d %s\n",
+				dir, name, errno, strerror(errno));
+			test->ret = -errno;
+			(void)unlinkat(dfd, name, AT_REMOVEDIR);
+			break;
+		}
+	}
+	(void)close(dfd);
+
+	return i;
+}
+
+/*
+ *  shards_remove()
+ *	unlink the recorded names, the i'th name is in
+ *	shard i % WRITE_MANY_SHARDS, then the directories
+ */
+static void shards_remove(const char *dir, int *fds, const int nshards, const name_list_t *names)
+{
+	const char *name = names->buf;
+	char shard[PATH_MAX];
+	uint64_t i;
+	int s;
+
+	for (i = 0; name < names->buf + names->len; i++) {
+		(void)unlinkat(fds[i % WRITE_MANY_SHARDS], name, 0);
+		name += strlen(name) + 1;
+	}
+	for (s = 0; s < nshards; s++) {
+		(void)close(fds[s]);
+		snprintf(shard, sizeof(shard), "%s/%x", dir, s);
+		(void)rmdir(shard);
+	}
+	(void)rmdir(dir);
 }
 
 void *write_many(void *ctxt)
 {
 	void *buffer;
-	int fd;
-	double time_start, time_end;
-	uint64_t fs, ops = 0;
+	int fd, fds[WRITE_MANY_SHARDS], nshards;
+	uint64_t time_start, time_end;
+	uint64_t fs, ops = 0, written = 0;
 	test_context_t *test = (test_context_t *)ctxt;
-	uint32_t z, w;
-	char filename[PATH_MAX];
-	int i, count = 0;
+	rand_state_t r;
+	name_list_t names = { NULL, 0, 0 };
+	char dir[PATH_MAX], name[WRITE_MANY_NAME_MAX + 1];
+	uint64_t count = 0;
+	uint64_t t_prev;
 
 	test->ret = 0;
-	if (posix_memalign(&buffer, 4096, (size_t)test->block_size) < 0) {
+	buffer = affinity_alloc_buffer((size_t)test->block_size, test->node);
+	if (!buffer) {
 		fprintf(stderr, "Cannot allocate block buffer: %d %s\n",
 			errno, strerror(errno));
 		test->ret = -ENOMEM;
@@ -65,22 +185,34 @@ void *write_many(void *ctxt)
 	memset(buffer, test->instance & 0xff, test->block_size);
 	fs = test->per_thread_file_size;
 
-	time_start = timeval_to_double();
+	snprintf(dir, sizeof(dir), "%s-%" PRIu32, test->filename, test->instance);
+	nshards = shards_open(test, dir, fds);
+	if (nshards < 0)
+		goto out_free;
+	if (nshards < WRITE_MANY_SHARDS)
+		goto out;
+	rand_seed(&r, test->randseed, test->instance);
+
+	time_start = time_now_ns();
 
-	z = 362436069;
-	w = 521288629 + test->instance;
-	while ((opt_flags & OPT_CONT) && (fs != 0)) {
+	while (test_continue() && (fs != 0)) {
 		uint64_t bytes = test->block_size * (1 + (count & 31));
-		size_t len = 16 + (count & 63);
-		mk_filename(&z, &w, test->pathname, filename, len);
+		size_t len = WRITE_MANY_NAME_MIN + (count & 63);
 
-		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | test->open_flags, S_IRUSR | S_IWUSR);
+		mk_name(&r, name, len);
+		if (name_add(&names, name, len) < 0) {
+			fprintf(stderr, "Out of memory recording file names\n");
+			test->ret = -ENOMEM;
+			break;
+		}
+
+		fd = openat(fds[count % WRITE_MANY_SHARDS], name,
+			O_WRONLY | O_CREAT | O_TRUNC | test->open_flags, S_IRUSR | S_IWUSR);
 		if (fd < 0) {
-			fprintf(stderr, "Cannot open for writing: %s: %d %s\n",
-				test->filename, errno, strerror(errno));
+			fprintf(stderr, "Cannot open for writing: %s/%" PRIx64 "/%s: %d %s\n",
+				dir, count % WRITE_MANY_SHARDS, name, errno, strerror(errno));
 			test->ret = -errno;
-			free(buffer);
-			return NULL;
+			break;
 		}
 
 		if (bytes > fs)
@@ -88,40 +220,47 @@ void *write_many(void *ctxt)
 
 		fs -= bytes;
 
+		t_prev = time_now_ns();
 		while (bytes != 0) {
 			size_t sz = bytes > test->block_size ? test->block_size : bytes;
 			ssize_t n = write(fd, buffer, sz);
+			uint64_t t_now;
+
 			if (n < 0) {
 				fprintf(stderr, "Write failed: %d %s\n",
 					errno, strerror(errno));
 				test->ret = -errno;
-				close(fd);
-				goto out;
+				break;
 			}
+			t_now = time_now_ns();
+			histogram_record(&test->lat_hist[IO_DIR_WRITE], t_now - t_prev);
+			counters_update(test->counters, 1, (uint64_t)n, t_now - t_prev);
+			t_prev = t_now;
+
 			bytes -= n;
+			written += n;
 			ops++;
 		}
 		fsync(fd);
 		close(fd);
 		count++;
+		if (test->ret < 0)
+			break;
 	}
 
-	time_end = timeval_to_double();
-	test->duration_s = time_end - time_start;
-	test->response_time_ms = 1000 * test->duration_s / (double)test->blocks;
-	test->rate = (double)test->per_thread_file_size / test->duration_s;
+	time_end = time_now_ns();
+	test->duration_ns = (time_end > time_start) ? time_end - time_start : 1;
+	test->response_time_ns = test->duration_ns / test->blocks;
+	test->rate = (double)written * NS_PER_SEC / (double)test->duration_ns;
 	test->ops = ops;
-	test->op_rate = (double)ops / test->duration_s;
-
-	z = 362436069;
-	w = 521288629 + test->instance;
-	for (i = 0; i < count; i++) {
-		size_t len = 16 + (i & 63);
-		mk_filename(&z, &w, test->pathname, filename, len);
-		unlink(filename);
-	}
+	test->dir_ops[IO_DIR_WRITE] = ops;
+	test->dir_bytes[IO_DIR_WRITE] = written;
+	test->op_rate = (double)ops * NS_PER_SEC / (double)test->duration_ns;
 
 out:
+	shards_remove(dir, fds, nshards, &names);
+out_free:
+	free(names.buf);
 	free(buffer);
 
 	return NULL;